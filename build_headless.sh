@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# Builds the headless targets on Linux. These compile the platform-neutral tile core
+# against a graphics backend which doesn't need a GPU or a window system:
+#  - WorldView_Bench, the benchmarks, against the null backend (src/draw_null.cpp),
+#    or against the software rasterizer (src/draw_software.cpp) if requested.
+#  - WorldView_Snapshot, which renders single frames through the software rasterizer.
+#  - WorldView_Pyramid, which builds tile pyramids from rasters (src/pyramid_builder.cpp).
+# The bench and the snapshot are also built with DRAW_TILES_INSTANCED off (the _Meshed
+# targets), so that the per-tile meshes, the terrain and the shared index buffers
+# keep being exercised now that the instanced tiles are the default.
+# The Windows application is still built through WorldView.vcxproj.
+#
+# Usage: ./build_headless.sh [debug|release] [null|software]
+#
+
+set -e
+
+CONFIGURATION=${1:-release}
+BENCH_BACKEND=${2:-null}
+COMPILER=${CXX:-clang++}
+
+FLAGS="-std=c++17 -IFoundation/src -DFOUNDATION_LINUX"
+
+if [ "$CONFIGURATION" = "debug" ]; then
+    FLAGS="$FLAGS -g -O0 -DFOUNDATION_DEVELOPER -D_DEBUG"
+else
+    FLAGS="$FLAGS -O2 -DNDEBUG"
+fi
+
+FOUNDATION_SOURCES="
+    Foundation/src/foundation.cpp
+    Foundation/src/memutils.cpp
+    Foundation/src/string_type.cpp
+    Foundation/src/error.cpp
+    Foundation/src/linux_specific.cpp
+    Foundation/src/math/algebra.cpp"
+
+APP_SOURCES="
+    src/tile.cpp
+    src/simulation.cpp
+    src/lod.cpp
+    src/culling.cpp
+    src/jobs.cpp
+    src/tile_pool.cpp
+    src/residency.cpp
+    src/prefetch.cpp
+    src/projection.cpp
+    src/picking.cpp
+    src/tile_index.cpp
+    src/overlay.cpp
+    src/points.cpp
+    src/terrain.cpp
+    src/profiler.cpp
+    src/replay.cpp
+    src/scheduler.cpp
+    src/paint.cpp
+    src/pyramid.cpp
+    src/log.cpp"
+
+$COMPILER $FLAGS $FOUNDATION_SOURCES $APP_SOURCES src/draw_$BENCH_BACKEND.cpp src/bench.cpp -o run_tree/WorldView_Bench -lpthread -lm
+echo "Built run_tree/WorldView_Bench ($CONFIGURATION, $BENCH_BACKEND backend)."
+
+$COMPILER $FLAGS $FOUNDATION_SOURCES $APP_SOURCES src/draw_software.cpp src/snapshot.cpp -o run_tree/WorldView_Snapshot -lpthread -lm
+echo "Built run_tree/WorldView_Snapshot ($CONFIGURATION)."
+
+MESHED_FLAGS="$FLAGS -DDRAW_TILES_INSTANCED=false"
+
+$COMPILER $MESHED_FLAGS $FOUNDATION_SOURCES $APP_SOURCES src/draw_$BENCH_BACKEND.cpp src/bench.cpp -o run_tree/WorldView_Bench_Meshed -lpthread -lm
+echo "Built run_tree/WorldView_Bench_Meshed ($CONFIGURATION, $BENCH_BACKEND backend)."
+
+$COMPILER $MESHED_FLAGS $FOUNDATION_SOURCES $APP_SOURCES src/draw_software.cpp src/snapshot.cpp -o run_tree/WorldView_Snapshot_Meshed -lpthread -lm
+echo "Built run_tree/WorldView_Snapshot_Meshed ($CONFIGURATION)."
+
+$COMPILER $FLAGS $FOUNDATION_SOURCES src/pyramid.cpp src/log.cpp src/pyramid_builder.cpp -o run_tree/WorldView_Pyramid -lpthread -lm
+echo "Built run_tree/WorldView_Pyramid ($CONFIGURATION)."
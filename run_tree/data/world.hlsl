@@ -1,24 +1,76 @@
+//
+// Draws all tiles as instances of one shared unit grid. Every instance carries the
+// bounding box of its tile and the layer of its texture in the bound texture array,
+// and the vertex shader projects the lat/lon coordinates into world space itself.
+//
+
+#define MAP_MODE_2D 0
+#define MAP_MODE_3D 1
+#define TILE_INSTANCE_BATCH_SIZE 1024
+
+#define WORLD_SCALE_3D 10.0f
+
 cbuffer Camera_Constants : register(b0) {
     float4x4 projection_view;
+    int map_mode;
+    float world_scale;
+    float morph; // Negative unless the map mode is switching, see Map_Morph in app.h
+    float4 morph_center; // lat, lon
+    float4 morph_origin;
+    float4 morph_east;
+    float4 morph_north;
+}
+
+struct Tile_Instance {
+    float4 box; // lat0, lon0, lat1, lon1
+    int layer;
+};
+
+cbuffer Tile_Instances : register(b1) {
+    Tile_Instance instances[TILE_INSTANCE_BATCH_SIZE];
 }
 
-Texture2D albedo : register(t0);
+Texture2DArray albedo : register(t0);
 SamplerState albedo_sampler : register(s0);
 
 struct Vertex_Input {
-    float3 position : POSITION;
     float2 uv : UV;
+    uint instance_id : SV_InstanceID;
 };
 
 struct Pixel_Input {
     float4 screen_space_position : SV_Position;
-    float2 uv : TEXCOORD0;
+    float3 uv : TEXCOORD0;
 };
 
+float3 world_from_coordinate_space(float lat, float lon) {
+    float theta = radians(lon);
+    float sigma = radians(lat);
+    float3 globe = float3(sin(theta) * cos(sigma), sin(sigma), cos(theta) * cos(sigma));
+
+    if(morph >= 0.0f) {
+        float3 flat = morph_origin.xyz + (morph_east.xyz * (lon - morph_center.y) + morph_north.xyz * (lat - morph_center.x)) * radians(WORLD_SCALE_3D);
+        return flat * (1 - morph) + globe * WORLD_SCALE_3D * morph;
+    }
+
+    if(map_mode == MAP_MODE_2D) {
+        return float3(lon / 90.0f, lat / 90.0f, 0.0f) * world_scale;
+    }
+
+    return globe * world_scale;
+}
+
 Pixel_Input vs_main(Vertex_Input input) {
+    Tile_Instance instance = instances[input.instance_id];
+
+    // Not lerp(), which isn't exact at the end points, so neighbouring tiles would not
+    // share their edge vertices exactly.
+    float lat = instance.box.x * (1 - input.uv.y) + instance.box.z * input.uv.y;
+    float lon = instance.box.y * (1 - input.uv.x) + instance.box.w * input.uv.x;
+
     Pixel_Input output;
-    output.screen_space_position = mul(projection_view, float4(input.position, 1.0f));
-    output.uv = input.uv;
+    output.screen_space_position = mul(projection_view, float4(world_from_coordinate_space(lat, lon), 1.0f));
+    output.uv = float3(input.uv, instance.layer);
     return output;
 }
 
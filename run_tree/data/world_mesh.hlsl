@@ -0,0 +1,72 @@
+//
+// Draws a tile mesh. The positions are in tile space (lon, lat, elevation, see Vertices
+// in tile.h) and projected here, so the same mesh serves both map modes. The vertices
+// are quantized to 16 bits across the box and height range of their tile (Tile_Vertex),
+// and arrive as unorms, already divided into steps from 0 to 1.
+//
+
+#define MAP_MODE_2D 0
+#define MAP_MODE_3D 1
+#define WORLD_SCALE_3D 10.0f
+
+cbuffer Camera_Constants : register(b0) {
+    float4x4 projection_view;
+    int map_mode;
+    float world_scale;
+    float morph; // Negative unless the map mode is switching, see Map_Morph in app.h
+    float4 morph_center; // lat, lon
+    float4 morph_origin;
+    float4 morph_east;
+    float4 morph_north;
+}
+
+cbuffer Tile_Mesh_Constants : register(b1) {
+    float4 box; // lat0, lon0, lat1, lon1
+    float4 heights; // height0, height1
+}
+
+Texture2DArray albedo : register(t0); // A single layer, see create_tile_texture
+SamplerState albedo_sampler : register(s0);
+
+struct Vertex_Input {
+    float4 steps : POSITION; // x, y, height, padding (see TILE_VERTEX_INPUTS)
+};
+
+struct Pixel_Input {
+    float4 screen_space_position : SV_Position;
+    float2 uv : TEXCOORD0;
+};
+
+float3 world_from_tile_space(float3 position) {
+    float lon = position.x, lat = position.y;
+    float theta = radians(lon);
+    float sigma = radians(lat);
+    float3 globe = float3(sin(theta) * cos(sigma), sin(sigma), cos(theta) * cos(sigma));
+
+    if(morph >= 0.0f) {
+        float3 flat = morph_origin.xyz + (morph_east.xyz * (lon - morph_center.y) + morph_north.xyz * (lat - morph_center.x)) * radians(WORLD_SCALE_3D);
+        return flat * (1 - morph) + globe * (WORLD_SCALE_3D + position.z) * morph;
+    }
+
+    if(map_mode == MAP_MODE_2D) {
+        return float3(lon / 90.0f, lat / 90.0f, 0.0f) * world_scale;
+    }
+
+    return globe * (world_scale + position.z);
+}
+
+Pixel_Input vs_main(Vertex_Input input) {
+    Pixel_Input output;
+    float3 steps = input.steps.xyz;
+
+    // Like decode_tile_vertex in tile.h, with the endpoint-exact form, so that neighbouring tiles share their edges.
+    float3 position = float3(box.y * (1 - steps.x) + box.w * steps.x, box.x * (1 - steps.y) + box.z * steps.y, heights.x * (1 - steps.z) + heights.y * steps.z);
+
+    output.screen_space_position = mul(projection_view, float4(world_from_tile_space(position), 1.0f));
+    output.uv = steps.xy;
+    return output;
+}
+
+float4 ps_main(Pixel_Input input) : SV_TARGET {
+    return albedo.Sample(albedo_sampler, float3(input.uv, 0));
+}
@@ -9,18 +9,26 @@
 #include <memutils.h>
 
 // --- App
+#include "log.h"
 #include "tile.h"
+#include "lod.h"
+#include "culling.h"
+#include "tile_pool.h"
+#include "tile_index.h"
+#include "paint.h"
+#include "pyramid.h"
+#include "residency.h"
+#include "prefetch.h"
+#include "picking.h"
+#include "overlay.h"
+#include "points.h"
+#include "terrain.h"
 
 #define WORLD_SCALE_2D 100
 #define WORLD_SCALE_3D 10
+#define MAP_MORPH_DURATION 0.6 // In seconds, of switching between the map modes
 
-enum Log_Level {
-	LOG_Debug,
-	LOG_Warning,
-	LOG_Error,
-};
-
-enum Map_Mode {
+enum Map_Mode : s32 {
 	MAP_MODE_2D,
 	MAP_MODE_3D,
 };
@@ -33,11 +41,33 @@ struct Camera {
 	Coordinate current_center, target_center; // The central coordinates that the camera is looking at
 	f64 zoom_level;
 	f64 current_distance, target_distance;
+	v3f position; // World space position derived from the current center and distance
+
+	// Viewport
+	s32 viewport_width, viewport_height;
 
 	// Matrix
 	m4f projection;
 	m4f view;
 	m4f projection_view;
+	m4f inverse_projection, inverse_view;
+	Frustum frustum;
+};
+
+//
+// Switching the map mode bends the tiles from the flat map onto the globe (or back) in
+// the vertex shader, instead of regenerating anything. While switching, the flat map
+// is laid onto the plane touching the globe at the camera center, in the world units
+// of the globe, and every vertex is interpolated between that plane and the globe.
+// The camera meanwhile looks down on the center from a distance in between the one
+// which shows the flat map at the scale of the 2D camera and the one of the 3D camera.
+//
+struct Map_Morph {
+	f64 remaining; // Seconds left of the current switch, 0 if there is none
+	f32 globe; // 0 while the tiles lie flat, 1 once they are bent onto the globe
+	Coordinate center; // Where the flat map touches the globe
+	v3f origin, east, north; // Of the flat map, see morph_from_coordinate_space
+	m4f projection_view; // Of the camera while switching
 };
 
 struct App {
@@ -47,9 +77,23 @@ struct App {
 	Window window;
 
 	Camera camera;
-	Map_Mode map_mode;
+	Map_Mode map_mode; // Switches right away, the drawn tiles follow through the morph
+	Map_Morph morph;
 
 	Tile root;
+	Tile_Pool tile_pool;
+	Tile_Index tile_index;
+	Residency residency;
+	Lod_Stats lod_stats;
+	Cull_Stats cull_stats;
+	Paint_Stats paint_stats;
+	Prefetcher prefetcher;
+	Pick_Result hover; // Under the mouse cursor
+	Tile_Pyramid imagery; // Optional, tiles it doesn't contain are painted
+	Overlay overlay;
+	Point_Layer points;
+	Terrain terrain;
+	G_Handle tile_index_buffers[TILE_MAX_SEGMENTS + 1]; // Shared by all tiles with the same segment count
+	Tile_Job *tile_jobs; // In flight, see flush_tile_jobs
 };
 
-void log(Log_Level level, const char *format, ...);
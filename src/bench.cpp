@@ -0,0 +1,1861 @@
+// --- C
+#include <stdlib.h>
+#include <string.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <os_specific.h>
+#include <math/maths.h>
+
+// --- App
+#include "app.h"
+#include "draw.h"
+#include "paint.h"
+#include "simulation.h"
+#include "jobs.h"
+#include "projection.h"
+#include "picking.h"
+#include "tile_index.h"
+#include "overlay.h"
+#include "points.h"
+#include "terrain.h"
+#include "profiler.h"
+#include "replay.h"
+#include "scheduler.h"
+
+//
+// Headless benchmark suite for the tile core. This links against the null graphics
+// backend (draw_null.cpp) instead of draw.cpp, so that it runs on CI machines without
+// a GPU. Usage: WorldView_Bench [subdivision_depth]
+// With --replay, it replays an input recording of the app instead (see replay.h):
+// WorldView_Bench --replay input.wvir
+//
+
+#define DEFAULT_SUBDIVISION_DEPTH 4
+#define VERTEX_ITERATIONS 2000
+#define TREE_ITERATIONS   10
+#define EXHAUSTION_DEPTH  7 // As many leaves as TILE_TEXTURE_PAGES hold
+#define CAMERA_ITERATIONS 100000
+#define LOD_FRAMES        1000
+#define CULLING_DEPTH     6 // Of the tree culled from the sample cameras
+#define PAN_FRAMES        2000
+#define GESTURE_FRAMES    120
+#define MODE_SWITCHES     20
+#define IDLE_ZOOM_FRAMES  60 // Of zooming in before letting the scene settle
+#define SETTLE_FRAMES     600 // At most, until the scheduler goes idle
+#define PICK_FRAMES       200 // Of zooming in before picking
+#define PICK_QUERIES      100000
+#define LOOKUP_QUERIES    100000
+#define RECORDING_FRAMES  1000
+#define OVERLAY_LINES     500 // Of OVERLAY_LINE_VERTICES each
+#define OVERLAY_LINE_VERTICES 500
+#define OVERLAY_POLYGONS  2000
+#define OVERLAY_FAN_VERTICES 2000 // Of a circle, which ear clipping turns into a fan of long triangles
+#define POINT_COUNT       10000000
+#define POINT_FRAMES      400 // Of zooming in and out over the points
+#define POINT_EDITS       100 // Points inserted and removed per frame
+#define POINT_CHECK_LEVEL 3 // Whose cell counts are compared against the records
+#define POINT_CHECK_CELLS 8 // Per side on that level
+#define TERRAIN_WIDTH     4097 // DEM samples
+#define TERRAIN_HEIGHT    2049
+#define PROFILE_ZONES     1000000
+#define LOG_MESSAGES      100000
+
+s64 failed_checks = 0;
+
+struct Benchmark {
+    const char *name;
+    s64 iterations;
+    f64 total, min, max; // In milliseconds
+    Hardware_Time start;
+};
+
+static
+Benchmark begin_benchmark(const char *name) {
+    Benchmark benchmark = { name, 0, 0, 1e30, 0, 0 };
+    return benchmark;
+}
+
+static inline
+void begin_sample(Benchmark *benchmark) {
+    benchmark->start = os_get_hardware_time();
+}
+
+static inline
+void end_sample(Benchmark *benchmark) {
+    f64 time = os_convert_hardware_time(os_get_hardware_time() - benchmark->start, Milliseconds);
+    benchmark->total += time;
+    benchmark->min    = min(benchmark->min, time);
+    benchmark->max    = max(benchmark->max, time);
+    ++benchmark->iterations;
+}
+
+static
+void print_benchmark(Benchmark *benchmark) {
+    printf("  %-32s %8lld iterations, avg: %10.4fms, min: %10.4fms, max: %10.4fms\n", benchmark->name, benchmark->iterations, benchmark->total / benchmark->iterations, benchmark->min, benchmark->max);
+}
+
+static
+s64 check_draw_calls(App *app) {
+    // Every drawn tile must be exactly one draw call, or one instance of a batched draw call.
+    s64 command_count;
+    Draw_Command *commands = get_recorded_draw_commands(&command_count);
+
+    s64 draw_calls = 0, instances = 0;
+
+    for(s64 i = 0; i < command_count; ++i) {
+        if(commands[i].kind == DRAW_COMMAND_Draw) {
+            ++draw_calls;
+            ++instances;
+        } else if(commands[i].kind == DRAW_COMMAND_Draw_Instanced) {
+            ++draw_calls;
+            instances += commands[i].count;
+        }
+    }
+
+    s64 tiles_drawn = app->cull_stats.tiles_drawn;
+    s64 expected_draw_calls = !draw_requires_tile_meshes() ? TILE_TEXTURE_PAGES + tiles_drawn / TILE_INSTANCE_BATCH_SIZE : tiles_drawn;
+
+    if(instances != tiles_drawn || draw_calls > expected_draw_calls) {
+        printf("  Check failed: %lld tiles drawn through %lld instances in %lld draw calls.\n", tiles_drawn, instances, draw_calls);
+        ++failed_checks;
+    }
+
+    return draw_calls;
+}
+
+static
+void create_app(App *app, s64 pool_size = 128 * ONE_MEGABYTE) {
+    app->pool.create(pool_size);
+    app->allocator = app->pool.allocator();
+
+    setup_draw_data(app);
+    create_tile_pool(app);
+    create_tile_index(app);
+    create_residency(app, RESIDENCY_DEFAULT_CPU_BUDGET, RESIDENCY_DEFAULT_GPU_BUDGET);
+
+    app->map_mode = MAP_MODE_3D;
+    app->camera.target_center    = Coordinate{ 0, 0 };
+    app->camera.zoom_level       = 0.5;
+    app->camera.target_distance  = 0;
+    app->camera.current_center   = app->camera.target_center;
+    app->camera.current_distance = app->camera.target_distance;
+}
+
+static
+void destroy_app(App *app) {
+    wait_for_tile_jobs(app);
+    destroy_tile_pool(app);
+    destroy_tile_index(app);
+    destroy_tile_index_buffers(app);
+    destroy_draw_data(app);
+    app->pool.destroy();
+}
+
+static
+void subdivide_to_depth(App *app, Tile *tile, s64 depth) {
+    if(depth <= 0) return;
+
+    subdivide_tile(app, tile);
+
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+        subdivide_to_depth(app, tile->children[i], depth - 1);
+    }
+}
+
+static
+void benchmark_vertex_generation() {
+    // Both map modes draw the same tile space mesh, see Vertices.
+    Benchmark benchmark = begin_benchmark("Vertex generation");
+    Bounding_Box box = { -45, -90, 0, -45 }; // On level 3
+    s64 segments = get_tile_segments(MAP_MODE_3D, 3, null);
+
+    for(s64 i = 0; i < VERTEX_ITERATIONS; ++i) {
+        s64 temp_mark = mark_temp_allocator();
+        begin_sample(&benchmark);
+        Vertices vertices = allocate_tile_vertices(&temp, segments);
+        create_tile_vertices(&vertices, &temp, box, 3, null);
+        end_sample(&benchmark);
+        release_temp_allocator(temp_mark);
+    }
+
+    print_benchmark(&benchmark);
+
+    //
+    // The quantized grid vertices must decode to within half a step of where they belong,
+    // and the corners exactly onto the box, which the neighbouring tiles share.
+    //
+    s64 temp_mark = mark_temp_allocator();
+    Vertices vertices = allocate_tile_vertices(&temp, segments);
+    create_tile_vertices(&vertices, &temp, box, 3, null);
+
+    f64 max_error = 0;
+    s64 stride    = segments + 1;
+
+    for(s64 i = 0; i < stride; ++i) {
+        for(s64 j = 0; j < stride; ++j) {
+            v3f position = decode_tile_vertex(&vertices.range, vertices.data[i * stride + j]);
+            f64 lat = box.lat0 + (box.lat1 - box.lat0) * (f64) i / (f64) segments;
+            f64 lon = box.lon0 + (box.lon1 - box.lon0) * (f64) j / (f64) segments;
+            max_error = max(max_error, max(fabs(position.y - lat), fabs(position.x - lon)));
+        }
+    }
+
+    v3f last = decode_tile_vertex(&vertices.range, vertices.data[stride * stride - 1]);
+    release_temp_allocator(temp_mark);
+
+    printf("  %-32s %8lld bytes per vertex, %g degrees off at most\n", "", (s64) sizeof(Tile_Vertex), max_error);
+
+    if(max_error > (box.lon1 - box.lon0) / TILE_VERTEX_STEPS || last.x != (f32) box.lon1 || last.y != (f32) box.lat1) {
+        printf("  Check failed: The quantized vertices are off by %g degrees.\n", max_error);
+        ++failed_checks;
+    }
+}
+
+static
+void benchmark_subdivision(Map_Mode map_mode, const char *name, s64 depth) {
+    Benchmark benchmark = begin_benchmark(name);
+
+    for(s64 i = 0; i < TREE_ITERATIONS; ++i) {
+        App app = {};
+        create_app(&app);
+        app.map_mode = map_mode;
+
+        begin_sample(&benchmark);
+        create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+        subdivide_to_depth(&app, &app.root, depth);
+        wait_for_tile_jobs(&app);
+        end_sample(&benchmark);
+
+        destroy_tile(&app, &app.root, true);
+        destroy_app(&app);
+    }
+
+    print_benchmark(&benchmark);
+}
+
+static
+void benchmark_mode_switch() {
+    //
+    // Switches the map mode back and forth and measures every frame of the morph, which
+    // must neither regenerate tiles nor take longer than MAP_MORPH_DURATION.
+    //
+    Benchmark benchmark = begin_benchmark("Frames of mode switches");
+
+    App app = {};
+    create_app(&app);
+    app.camera.target_center = Coordinate{ 47.0, 11.0 };
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    Frame_Input input = {};
+    input.frame_time        = 1.0 / FRAME_RATE;
+    input.viewport_width    = 1920;
+    input.viewport_height   = 1080;
+    input.mouse_wheel_turns = 0.1f;
+
+    for(s64 i = 0; i < PICK_FRAMES; ++i) {
+        simulate_one_frame(&app, &input);
+        draw_one_frame(&app);
+    }
+
+    wait_for_tile_jobs(&app);
+    input.mouse_wheel_turns = 0;
+
+    s64 expected_frames = (s64) ceil(MAP_MORPH_DURATION * FRAME_RATE);
+    s64 max_frames = 0, regenerations = 0;
+
+    for(s64 i = 0; i < MODE_SWITCHES; ++i) {
+        Map_Mode map_mode = app.map_mode;
+        s64 frames = 0;
+
+        input.toggle_map_mode = true;
+
+        do {
+            begin_sample(&benchmark);
+            simulate_one_frame(&app, &input);
+            draw_one_frame(&app);
+            end_sample(&benchmark);
+
+            if(app.root.state == TILE_Requires_Regeneration) ++regenerations;
+            input.toggle_map_mode = false;
+            ++frames;
+        } while(app.morph.remaining > 0 && frames <= expected_frames * 2);
+
+        max_frames = max(max_frames, frames);
+
+        if(app.map_mode == map_mode || app.morph.globe != (app.map_mode == MAP_MODE_3D ? 1.0f : 0.0f)) {
+            printf("  Check failed: The mode switch %lld did not finish in the other map mode.\n", i);
+            ++failed_checks;
+        }
+    }
+
+    //
+    // The morph ends on the globe and places the camera center on the touching plane
+    // of the flat map.
+    //
+    Map_Morph *morph = &app.morph;
+    Coordinate center = morph->center;
+    morph->globe = 1;
+    f32 globe_error = v3_length(morph_from_coordinate_space(morph, 12.5, -33.0, 0.1) - globe_from_coordinate_space(12.5, -33.0, WORLD_SCALE_3D + 0.1));
+    morph->globe = 0;
+    f32 flat_error = v3_length(morph_from_coordinate_space(morph, center.lat, center.lon, 0) - morph->origin);
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+
+    print_benchmark(&benchmark);
+    printf("  %-32s %8lld frames per switch at most, %lld expected\n", "", max_frames, expected_frames);
+
+    if(max_frames > expected_frames + 1) {
+        printf("  Check failed: A mode switch took %lld frames instead of %lld.\n", max_frames, expected_frames);
+        ++failed_checks;
+    }
+
+    if(regenerations) {
+        printf("  Check failed: The mode switches regenerated the tiles %lld times.\n", regenerations);
+        ++failed_checks;
+    }
+
+    if(globe_error > 1e-4f || flat_error > 1e-4f) {
+        printf("  Check failed: The morph is off the globe by %f and off the plane by %f.\n", globe_error, flat_error);
+        ++failed_checks;
+    }
+}
+
+static
+void benchmark_repaint(const char *name, s64 depth, b8 invalidate) {
+    Benchmark benchmark = begin_benchmark(name);
+
+    App app = {};
+    create_app(&app);
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+    subdivide_to_depth(&app, &app.root, depth);
+    wait_for_tile_jobs(&app);
+    draw_one_frame(&app); // Paint all tiles once
+
+    for(s64 i = 0; i < TREE_ITERATIONS; ++i) {
+        begin_sample(&benchmark);
+        if(invalidate) invalidate_tiles(&app, Bounding_Box{ 40, -10, 50, 10 });
+        draw_one_frame(&app);
+        end_sample(&benchmark);
+    }
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+
+    print_benchmark(&benchmark);
+}
+
+static
+void benchmark_paint(s64 depth) {
+    Benchmark benchmark = begin_benchmark("Repaint of every tile");
+
+    App app = {};
+    create_app(&app);
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+    subdivide_to_depth(&app, &app.root, depth);
+    wait_for_tile_jobs(&app);
+    paint_invalidated_tiles(&app);
+
+    for(s64 i = 0; i < TREE_ITERATIONS; ++i) {
+        invalidate_tiles(&app, Bounding_Box{ -90, -180, 90, 180 });
+
+        begin_sample(&benchmark);
+        paint_invalidated_tiles(&app);
+        end_sample(&benchmark);
+    }
+
+    Paint_Stats stats = app.paint_stats;
+    if(stats.uploads != (stats.tiles_painted + stats.tiles_streamed + PAINT_BATCH_SIZE - 1) / PAINT_BATCH_SIZE) {
+        printf("  Check failed: %lld tiles painted through %lld uploads.\n", stats.tiles_painted, stats.uploads);
+        ++failed_checks;
+    }
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+
+    print_benchmark(&benchmark);
+    printf("  %-32s %8lld tiles painted in %lld uploads\n", "", stats.tiles_painted, stats.uploads);
+}
+
+static
+void subdivide_leaves(App *app, Tile *tile) {
+    if(tile->leaf) {
+        subdivide_tile(app, tile);
+        return;
+    }
+
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) subdivide_leaves(app, tile->children[i]);
+}
+
+static
+s64 count_leaves_waiting_for_textures(Tile *tile, s64 *marked) {
+    // Inner tiles hand their textures back once their children can be drawn.
+    if(tile->leaf) {
+        if(tile->texture) return 0;
+        if(tile->state == TILE_Requires_Repainting) ++*marked;
+        return 1;
+    }
+
+    s64 count = 0;
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) count += count_leaves_waiting_for_textures(tile->children[i], marked);
+    return count;
+}
+
+static
+void benchmark_texture_exhaustion() {
+    //
+    // Creates more tiles than the tile texture pages hold. The ones without a texture
+    // must be skipped by the repaint and stay marked, until merges free enough textures.
+    // Only the instanced backends have a fixed number of texture layers.
+    //
+    App app = {};
+    create_app(&app);
+
+    if(draw_requires_tile_meshes()) {
+        destroy_app(&app);
+        return;
+    }
+
+    // The leaves of a full tree fill all layers, the ones split off below them can't get any.
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+    subdivide_to_depth(&app, &app.root, EXHAUSTION_DEPTH);
+    subdivide_leaves(&app, app.root.children[3]->children[3]);
+    wait_for_tile_jobs(&app);
+    paint_invalidated_tiles(&app);
+
+    s64 marked = 0;
+    s64 waiting = count_leaves_waiting_for_textures(&app.root, &marked);
+
+    if(!waiting || marked != waiting || !app.root.children_require_repainting) {
+        printf("  Check failed: %lld leaves without a texture, %lld of them still marked for repainting.\n", waiting, marked);
+        ++failed_checks;
+    }
+
+    merge_tile(&app, app.root.children[0]);
+    merge_tile(&app, app.root.children[1]);
+    paint_invalidated_tiles(&app);
+
+    s64 marked_after_merge = 0;
+    s64 waiting_after_merge = count_leaves_waiting_for_textures(&app.root, &marked_after_merge);
+
+    if(waiting_after_merge || marked_after_merge || app.root.children_require_repainting) {
+        printf("  Check failed: %lld leaves still without a texture after merging, %lld of them still marked for repainting.\n", waiting_after_merge, marked_after_merge);
+        ++failed_checks;
+    }
+
+    printf("  %-32s %8lld leaves waited for a texture\n", "Texture exhaustion", waiting);
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+}
+
+static
+void benchmark_camera_update(Map_Mode map_mode, const char *name) {
+    Benchmark benchmark = begin_benchmark(name);
+
+    App app = {};
+    create_app(&app);
+    app.map_mode = map_mode;
+
+    Frame_Input input = {};
+    input.frame_time      = 1.0 / FRAME_RATE;
+    input.viewport_width  = 1920;
+    input.viewport_height = 1080;
+    input.dragging        = true;
+
+    for(s64 i = 0; i < CAMERA_ITERATIONS; ++i) {
+        // Alternate between dragging and zooming, so that the lerps never converge.
+        input.mouse_delta_x     = (i % 64) < 32 ? 7 : -7;
+        input.mouse_delta_y     = (i % 48) < 24 ? 3 : -3;
+        input.mouse_wheel_turns = (i % 128) < 64 ? 0.25f : -0.25f;
+
+        begin_sample(&benchmark);
+        update_camera(&app, &input);
+        end_sample(&benchmark);
+    }
+
+    destroy_app(&app);
+
+    print_benchmark(&benchmark);
+}
+
+static
+v3f unproject_ndc(Camera *camera, f32 x, f32 y, f32 z) {
+    v4f view  = camera->inverse_projection * v4f(x, y, z, 1);
+    v4f world = camera->inverse_view * v4f(view.x / view.w, view.y / view.w, view.z / view.w, 1);
+    return v3f(world.x, world.y, world.z);
+}
+
+static
+b8 sphere_outside_corners(v3f corners[8], v3f center, f32 radius, f32 tolerance) {
+    //
+    // The frustum planes again, from the corners of the frustum instead of the rows of the
+    // matrix. Corners are indexed by x + 2 * y + 4 * z, with -1 and 1 in NDC as 0 and 1.
+    //
+    const s64 FACES[6][3] = { { 0, 4, 2 }, { 1, 3, 5 }, { 0, 1, 4 }, { 2, 6, 3 }, { 0, 2, 1 }, { 4, 5, 6 } };
+
+    v3f middle = v3f(0, 0, 0);
+    for(s64 i = 0; i < 8; ++i) middle = middle + corners[i] * 0.125f;
+
+    for(s64 i = 0; i < ARRAY_COUNT(FACES); ++i) {
+        v3f a = corners[FACES[i][0]], u = corners[FACES[i][1]] - a, v = corners[FACES[i][2]] - a;
+        v3f normal = v3_normalize(v3f(u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x));
+        if(v3_dot(normal, middle - a) < 0) normal = normal * -1.0f; // Pointing inwards
+
+        if(v3_dot(normal, center - a) < -radius - tolerance) return true;
+    }
+
+    return false;
+}
+
+static
+b8 tile_hidden_by_globe(Camera *camera, Tile *tile) {
+    // Every point of the tile on the sphere faces away from the camera.
+    for(s64 i = 0; i <= 8; ++i) {
+        for(s64 j = 0; j <= 8; ++j) {
+            f64 lat = tile->box.lat0 + (tile->box.lat1 - tile->box.lat0) * i / 8.0;
+            f64 lon = tile->box.lon0 + (tile->box.lon1 - tile->box.lon0) * j / 8.0;
+            if(v3_dot(globe_from_coordinate_space(lat, lon, 1.0), camera->position) > WORLD_SCALE_3D) return false;
+        }
+    }
+
+    return true;
+}
+
+static
+void check_culled_tiles(Camera *camera, Map_Mode map_mode, v3f corners[8], Tile *tile, Cull_Result parent_result, s64 *culled, s64 *kept, s64 *wrong) {
+    Cull_Result result = cull_tile(camera, map_mode, tile, parent_result);
+    Tile_Bounds *bounds = &tile->bounds[map_mode];
+    f32 tolerance = 1e-4f * (v3_length(bounds->center) + bounds->radius);
+
+    if(result == CULL_Outside) {
+        ++*culled;
+        if(!sphere_outside_corners(corners, bounds->center, bounds->radius, -tolerance) && !(map_mode == MAP_MODE_3D && tile_hidden_by_globe(camera, tile))) ++*wrong;
+        return;
+    }
+
+    ++*kept;
+    if(sphere_outside_corners(corners, bounds->center, bounds->radius, tolerance)) ++*wrong;
+
+    if(map_mode == MAP_MODE_3D) {
+        // The horizon test of the bounds, in f64.
+        f64 camera_distance = v3_length(camera->position);
+        f64 axis_angle = acos(clamp((f64) v3_dot(bounds->cone_axis, camera->position) / camera_distance, -1.0, 1.0));
+        if(camera_distance > WORLD_SCALE_3D && axis_angle - bounds->cone_angle > acos(WORLD_SCALE_3D / camera_distance) + 1e-4) ++*wrong;
+    }
+
+    if(tile->leaf) return;
+
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+        check_culled_tiles(camera, map_mode, corners, tile->children[i], result, culled, kept, wrong);
+    }
+}
+
+static
+void benchmark_culling(Map_Mode map_mode, const char *name) {
+    //
+    // Culls a fixed tree from a few sample cameras and checks every decision against the
+    // geometry: Culled subtrees must be outside of the frustum or behind the horizon,
+    // kept tiles must be neither. Descendants of culled subtrees aren't visited, just
+    // like when drawing.
+    //
+    struct Sample_Camera { f64 lat, lon, zoom_level; };
+    const Sample_Camera cameras[] = { { 0, 0, 0.1 }, { 37.5, -122.25, 0.4 }, { -60, 150, 0.7 }, { 85, -30, 0.5 }, { 10, 179, 0.9 } };
+
+    App app = {};
+    create_app(&app);
+    app.map_mode = map_mode;
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+    subdivide_to_depth(&app, &app.root, CULLING_DEPTH);
+    wait_for_tile_jobs(&app);
+
+    Frame_Input input = {};
+    input.frame_time      = 1.0 / FRAME_RATE;
+    input.viewport_width  = 1920;
+    input.viewport_height = 1080;
+
+    s64 culled = 0, kept = 0, wrong = 0;
+
+    for(s64 i = 0; i < ARRAY_COUNT(cameras); ++i) {
+        // Jump to the sample camera without letting the LOD change the tree.
+        Camera *camera = &app.camera;
+        camera->zoom_level = cameras[i].zoom_level;
+        update_camera(&app, &input);
+        camera->current_center   = Coordinate{ cameras[i].lat, cameras[i].lon };
+        camera->current_distance = camera->target_distance;
+        update_camera_matrices(camera, map_mode);
+
+        v3f corners[8];
+        for(s64 j = 0; j < 8; ++j) corners[j] = unproject_ndc(camera, (j & 1) ? 1.0f : -1.0f, (j & 2) ? 1.0f : -1.0f, (j & 4) ? 1.0f : -1.0f);
+
+        check_culled_tiles(camera, map_mode, corners, &app.root, CULL_Intersecting, &culled, &kept, &wrong);
+    }
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+
+    printf("  %-32s %8lld subtrees culled, %lld tiles kept from %lld cameras\n", name, culled, kept, (s64) ARRAY_COUNT(cameras));
+
+    if(wrong) {
+        printf("  Check failed: %s culled or kept %lld tiles against their bounds.\n", name, wrong);
+        ++failed_checks;
+    }
+}
+
+static
+void benchmark_lod_zoom(Map_Mode map_mode, const char *name) {
+    Benchmark benchmark = begin_benchmark(name);
+
+    App app = {};
+    create_app(&app);
+    app.map_mode = map_mode;
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    Frame_Input input = {};
+    input.frame_time      = 1.0 / FRAME_RATE;
+    input.viewport_width  = 1920;
+    input.viewport_height = 1080;
+
+    s64 max_leaves = 0, max_drawn = 0, max_draw_calls = 0;
+
+    for(s64 i = 0; i < LOD_FRAMES; ++i) {
+        // Zoom all the way in and back out again.
+        input.mouse_wheel_turns = (i < LOD_FRAMES / 2) ? 0.1f : -0.1f;
+
+        begin_sample(&benchmark);
+        simulate_one_frame(&app, &input);
+        draw_one_frame(&app);
+        end_sample(&benchmark);
+
+        max_leaves     = max(max_leaves, app.lod_stats.leaves);
+        max_drawn      = max(max_drawn, app.cull_stats.tiles_drawn);
+        max_draw_calls = max(max_draw_calls, check_draw_calls(&app));
+    }
+
+    Tile_Pool_Stats pool_stats = app.tile_pool.stats;
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+
+    print_benchmark(&benchmark);
+    printf("  %-32s %8lld textures created, %lld reused; %lld meshes created, %lld reused\n", "", pool_stats.textures_created, pool_stats.textures_reused, pool_stats.meshes_created, pool_stats.meshes_reused);
+    printf("  %-32s %8lld leaves at most, %lld at the end, %lld drawn at most in %lld draw calls\n", "", max_leaves, app.lod_stats.leaves, max_drawn, max_draw_calls);
+}
+
+static
+void benchmark_scheduler(Map_Mode map_mode, const char *name) {
+    //
+    // Zooms in, lets the scene settle until the scheduler skips frames, then checks
+    // that input and invalidated tiles wake it up again. The samples are all frames
+    // drawn until then.
+    //
+    Benchmark benchmark = begin_benchmark(name);
+
+    App app = {};
+    create_app(&app);
+    app.map_mode = map_mode;
+    app.camera.target_center = Coordinate{ 37.5, -122.25 };
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    Frame_Scheduler scheduler;
+    create_frame_scheduler(&scheduler);
+
+    Frame_Input input = {};
+    input.frame_time        = 1.0 / FRAME_RATE;
+    input.viewport_width    = 1920;
+    input.viewport_height   = 1080;
+    input.mouse_wheel_turns = 0.1f;
+
+    s64 frames = 0;
+
+    for(s64 i = 0; i < IDLE_ZOOM_FRAMES + SETTLE_FRAMES; ++i) {
+        if(i == IDLE_ZOOM_FRAMES) input.mouse_wheel_turns = 0;
+        if(!frame_is_required(&scheduler, &app, &input)) break;
+
+        begin_sample(&benchmark);
+        simulate_one_frame(&app, &input);
+        draw_one_frame(&app);
+        end_sample(&benchmark);
+
+        finish_scheduled_frame(&scheduler, &app, &input, 1.0 / FRAME_RATE);
+        ++frames;
+    }
+
+    print_benchmark(&benchmark);
+    printf("  %-32s %8lld frames drawn until idle, %d of them zooming\n", "", frames, IDLE_ZOOM_FRAMES);
+
+    if(!scheduler.settled || frame_is_required(&scheduler, &app, &input)) {
+        printf("  Check failed: %s didn't go idle within %d frames.\n", name, SETTLE_FRAMES);
+        ++failed_checks;
+    }
+
+    Frame_Input wheel = input;
+    wheel.mouse_wheel_turns = 0.1f;
+    Frame_Input resize = input;
+    resize.viewport_width = 1280;
+
+    Frame_Input drag = input;
+    drag.dragging      = true;
+    drag.mouse_delta_x = 40;
+
+    if(!frame_is_required(&scheduler, &app, &wheel) || !frame_is_required(&scheduler, &app, &resize) || !frame_is_required(&scheduler, &app, &drag)) {
+        printf("  Check failed: %s stayed idle despite input.\n", name);
+        ++failed_checks;
+    }
+
+    // Hovering only re-picks.
+    Frame_Input hover = input;
+    hover.mouse_x       = input.viewport_width / 2 + 100;
+    hover.mouse_y       = input.viewport_height / 2;
+    hover.mouse_delta_x = 100;
+
+    Pick_Result expected = pick_tile(&app, (f32) hover.mouse_x, (f32) hover.mouse_y);
+    b8 hover_drew = frame_is_required(&scheduler, &app, &hover);
+    update_idle_hover(&scheduler, &app, &hover);
+
+    if(hover_drew || app.hover.hit != expected.hit || app.hover.coordinate.lat != expected.coordinate.lat || app.hover.coordinate.lon != expected.coordinate.lon) {
+        printf("  Check failed: %s %s a frame for moving the mouse, and picked %f, %f instead of %f, %f.\n", name, hover_drew ? "required" : "didn't require",
+               app.hover.coordinate.lat, app.hover.coordinate.lon, expected.coordinate.lat, expected.coordinate.lon);
+        ++failed_checks;
+    }
+
+    invalidate_tiles(&app, Bounding_Box{ 37, -123, 38, -122 });
+
+    if(!frame_is_required(&scheduler, &app, &input)) {
+        printf("  Check failed: %s stayed idle despite invalidated tiles.\n", name);
+        ++failed_checks;
+    }
+
+    //
+    // Frames which miss their budget drop the rate to the next even divisor, cheap
+    // frames bring it back up.
+    //
+    create_frame_scheduler(&scheduler);
+    for(s64 i = 0; i < FRAME_RATE; ++i) finish_scheduled_frame(&scheduler, &app, &input, 2.5 / FRAME_RATE);
+    f32 loaded_rate = get_scheduled_frame_rate(&scheduler);
+    for(s64 i = 0; i < FRAME_RATE; ++i) finish_scheduled_frame(&scheduler, &app, &input, 0.1 / FRAME_RATE);
+    f32 recovered_rate = get_scheduled_frame_rate(&scheduler);
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+
+    if(loaded_rate != (f32) FRAME_RATE / SCHEDULER_MAX_RATE_DIVISOR || recovered_rate != (f32) FRAME_RATE) {
+        printf("  Check failed: The frame rate adapted to %f under load and to %f without.\n", loaded_rate, recovered_rate);
+        ++failed_checks;
+    }
+}
+
+static
+void benchmark_picking(Map_Mode map_mode, const char *name) {
+    Benchmark benchmark = begin_benchmark(name);
+
+    App app = {};
+    create_app(&app);
+    app.map_mode = map_mode;
+    app.camera.target_center = Coordinate{ 37.5, -122.25 };
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    Frame_Input input = {};
+    input.frame_time        = 1.0 / FRAME_RATE;
+    input.viewport_width    = 1920;
+    input.viewport_height   = 1080;
+    input.mouse_x           = input.viewport_width / 2;
+    input.mouse_y           = input.viewport_height / 2;
+    input.mouse_wheel_turns = 0.1f;
+
+    // Zoom in so that the queries have to descend a deep tree.
+    for(s64 i = 0; i < PICK_FRAMES; ++i) {
+        simulate_one_frame(&app, &input);
+        draw_one_frame(&app);
+    }
+
+    // The camera looks at its center in both modes.
+    Coordinate center = app.camera.current_center;
+    if(!app.hover.hit || fabs(app.hover.coordinate.lat - center.lat) > 1e-3 || fabs(app.hover.coordinate.lon - center.lon) > 1e-3) {
+        printf("  Check failed: %s picked %f, %f instead of the center %f, %f.\n", name, app.hover.coordinate.lat, app.hover.coordinate.lon, center.lat, center.lon);
+        ++failed_checks;
+    }
+
+    s64 hits = 0, levels = 0, misplaced = 0;
+
+    begin_sample(&benchmark);
+    for(s64 i = 0; i < PICK_QUERIES; ++i) {
+        // Sweep the whole viewport in a pattern that doesn't repeat the same pixels.
+        f32 x = (f32) ((i * 7919) % input.viewport_width);
+        f32 y = (f32) ((i * 104729) % input.viewport_height);
+
+        Pick_Result result = pick_tile(&app, x, y);
+        if(!result.hit) continue;
+
+        ++hits;
+        levels += result.level;
+
+        Bounding_Box box = result.tile->box;
+        if(!(result.tile->leaf || result.tile->texture) || result.coordinate.lat < box.lat0 || result.coordinate.lat > box.lat1 || result.coordinate.lon < box.lon0 || result.coordinate.lon > box.lon1) ++misplaced;
+    }
+    end_sample(&benchmark);
+
+    if(misplaced) {
+        printf("  Check failed: %s returned %lld tiles that aren't drawn or don't contain the picked coordinate.\n", name, misplaced);
+        ++failed_checks;
+    }
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+
+    print_benchmark(&benchmark);
+    printf("  %-32s %8.1f ns per query, %lld hits, %.1f levels deep on average\n", "", benchmark.total * 1e6 / PICK_QUERIES, hits, hits ? (f64) levels / hits : 0.0);
+}
+
+static
+s64 check_tile_index(App *app, Tile *tile) {
+    // Every tile in the tree has to be found under its address, and its east neighbour has to touch it.
+    s64 misses = find_tile(app, tile->level, tile->x, tile->y) != tile;
+
+    Tile *east = find_tile_neighbour(app, tile, 1, 0);
+    if(east && east->box.lon0 != (tile->box.lon1 == 180.0 ? -180.0 : tile->box.lon1)) ++misses;
+
+    if(!tile->leaf) {
+        for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) misses += check_tile_index(app, tile->children[i]);
+    }
+
+    return misses;
+}
+
+static
+s64 count_tiles(Tile *tile) {
+    s64 count = 1;
+
+    if(!tile->leaf) {
+        for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) count += count_tiles(tile->children[i]);
+    }
+
+    return count;
+}
+
+static
+void benchmark_tile_lookup(Map_Mode map_mode, const char *mode_name) {
+    App app = {};
+    create_app(&app);
+    app.map_mode = map_mode;
+    app.camera.target_center = Coordinate{ 37.5, -122.25 };
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    Frame_Input input = {};
+    input.frame_time        = 1.0 / FRAME_RATE;
+    input.viewport_width    = 1920;
+    input.viewport_height   = 1080;
+    input.mouse_wheel_turns = 0.1f;
+
+    for(s64 i = 0; i < PICK_FRAMES; ++i) {
+        simulate_one_frame(&app, &input);
+        draw_one_frame(&app);
+    }
+
+    s64 tile_count = count_tiles(&app.root);
+    s64 misses = check_tile_index(&app, &app.root);
+    if(misses || app.tile_index.count != tile_count) {
+        printf("  Check failed: The tile index holds %lld tiles for a tree of %lld, %lld lookups went wrong.\n", app.tile_index.count, tile_count, misses);
+        ++failed_checks;
+    }
+
+    //
+    // Look up the tiles of the deepest level around the camera center, once by walking
+    // down the tree and once through the index.
+    //
+    Tile *deepest = find_drawn_tile(&app.root, app.camera.current_center);
+    Bounding_Box area = deepest->parent ? deepest->parent->box : deepest->box;
+    s64 level = deepest->level;
+
+    char names[2][64];
+    snprintf(names[0], sizeof(names[0]), "Tile lookup, tree walk (%s)", mode_name);
+    snprintf(names[1], sizeof(names[1]), "Tile lookup, index (%s)", mode_name);
+    Benchmark benchmarks[2] = { begin_benchmark(names[0]), begin_benchmark(names[1]) };
+    s64 found[2] = { 0, 0 };
+
+    for(s64 k = 0; k < 2; ++k) {
+        begin_sample(&benchmarks[k]);
+        for(s64 i = 0; i < LOOKUP_QUERIES; ++i) {
+            Coordinate coordinate = { area.lat0 + (area.lat1 - area.lat0) * ((i * 7919) % 1000) / 1000.0, area.lon0 + (area.lon1 - area.lon0) * ((i * 104729) % 1000) / 1000.0 };
+
+            Tile *tile;
+            if(k == 0) {
+                tile = &app.root;
+                while(!tile->leaf && tile->level < level) {
+                    f64 lat_center = (tile->box.lat0 + tile->box.lat1) * 0.5;
+                    f64 lon_center = (tile->box.lon0 + tile->box.lon1) * 0.5;
+                    tile = tile->children[(coordinate.lat >= lat_center) * 2 + (coordinate.lon >= lon_center)];
+                }
+                if(tile->level != level) tile = null;
+            } else {
+                tile = find_tile(&app, level, coordinate);
+            }
+
+            found[k] += tile != null;
+        }
+        end_sample(&benchmarks[k]);
+    }
+
+    if(found[0] != found[1]) {
+        printf("  Check failed: The index found %lld tiles, walking the tree found %lld.\n", found[1], found[0]);
+        ++failed_checks;
+    }
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+
+    for(s64 k = 0; k < 2; ++k) {
+        print_benchmark(&benchmarks[k]);
+        printf("  %-32s %8.1f ns per query, %lld tiles found on level %lld\n", "", benchmarks[k].total * 1e6 / LOOKUP_QUERIES, found[k], level);
+    }
+}
+
+static
+void benchmark_overlay() {
+    App app = {};
+    create_app(&app);
+
+    //
+    // Random walks standing in for coastlines and borders, and small hexagons standing
+    // in for areas, all over the northern hemisphere.
+    //
+    Coordinate *coordinates = (Coordinate *) malloc(OVERLAY_LINE_VERTICES * sizeof(Coordinate));
+    u64 seed = 0x2545f4914f6cdd1d;
+
+    for(s64 i = 0; i < OVERLAY_LINES + OVERLAY_POLYGONS; ++i) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        Coordinate position = { (f64) (seed >> 40) / (1 << 24) * 80.0, (f64) ((seed >> 16) & 0xffffff) / (1 << 24) * 340.0 - 170.0 };
+
+        if(i < OVERLAY_LINES) {
+            for(s64 j = 0; j < OVERLAY_LINE_VERTICES; ++j) {
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                position.lat = clamp(position.lat + ((f64) ((seed >> 40) & 0xff) / 255.0 - 0.5) * 0.05, -90.0, 90.0);
+                position.lon = clamp(position.lon + ((f64) ((seed >> 48) & 0xff) / 255.0 - 0.5) * 0.05, -180.0, 180.0);
+                coordinates[j] = position;
+            }
+
+            add_overlay_feature(&app, OVERLAY_Polyline, v4f(1, 0, 0, 1), coordinates, OVERLAY_LINE_VERTICES);
+        } else {
+            const f64 HEXAGON[6][2] = { { 0, 0.1 }, { 0.087, 0.05 }, { 0.087, -0.05 }, { 0, -0.1 }, { -0.087, -0.05 }, { -0.087, 0.05 } };
+            for(s64 j = 0; j < 6; ++j) coordinates[j] = Coordinate{ position.lat + HEXAGON[j][0], position.lon + HEXAGON[j][1] };
+            add_overlay_feature(&app, OVERLAY_Polygon, v4f(0, 0, 1, 0.5f), coordinates, 6);
+        }
+    }
+
+    free(coordinates);
+
+    Hardware_Time start = os_get_hardware_time();
+    build_overlay(&app);
+    Hardware_Time end = os_get_hardware_time();
+
+    printf("  %-32s %8lld primitives in %lld buckets, built in %fms\n", "Overlay", app.overlay.primitive_count, app.overlay.bucket_count, os_convert_hardware_time(end - start, Milliseconds));
+
+    //
+    // Paint the tiles containing one of the features on every fourth level. The deeper
+    // the tile, the fewer primitives it should have to look at.
+    //
+    Coordinate center = app.overlay.vertices[OVERLAY_LINE_VERTICES / 2];
+    u32 pixels[PAINT_TILE_PIXELS];
+
+    for(s64 level = 0; level <= 16; level += 4) {
+        s64 x, y;
+        get_tile_position(level, center, &x, &y);
+
+        f64 tiles_per_side = (f64) ((s64) 1 << level);
+        Bounding_Box box = { -90.0 + 180.0 * y / tiles_per_side, -180.0 + 360.0 * x / tiles_per_side, -90.0 + 180.0 * (y + 1) / tiles_per_side, -180.0 + 360.0 * (x + 1) / tiles_per_side };
+
+        char name[64];
+        snprintf(name, sizeof(name), "Overlay paint, level %lld", level);
+        Benchmark benchmark = begin_benchmark(name);
+
+        app.overlay.stats = Overlay_Stats{};
+        for(s64 i = 0; i < TREE_ITERATIONS; ++i) {
+            paint_fill(pixels, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, v4f(0, 0, 0, 1));
+            begin_sample(&benchmark);
+            paint_overlay(&app, box, pixels);
+            end_sample(&benchmark);
+        }
+
+        s64 primitives = app.overlay.stats.primitives_painted / TREE_ITERATIONS;
+        print_benchmark(&benchmark);
+        printf("  %-32s %8lld primitives, %lld buckets visited per tile\n", "", primitives, app.overlay.stats.buckets_visited / TREE_ITERATIONS);
+
+        if(level >= 12 && primitives * 100 > app.overlay.primitive_count) {
+            printf("  Check failed: A tile on level %lld had to look at %lld of %lld primitives.\n", level, primitives, app.overlay.primitive_count);
+            ++failed_checks;
+        }
+    }
+
+    destroy_overlay(&app);
+
+    //
+    // Thousands of triangles overlapping in the middle of a large polygon. Buckets can't
+    // separate those, so they must neither split all the way down nor copy the triangles.
+    //
+    coordinates = (Coordinate *) malloc(OVERLAY_FAN_VERTICES * sizeof(Coordinate));
+    for(s64 i = 0; i < OVERLAY_FAN_VERTICES; ++i) {
+        f64 angle = 2.0 * PI * (f64) i / (f64) OVERLAY_FAN_VERTICES;
+        coordinates[i] = Coordinate{ 20.0 + 30.0 * sin(angle), 10.0 + 30.0 * cos(angle) };
+    }
+
+    add_overlay_feature(&app, OVERLAY_Polygon, v4f(0, 1, 0, 0.5f), coordinates, OVERLAY_FAN_VERTICES);
+    free(coordinates);
+
+    start = os_get_hardware_time();
+    build_overlay(&app);
+    end = os_get_hardware_time();
+
+    printf("  %-32s %8lld primitives in %lld buckets, built in %fms\n", "Overlay fan", app.overlay.primitive_count, app.overlay.bucket_count, os_convert_hardware_time(end - start, Milliseconds));
+
+    if(app.overlay.primitive_count != OVERLAY_FAN_VERTICES - 2 || app.overlay.bucket_primitive_count != app.overlay.primitive_count || app.overlay.bucket_count > app.overlay.primitive_count) {
+        printf("  Check failed: %lld fan triangles were bucketed %lld times into %lld buckets.\n", app.overlay.primitive_count, app.overlay.bucket_primitive_count, app.overlay.bucket_count);
+        ++failed_checks;
+    }
+
+    destroy_overlay(&app);
+    destroy_app(&app);
+}
+
+static
+void benchmark_points(Map_Mode map_mode, const char *name) {
+    //
+    // Points clustered around a few hundred cities, written to a point file so that
+    // the ingestion goes through the same path as in the app.
+    //
+    const char *file_path = "bench_points.wvpt";
+
+    Point_Record *records = (Point_Record *) malloc(POINT_COUNT * sizeof(Point_Record));
+    u64 seed = 0x9e3779b97f4a7c15;
+    Point_Record city = {};
+
+    for(s64 i = 0; i < POINT_COUNT; ++i) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+
+        if(i % (POINT_COUNT / 256) == 0) city = Point_Record{ (f32) ((seed >> 40) / (f64) (1 << 24) * 120.0 - 60.0), (f32) (((seed >> 16) & 0xffffff) / (f64) (1 << 24) * 340.0 - 170.0) };
+
+        f32 spread = (i & 1) ? 0.2f : 5.0f; // Dense city centers and wider suburbs
+        records[i].lat = clamp(city.lat + ((f32) ((seed >> 40) & 0xffff) / 65535.0f - 0.5f) * spread, -90.0f, 90.0f);
+        records[i].lon = clamp(city.lon + ((f32) ((seed >> 24) & 0xffff) / 65535.0f - 0.5f) * spread, -180.0f, 180.0f);
+    }
+
+    FILE *file = fopen(file_path, "wb");
+    if(!file) {
+        printf("  Check failed: Could not write '%s'.\n", file_path);
+        ++failed_checks;
+        free(records);
+        return;
+    }
+
+    Point_File_Header header = { POINT_FILE_MAGIC, POINT_FILE_VERSION, POINT_COUNT };
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(records, sizeof(Point_Record), POINT_COUNT, file);
+    fclose(file);
+
+    App app = {};
+    create_app(&app, 512 * ONE_MEGABYTE);
+    app.map_mode = map_mode;
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    Hardware_Time start = os_get_hardware_time();
+    b8 loaded = load_points(&app, file_path);
+    Hardware_Time end = os_get_hardware_time();
+    remove(file_path);
+
+    f64 ingest_time = os_convert_hardware_time(end - start, Milliseconds);
+    printf("  %-32s %8lld points ingested in %fms (%.1f million points per second)\n", name, app.points.live_count, ingest_time, app.points.live_count / ingest_time / 1000.0);
+
+    if(!loaded || app.points.live_count != POINT_COUNT || app.points.counts[0][0] != POINT_COUNT) {
+        printf("  Check failed: %lld of %d points loaded, %u counted at the root.\n", app.points.live_count, POINT_COUNT, loaded ? app.points.counts[0][0] : 0);
+        ++failed_checks;
+    }
+
+    //
+    // Every cell of a level below the root has to count the records that fall into it.
+    //
+    u32 cell_counts[POINT_CHECK_CELLS * POINT_CHECK_CELLS] = {};
+    for(s64 i = 0; i < POINT_COUNT; ++i) {
+        s64 x, y;
+        get_tile_position(POINT_CHECK_LEVEL, Coordinate{ records[i].lat, records[i].lon }, &x, &y);
+        ++cell_counts[y * POINT_CHECK_CELLS + x];
+    }
+
+    s64 wrong_cells = 0;
+    for(s64 y = 0; y < POINT_CHECK_CELLS; ++y) {
+        for(s64 x = 0; x < POINT_CHECK_CELLS; ++x) {
+            if(count_points(&app, POINT_CHECK_LEVEL, x, y) != cell_counts[y * POINT_CHECK_CELLS + x]) ++wrong_cells;
+        }
+    }
+
+    if(wrong_cells) {
+        printf("  Check failed: %lld of %d cells on level %d counted the wrong number of points.\n", wrong_cells, POINT_CHECK_CELLS * POINT_CHECK_CELLS, POINT_CHECK_LEVEL);
+        ++failed_checks;
+    }
+
+    //
+    // Zoom into the first city and back out while points come and go around it, which
+    // has to repaint the tiles over the edited cells every frame.
+    //
+    Benchmark benchmark = begin_benchmark(name);
+
+    Frame_Input input = {};
+    input.frame_time      = 1.0 / FRAME_RATE;
+    input.viewport_width  = 1920;
+    input.viewport_height = 1080;
+
+    app.camera.target_center = Coordinate{ records[0].lat, records[0].lon };
+
+    s64 ids[POINT_EDITS];
+    for(s64 i = 0; i < POINT_EDITS; ++i) ids[i] = -1;
+
+    for(s64 i = 0; i < POINT_FRAMES; ++i) {
+        input.mouse_wheel_turns = (i < POINT_FRAMES / 2) ? 0.1f : -0.1f;
+
+        begin_sample(&benchmark);
+
+        for(s64 j = 0; j < POINT_EDITS; ++j) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            remove_point(&app, ids[j]);
+            ids[j] = insert_point(&app, Coordinate{ records[0].lat + ((f64) ((seed >> 40) & 0xffff) / 65535.0 - 0.5) * 0.2, records[0].lon + ((f64) ((seed >> 24) & 0xffff) / 65535.0 - 0.5) * 0.2 });
+        }
+
+        simulate_one_frame(&app, &input);
+        draw_one_frame(&app);
+        end_sample(&benchmark);
+    }
+
+    wait_for_tile_jobs(&app);
+
+    if(app.points.live_count != POINT_COUNT + POINT_EDITS || app.points.counts[0][0] != POINT_COUNT + POINT_EDITS) {
+        printf("  Check failed: %lld points after editing, %u counted at the root.\n", app.points.live_count, app.points.counts[0][0]);
+        ++failed_checks;
+    }
+
+    Point_Layer_Stats stats = app.points.stats;
+
+    free(records);
+    destroy_tile(&app, &app.root, true);
+    destroy_point_layer(&app);
+    destroy_app(&app);
+
+    print_benchmark(&benchmark);
+    printf("  %-32s %8lld tiles painted with %lld clusters\n", "", stats.tiles_painted, stats.clusters_painted);
+}
+
+static
+s64 check_skirts(Terrain *terrain, s64 level, s64 x, s64 y, s64 gap) {
+    //
+    // Builds a tile and the neighbour gap levels above it, which shares the east edge of
+    // the tile with its west edge, and checks that along that edge the skirts of the two
+    // meshes overlap radially everywhere, so that no crack can open up between them.
+    // Returns the number of edge samples with a crack.
+    //
+    s64 temp_mark = mark_temp_allocator();
+
+    s64 coarse_level = level - gap, coarse_x = (x + 1) >> gap, coarse_y = y >> gap;
+    Bounding_Box fine_box = get_cell_box(level, x, y), coarse_box = get_cell_box(coarse_level, coarse_x, coarse_y);
+
+    Vertices fine = allocate_tile_vertices(&temp, get_tile_segments(MAP_MODE_3D, level, terrain));
+    create_tile_vertices(&fine, &temp, fine_box, level, terrain);
+
+    Vertices coarse = allocate_tile_vertices(&temp, get_tile_segments(MAP_MODE_3D, coarse_level, terrain));
+    create_tile_vertices(&coarse, &temp, coarse_box, coarse_level, terrain);
+
+    v3f *fine_positions   = (v3f *) temp.allocate(fine.count * sizeof(v3f));
+    v3f *coarse_positions = (v3f *) temp.allocate(coarse.count * sizeof(v3f));
+    for(s64 i = 0; i < fine.count; ++i)   fine_positions[i]   = world_from_tile_space(MAP_MODE_3D, decode_tile_vertex(&fine.range, fine.data[i]));
+    for(s64 i = 0; i < coarse.count; ++i) coarse_positions[i] = world_from_tile_space(MAP_MODE_3D, decode_tile_vertex(&coarse.range, coarse.data[i]));
+
+    s64 fine_stride = fine.segments + 1, coarse_stride = coarse.segments + 1;
+    s64 cracks = 0;
+
+    for(s64 k = 0; k < fine.segments * 2 + 1; ++k) {
+        // Edge vertices and the middles of the edge segments, where the fine edge is lowest.
+        s64 k0 = k / 2, k1 = min<s64>(k0 + (k & 1), fine.segments);
+        v3f fine_top    = (fine_positions[k0 * fine_stride + fine.segments] + fine_positions[k1 * fine_stride + fine.segments]) * 0.5f;
+        v3f fine_bottom = (fine_positions[fine_stride * fine_stride + 3 * fine_stride + k0] + fine_positions[fine_stride * fine_stride + 3 * fine_stride + k1]) * 0.5f;
+
+        f64 lat = fine_box.lat0 + (fine_box.lat1 - fine_box.lat0) * (f64) k / (f64) (fine.segments * 2);
+        f64 t   = (lat - coarse_box.lat0) / (coarse_box.lat1 - coarse_box.lat0) * (f64) coarse.segments;
+        s64 c0  = min<s64>((s64) t, coarse.segments - 1);
+        f32 u   = (f32) (t - (f64) c0);
+
+        v3f coarse_top    = coarse_positions[c0 * coarse_stride] * (1 - u) + coarse_positions[(c0 + 1) * coarse_stride] * u;
+        v3f coarse_bottom = coarse_positions[coarse_stride * coarse_stride + 2 * coarse_stride + c0] * (1 - u) + coarse_positions[coarse_stride * coarse_stride + 2 * coarse_stride + c0 + 1] * u;
+
+        const f32 EPSILON = 1e-5f;
+        if(v3_length(fine_bottom) > v3_length(coarse_top) + EPSILON || v3_length(coarse_bottom) > v3_length(fine_top) + EPSILON) ++cracks;
+    }
+
+    release_temp_allocator(temp_mark);
+    return cracks;
+}
+
+static
+s64 count_leaves_without_meshes(Tile *tile) {
+    if(tile->leaf) return tile->mesh ? 0 : 1;
+
+    s64 count = 0;
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) count += count_leaves_without_meshes(tile->children[i]);
+    return count;
+}
+
+static
+void benchmark_terrain() {
+    //
+    // A synthetic DEM with continents, mountain ranges and some noise, written to a
+    // terrain file so that loading goes through the same path as in the app.
+    //
+    const char *file_path = "bench_terrain.wvdm";
+
+    s64 count = (s64) TERRAIN_WIDTH * TERRAIN_HEIGHT;
+    s16 *heights = (s16 *) malloc(count * sizeof(s16));
+    u64 seed = 0x853c49e6748fea9b;
+
+    for(s64 row = 0; row < TERRAIN_HEIGHT; ++row) {
+        f64 lat = degrees_to_radians(-90.0 + 180.0 * row / (TERRAIN_HEIGHT - 1));
+
+        for(s64 column = 0; column < TERRAIN_WIDTH; ++column) {
+            f64 lon = degrees_to_radians(-180.0 + 360.0 * column / (TERRAIN_WIDTH - 1));
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+
+            f64 height = 2500.0 * sin(lat * 3.0) * cos(lon * 2.0) + 2000.0 * fabs(sin(lat * 17.0 + lon * 13.0)) + 300.0 * sin(lat * 97.0) * sin(lon * 89.0) + (f64) ((seed >> 40) & 0xff) - 128.0;
+            heights[row * TERRAIN_WIDTH + column] = (s16) clamp(height, -8000.0, 8000.0);
+        }
+    }
+
+    FILE *file = fopen(file_path, "wb");
+    if(!file) {
+        printf("  Check failed: Could not write '%s'.\n", file_path);
+        ++failed_checks;
+        free(heights);
+        return;
+    }
+
+    Terrain_File_Header header = { TERRAIN_FILE_MAGIC, TERRAIN_FILE_VERSION, TERRAIN_WIDTH, TERRAIN_HEIGHT };
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(heights, sizeof(s16), count, file);
+    fclose(file);
+    free(heights);
+
+    App app = {};
+    create_app(&app);
+
+    Hardware_Time start = os_get_hardware_time();
+    b8 loaded = load_terrain(&app, file_path);
+    Hardware_Time end = os_get_hardware_time();
+    remove(file_path);
+
+    printf("  %-32s %8lld samples loaded in %fms\n", "Terrain", loaded ? count : 0, os_convert_hardware_time(end - start, Milliseconds));
+
+    if(!loaded) {
+        printf("  Check failed: Could not load the terrain.\n");
+        ++failed_checks;
+        destroy_app(&app);
+        return;
+    }
+
+    //
+    // The instanced unit grid can't show the heights, so the instanced build has to have
+    // switched to tile meshes, with skirts.
+    //
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+    subdivide_to_depth(&app, &app.root, 2);
+    wait_for_tile_jobs(&app);
+
+    s64 without_meshes = count_leaves_without_meshes(&app.root);
+    if(!draw_requires_tile_meshes() || without_meshes) {
+        printf("  Check failed: %lld of the tiles on the terrain have no mesh.\n", without_meshes);
+        ++failed_checks;
+    }
+
+    destroy_tile(&app, &app.root, true);
+
+    //
+    // Coarse tiles only have to follow the globe, the terrain needs finer grids on the
+    // deeper levels until they resolve the DEM.
+    //
+    printf("  %-32s", "Segments per level (sphere)");
+    for(s64 level = 0; level <= LOD_MAX_LEVEL; ++level) printf(" %lld", get_tile_segments(MAP_MODE_3D, level, null));
+    printf("\n  %-32s", "Segments per level (terrain)");
+    for(s64 level = 0; level <= LOD_MAX_LEVEL; ++level) printf(" %lld", get_tile_segments(MAP_MODE_3D, level, &app.terrain));
+    printf("\n");
+
+    if(get_tile_segments(MAP_MODE_3D, 0, &app.terrain) >= 32 || get_tile_segments(MAP_MODE_3D, LOD_MAX_LEVEL, null) != 1) {
+        printf("  Check failed: The coarsest tiles use %lld segments, the deepest sphere tiles %lld.\n", get_tile_segments(MAP_MODE_3D, 0, &app.terrain), get_tile_segments(MAP_MODE_3D, LOD_MAX_LEVEL, null));
+        ++failed_checks;
+    }
+
+    for(s64 level = 4; level <= 16; level += 4) {
+        s64 segments = get_tile_segments(MAP_MODE_3D, level, &app.terrain);
+
+        char name[64];
+        snprintf(name, sizeof(name), "Terrain vertices, level %lld", level);
+        Benchmark benchmark = begin_benchmark(name);
+
+        s64 x = ((s64) 1 << level) / 3, y = ((s64) 1 << level) / 2;
+        Bounding_Box box = get_cell_box(level, x, y);
+
+        for(s64 i = 0; i < VERTEX_ITERATIONS / 4; ++i) {
+            s64 temp_mark = mark_temp_allocator();
+            begin_sample(&benchmark);
+            Vertices vertices = allocate_tile_vertices(&temp, segments);
+            create_tile_vertices(&vertices, &temp, box, level, &app.terrain);
+            end_sample(&benchmark);
+            release_temp_allocator(temp_mark);
+        }
+
+        print_benchmark(&benchmark);
+
+        s64 cracks = 0;
+        for(s64 gap = 1; gap <= min<s64>(TILE_SKIRT_LEVELS, level); ++gap) {
+            for(s64 i = 0; i < 16; ++i) cracks += check_skirts(&app.terrain, level, (((s64) 1 << level) / 16 * i) | (((s64) 1 << gap) - 1), (y + i) % ((s64) 1 << level), gap);
+        }
+
+        printf("  %-32s %8lld segments, %lld edge samples with cracks\n", "", segments, cracks);
+
+        if(cracks) {
+            printf("  Check failed: The skirts on level %lld leave cracks.\n", level);
+            ++failed_checks;
+        }
+    }
+
+    destroy_terrain(&app);
+    destroy_app(&app);
+}
+
+static
+u32 get_synthetic_leaf_color(s64 x, s64 y) {
+    return (u32) (x * 50) | ((u32) (y * 50) << 8) | (7u << 16) | (255u << 24);
+}
+
+static
+void benchmark_tile_pyramid() {
+    //
+    // Builds a small pyramid from a synthetic raster in which every leaf tile has its own
+    // color, then checks lookups, misses and that a corrupted header is rejected.
+    //
+    const char *file_path = "bench_pyramid.wvp";
+    const s64 MAX_LEVEL = 2, LEAVES_PER_SIDE = (s64) 1 << MAX_LEVEL;
+
+    Pyramid_Raster raster = { null, TILE_TEXTURE_RESOLUTION * LEAVES_PER_SIDE * 2, TILE_TEXTURE_RESOLUTION * LEAVES_PER_SIDE };
+    raster.pixels = (u8 *) malloc(raster.width * raster.height * 3);
+
+    for(s64 row = 0; row < raster.height; ++row) {
+        for(s64 column = 0; column < raster.width; ++column) {
+            // Raster rows go from north to south, tile rows from south to north.
+            u32 color = get_synthetic_leaf_color(column * LEAVES_PER_SIDE / raster.width, LEAVES_PER_SIDE - 1 - row * LEAVES_PER_SIDE / raster.height);
+            u8 *pixel = &raster.pixels[(row * raster.width + column) * 3];
+            pixel[0] = (u8) color;
+            pixel[1] = (u8) (color >> 8);
+            pixel[2] = (u8) (color >> 16);
+        }
+    }
+
+    s64 file_size = 0;
+    b8 built = build_tile_pyramid(file_path, raster, MAX_LEVEL, &file_size);
+    free(raster.pixels);
+
+    Tile_Pyramid pyramid;
+    if(!built || !open_tile_pyramid(&pyramid, file_path)) {
+        printf("  Check failed: Could not build the tile pyramid '%s'.\n", file_path);
+        ++failed_checks;
+        remove(file_path);
+        return;
+    }
+
+    s64 expected_tiles = (((s64) 1 << (2 * MAX_LEVEL + 2)) - 1) / 3;
+    s64 found = 0, wrong_pixels = 0, unexpected_hits = 0;
+
+    for(s64 level = 0; level <= MAX_LEVEL; ++level) {
+        for(s64 y = 0; y < ((s64) 1 << level); ++y) {
+            for(s64 x = 0; x < ((s64) 1 << level); ++x) {
+                u32 *pixels = find_tile_pyramid_pixels(&pyramid, level, x, y);
+                if(!pixels) continue;
+
+                ++found;
+
+                // Every tile is uniform on the leaves, coarser tiles average them, so their corners keep the leaf colors.
+                s64 scale = LEAVES_PER_SIDE >> level;
+                u32 south_west = get_synthetic_leaf_color(x * scale, y * scale);
+                u32 north_east = get_synthetic_leaf_color(x * scale + scale - 1, y * scale + scale - 1);
+                if(pixels[0] != south_west || pixels[PAINT_TILE_PIXELS - 1] != north_east) ++wrong_pixels;
+            }
+        }
+    }
+
+    // Past the last level and outside of the grid.
+    if(find_tile_pyramid_pixels(&pyramid, MAX_LEVEL + 1, 0, 0)) ++unexpected_hits;
+    if(find_tile_pyramid_pixels(&pyramid, MAX_LEVEL, LEAVES_PER_SIDE, 0)) ++unexpected_hits;
+    if(find_tile_pyramid_pixels(&pyramid, 1, 0, LEAVES_PER_SIDE)) ++unexpected_hits;
+
+    close_tile_pyramid(&pyramid);
+
+    printf("  %-32s %8lld tiles, %lld found, %fmb\n", "Tile pyramid", expected_tiles, found, convert_to_memory_unit(file_size, Megabytes));
+
+    if(found != expected_tiles || wrong_pixels || unexpected_hits) {
+        printf("  Check failed: %lld of %lld tiles found, %lld with the wrong pixels, %lld lookups found tiles that don't exist.\n", found, expected_tiles, wrong_pixels, unexpected_hits);
+        ++failed_checks;
+    }
+
+    //
+    // Corrupts the header in place, the pyramid must then refuse to open.
+    //
+    const char *corruptions[] = { "magic", "tile count", "index offset" };
+
+    for(s64 i = 0; i < ARRAY_COUNT(corruptions); ++i) {
+        FILE *file = fopen(file_path, "r+b");
+        Tile_Pyramid_Header header;
+        if(!file || fread(&header, sizeof(header), 1, file) != 1) {
+            printf("  Check failed: Could not read back '%s'.\n", file_path);
+            ++failed_checks;
+            if(file) fclose(file);
+            break;
+        }
+
+        Tile_Pyramid_Header corrupted = header;
+        if(i == 0) corrupted.magic        = ~header.magic;
+        if(i == 1) corrupted.tile_count   = file_size; // More entries than fit into the file
+        if(i == 2) corrupted.index_offset = file_size + 64;
+
+        fseek(file, 0, SEEK_SET);
+        fwrite(&corrupted, sizeof(corrupted), 1, file);
+        fclose(file);
+
+        b8 opened = open_tile_pyramid(&pyramid, file_path);
+        if(opened) {
+            printf("  Check failed: The tile pyramid opened with a corrupted %s.\n", corruptions[i]);
+            ++failed_checks;
+            close_tile_pyramid(&pyramid);
+        }
+
+        file = fopen(file_path, "r+b");
+        if(file) {
+            fwrite(&header, sizeof(header), 1, file);
+            fclose(file);
+        }
+    }
+
+    remove(file_path);
+}
+
+static
+void benchmark_residency(s64 gpu_budget, const char *name) {
+    Benchmark benchmark = begin_benchmark(name);
+
+    App app = {};
+    create_app(&app);
+    create_residency(&app, RESIDENCY_DEFAULT_CPU_BUDGET, gpu_budget);
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    Frame_Input input = {};
+    input.frame_time      = 1.0 / FRAME_RATE;
+    input.viewport_width  = 1920;
+    input.viewport_height = 1080;
+
+    s64 max_gpu_bytes = 0, frames_over_budget = 0;
+
+    for(s64 i = 0; i < PAN_FRAMES; ++i) {
+        // Zoom in, then pan around the globe and back, like a kiosk cycling through places.
+        input.mouse_wheel_turns = (i < 100) ? 0.1f : 0.0f;
+        input.dragging          = i >= 100;
+        input.mouse_delta_x     = (i / 500) % 2 ? -40 : 40;
+
+        begin_sample(&benchmark);
+        simulate_one_frame(&app, &input);
+        draw_one_frame(&app);
+        end_sample(&benchmark);
+
+        max_gpu_bytes = max(max_gpu_bytes, app.residency.gpu_bytes);
+        if(app.residency.gpu_bytes > gpu_budget) ++frames_over_budget;
+    }
+
+    Residency_Stats stats = app.residency.stats;
+
+    if(frames_over_budget) {
+        printf("  Check failed: The residency exceeded its budget in %lld frames.\n", frames_over_budget);
+        ++failed_checks;
+    }
+
+    destroy_tile(&app, &app.root, true);
+    trim_tile_pool(&app);
+
+    if(get_tile_texture_page_bytes()) {
+        printf("  Check failed: %fmb of texture pages outlived their textures.\n", convert_to_memory_unit(get_tile_texture_page_bytes(), Megabytes));
+        ++failed_checks;
+    }
+
+    destroy_app(&app);
+
+    print_benchmark(&benchmark);
+    printf("  %-32s %8lld hits, %lld misses, %lld evictions, %fmb of %fmb at most\n", "", stats.hits, stats.misses, stats.evictions,
+           convert_to_memory_unit(max_gpu_bytes, Megabytes), convert_to_memory_unit(gpu_budget, Megabytes));
+}
+
+static
+void fly_prefetch_path(Map_Mode map_mode, b8 prefetch, Benchmark *benchmark, s64 *prefetch_splits, s64 *pop_ins, s64 *hits) {
+    App app = {};
+    create_app(&app);
+    app.map_mode = map_mode;
+    app.prefetcher.disabled = !prefetch;
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    Frame_Input input = {};
+    input.frame_time      = 1.0 / FRAME_RATE;
+    input.viewport_width  = 1920;
+    input.viewport_height = 1080;
+
+    // Let the camera settle first, dragging before that doesn't have a distance to work with.
+    for(s64 i = 0; i < GESTURE_FRAMES; ++i) {
+        simulate_one_frame(&app, &input);
+        wait_for_tile_jobs(&app);
+        draw_one_frame(&app);
+    }
+
+    //
+    // Alternate between zooming in and dragging for a few frames, then let go. The LOD
+    // only splits leaves which are already in view, so every one of its splits is a tile
+    // popping in. The prefetcher should have split most of them before.
+    //
+    *prefetch_splits = 0;
+    *pop_ins = 0;
+    *hits = app.residency.stats.hits;
+
+    for(s64 gesture = 0; gesture < 8; ++gesture) {
+        for(s64 i = 0; i < GESTURE_FRAMES; ++i) {
+            b8 active = i < GESTURE_FRAMES / 4;
+            input.mouse_wheel_turns = (active && gesture % 2 == 0) ? 0.1f : 0.0f;
+            input.dragging          = active && gesture % 2 == 1;
+            input.mouse_delta_x     = 20;
+            input.mouse_delta_y     = 5;
+
+            if(benchmark) begin_sample(benchmark);
+            simulate_one_frame(&app, &input);
+            draw_one_frame(&app);
+            if(benchmark) end_sample(benchmark);
+
+            *prefetch_splits += app.prefetcher.stats.splits;
+            *pop_ins         += app.lod_stats.splits;
+        }
+    }
+
+    *hits = app.residency.stats.hits - *hits;
+
+    destroy_tile(&app, &app.root, true);
+    destroy_app(&app);
+}
+
+static
+void benchmark_prefetch(Map_Mode map_mode, const char *name) {
+    Benchmark benchmark = begin_benchmark(name);
+
+    s64 prefetch_splits, pop_ins, hits;
+    fly_prefetch_path(map_mode, true, &benchmark, &prefetch_splits, &pop_ins, &hits);
+
+    // The same flight without the prefetcher, for the pop-ins it saved.
+    s64 unused_splits, unprefetched_pop_ins, unprefetched_hits;
+    fly_prefetch_path(map_mode, false, null, &unused_splits, &unprefetched_pop_ins, &unprefetched_hits);
+
+    print_benchmark(&benchmark);
+    printf("  %-32s %8lld prefetch splits, %lld pop-ins (%lld without prefetching), %lld hits\n", "", prefetch_splits, pop_ins, unprefetched_pop_ins, hits);
+
+    if(pop_ins >= unprefetched_pop_ins) {
+        printf("  Check failed: Prefetching left %lld tiles popping in, %lld without it.\n", pop_ins, unprefetched_pop_ins);
+        ++failed_checks;
+    }
+}
+
+static
+void benchmark_logger() {
+    //
+    // The cost of log() on the calling thread, with the logger thread writing to the
+    // binary log file only. Messages the logger thread can't keep up with are dropped.
+    //
+    Benchmark benchmark = begin_benchmark("Log message");
+
+    Log_Level previous_level = minimum_log_level;
+    minimum_log_level = LOG_Debug;
+    create_logger("WorldView_Bench.wvlg", false);
+
+    for(s64 i = 0; i < TREE_ITERATIONS; ++i) {
+        begin_sample(&benchmark);
+        for(s64 j = 0; j < LOG_MESSAGES / TREE_ITERATIONS; ++j) {
+            log(LOG_Debug, "Created tile %lld of '%s' in %fms.", j, "the benchmark", 0.25);
+        }
+        end_sample(&benchmark);
+    }
+
+    destroy_logger();
+    minimum_log_level = previous_level;
+
+    Log_Stats stats = get_log_stats();
+    if(stats.messages + stats.dropped != LOG_MESSAGES) {
+        printf("  Check failed: %lld of %lld log messages were neither written nor dropped.\n", LOG_MESSAGES - stats.messages - stats.dropped, (s64) LOG_MESSAGES);
+        ++failed_checks;
+    }
+
+    print_benchmark(&benchmark);
+    printf("  %-32s %8fns per message, %lld written, %lld dropped\n", "", benchmark.total / (f64) LOG_MESSAGES * 1000000.0, stats.messages, stats.dropped);
+}
+
+#if PROFILER_ENABLED
+static
+void benchmark_profiler() {
+    //
+    // The cost of a single zone, which every instrumented function pays in developer
+    // builds, and of exporting the full ring after a spike.
+    //
+    Benchmark benchmark = begin_benchmark("Profile zone");
+
+    for(s64 i = 0; i < TREE_ITERATIONS; ++i) {
+        begin_sample(&benchmark);
+        for(s64 j = 0; j < PROFILE_ZONES / TREE_ITERATIONS; ++j) {
+            PROFILE_ZONE("Benchmark");
+            PROFILE_COUNT(PROFILE_COUNTER_Draw_Calls, 1);
+        }
+        end_sample(&benchmark);
+    }
+
+    PROFILE_FRAME();
+    print_benchmark(&benchmark);
+    printf("  %-32s %8fns per zone\n", "", benchmark.total / (f64) PROFILE_ZONES * 1000000.0);
+
+    Benchmark export_benchmark = begin_benchmark("Chrome trace export");
+    begin_sample(&export_benchmark);
+    b8 written = write_chrome_trace("WorldView_Bench.json");
+    end_sample(&export_benchmark);
+
+    if(!written) {
+        printf("  Check failed: The trace could not be written.\n");
+        ++failed_checks;
+    }
+
+    print_benchmark(&export_benchmark);
+}
+#endif
+
+static
+int compare_frame_times(const void *lhs, const void *rhs) {
+    f64 a = *(f64 *) lhs, b = *(f64 *) rhs;
+    return (a > b) - (a < b);
+}
+
+static inline
+f64 get_percentile(f64 *sorted, s64 count, f64 percentile) {
+    s64 index = (s64) ceil(percentile * (f64) count) - 1;
+    return sorted[clamp(index, (s64) 0, count - 1)];
+}
+
+static
+void benchmark_input_recording() {
+    //
+    // Records a synthetic session, with idle stretches, drags, zooming, a mode switch and
+    // jittering frame times, and checks that replaying it gives back every input. Frame
+    // times only have to match to within INPUT_FRAME_TIME_UNIT.
+    //
+    const char *file_path = "bench_input.wvir";
+
+    App app = {};
+    create_app(&app);
+
+    Frame_Input *inputs = (Frame_Input *) malloc(RECORDING_FRAMES * sizeof(Frame_Input));
+    u64 seed = 0x2545f4914f6cdd1d;
+
+    Input_Recorder recorder;
+    if(!begin_input_recording(&recorder, &app, file_path)) {
+        printf("  Check failed: Could not record to '%s'.\n", file_path);
+        ++failed_checks;
+        free(inputs);
+        destroy_app(&app);
+        return;
+    }
+
+    for(s64 i = 0; i < RECORDING_FRAMES; ++i) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        s64 phase = (i / 100) % 4; // Idle, dragging, zooming, idle with a stuttering frame rate
+
+        Frame_Input input = {};
+        input.frame_time        = 1.0 / FRAME_RATE + ((phase == 3) ? (f64) ((seed >> 40) & 0xff) * 1e-4 : 0);
+        input.viewport_width    = 1280;
+        input.viewport_height   = 720;
+        input.mouse_x           = 640 + ((phase == 1) ? (s32) (i % 100) * 3 : 0);
+        input.mouse_y           = 360;
+        input.dragging          = phase == 1;
+        input.mouse_delta_x     = (phase == 1) ? 3 : 0;
+        input.mouse_wheel_turns = (phase == 2 && i % 10 == 0) ? ((seed >> 63) ? 1.0f : -0.5f) : 0;
+        input.toggle_map_mode   = i == RECORDING_FRAMES / 2;
+
+        inputs[i] = input;
+        record_input_frame(&recorder, &input);
+    }
+
+    end_input_recording(&recorder);
+
+    Input_Replay replay;
+    b8 loaded = load_input_replay(&replay, &app.allocator, file_path);
+    remove(file_path);
+
+    if(!loaded) {
+        printf("  Check failed: Could not load the recording back.\n");
+        ++failed_checks;
+        free(inputs);
+        destroy_app(&app);
+        return;
+    }
+
+    s64 frames = 0, mismatches = 0;
+    f64 max_frame_time_error = 0;
+    Frame_Input replayed;
+
+    while(frames < RECORDING_FRAMES && next_input_replay_frame(&replay, &replayed)) {
+        Frame_Input *recorded = &inputs[frames];
+        max_frame_time_error = max(max_frame_time_error, fabs(replayed.frame_time - recorded->frame_time));
+
+        if(replayed.viewport_width != recorded->viewport_width || replayed.viewport_height != recorded->viewport_height ||
+           replayed.mouse_x != recorded->mouse_x || replayed.mouse_y != recorded->mouse_y ||
+           replayed.mouse_delta_x != recorded->mouse_delta_x || replayed.mouse_delta_y != recorded->mouse_delta_y ||
+           replayed.mouse_wheel_turns != recorded->mouse_wheel_turns || replayed.dragging != recorded->dragging || replayed.toggle_map_mode != recorded->toggle_map_mode) {
+            ++mismatches;
+        }
+
+        ++frames;
+    }
+
+    b8 exhausted = !next_input_replay_frame(&replay, &replayed);
+
+    printf("  %-32s %8lld frames in %lld runs, frame times off by at most %fms\n", "Input recording", replay.header.frame_count, replay.header.run_count, max_frame_time_error * 1000.0);
+
+    if(frames != RECORDING_FRAMES || !exhausted || replay.header.frame_count != RECORDING_FRAMES || mismatches || max_frame_time_error > INPUT_FRAME_TIME_UNIT) {
+        printf("  Check failed: %lld of %lld frames replayed, %lld with different inputs, frame times off by %fms.\n", frames, (s64) RECORDING_FRAMES, mismatches, max_frame_time_error * 1000.0);
+        ++failed_checks;
+    }
+
+    destroy_input_replay(&replay, &app.allocator);
+    free(inputs);
+    destroy_app(&app);
+}
+
+static
+int replay_input_recording(const char *file_path) {
+    //
+    // Replays the recording with its recorded frame times and without sleeping between
+    // frames, on the same data the app loads when this runs in its working directory.
+    //
+    App app = {};
+    create_app(&app);
+
+    Input_Replay replay;
+    if(!load_input_replay(&replay, &app.allocator, file_path)) {
+        printf("'%s' is not an input recording.\n", file_path);
+        destroy_app(&app);
+        return 1;
+    }
+
+    apply_input_replay_camera(&replay, &app);
+    open_tile_pyramid(&app.imagery, "data/world.wvp");
+    load_overlay(&app, "data/overlay.txt");
+    load_points(&app, "data/points.wvpt");
+    load_terrain(&app, "data/elevation.wvdm");
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    f64 *frame_times = (f64 *) app.allocator.allocate(max<s64>(replay.header.frame_count, 1) * sizeof(f64));
+    s64 frame_count = 0, splits = 0, merges = 0, peak_working_set = 0, peak_temp = 0;
+    f64 simulated_seconds = 0;
+    s64 misses = app.residency.stats.misses, evictions = app.residency.stats.evictions;
+
+    Frame_Input input;
+    while(frame_count < replay.header.frame_count && next_input_replay_frame(&replay, &input)) {
+        s64 temp_mark = mark_temp_allocator();
+        Hardware_Time start = os_get_hardware_time();
+
+        simulate_one_frame(&app, &input);
+        draw_one_frame(&app);
+
+        frame_times[frame_count++] = os_convert_hardware_time(os_get_hardware_time() - start, Milliseconds);
+        simulated_seconds += input.frame_time;
+
+        splits          += app.lod_stats.splits;
+        merges          += app.lod_stats.merges;
+        peak_working_set = max(peak_working_set, app.allocator.stats.working_set);
+        peak_temp        = max(peak_temp, mark_temp_allocator());
+        release_temp_allocator(temp_mark);
+    }
+
+    misses    = app.residency.stats.misses - misses;
+    evictions = app.residency.stats.evictions - evictions;
+
+    qsort(frame_times, frame_count, sizeof(f64), compare_frame_times);
+
+    printf("Replay of '%s' (%lld frames, %fs of the session):\n", file_path, frame_count, simulated_seconds);
+    if(frame_count) printf("  %-32s p50: %10.4fms, p99: %10.4fms, max: %10.4fms\n", "Frame time", get_percentile(frame_times, frame_count, 0.5), get_percentile(frame_times, frame_count, 0.99), frame_times[frame_count - 1]);
+    printf("  %-32s %lld splits, %lld merges, %lld residency misses, %lld evictions\n", "Tile churn", splits, merges, misses, evictions);
+    printf("  %-32s allocator: %fmb, temp: %fmb, os: %fmb\n", "High water", convert_to_memory_unit(peak_working_set, Megabytes), convert_to_memory_unit(peak_temp, Megabytes), convert_to_memory_unit(os_get_working_set_size(), Megabytes));
+
+    app.allocator.deallocate(frame_times);
+    destroy_input_replay(&replay, &app.allocator);
+
+    destroy_tile(&app, &app.root, true);
+    wait_for_tile_jobs(&app); // They may still read the terrain
+    close_tile_pyramid(&app.imagery);
+    destroy_overlay(&app);
+    destroy_point_layer(&app);
+    destroy_terrain(&app);
+    destroy_app(&app);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    s64 depth = argc > 1 ? atoi(argv[1]) : DEFAULT_SUBDIVISION_DEPTH;
+
+    os_enable_high_resolution_clock();
+    create_temp_allocator(4 * ONE_MEGABYTE);
+    create_job_system(0);
+    minimum_log_level = LOG_Warning; // Don't measure the per-tile console output.
+
+    if(argc > 2 && strcmp(argv[1], "--replay") == 0) {
+        int result = replay_input_recording(argv[2]);
+        destroy_job_system();
+        destroy_temp_allocator();
+        return result;
+    }
+
+    printf("World View benchmarks (subdivision depth %lld, %lld workers, %s tiles):\n", depth, get_job_worker_count(), DRAW_TILES_INSTANCED ? "instanced" : "meshed");
+
+    benchmark_vertex_generation();
+    benchmark_subdivision(MAP_MODE_2D, "Subdivision to depth (2D)", depth);
+    benchmark_subdivision(MAP_MODE_3D, "Subdivision to depth (3D)", depth);
+    benchmark_mode_switch();
+    benchmark_repaint("Frame on a static scene", depth, false);
+    benchmark_repaint("Frame with an invalidated region", depth, true);
+    benchmark_paint(depth + 2);
+    benchmark_texture_exhaustion();
+    benchmark_overlay();
+    benchmark_points(MAP_MODE_3D, "Frame with 10M points");
+    benchmark_terrain();
+    benchmark_tile_pyramid();
+    benchmark_camera_update(MAP_MODE_2D, "Camera update (2D)");
+    benchmark_camera_update(MAP_MODE_3D, "Camera update (3D)");
+    benchmark_culling(MAP_MODE_2D, "Culling (2D)");
+    benchmark_culling(MAP_MODE_3D, "Culling (3D)");
+    benchmark_lod_zoom(MAP_MODE_2D, "Frame with LOD zoom (2D)");
+    benchmark_lod_zoom(MAP_MODE_3D, "Frame with LOD zoom (3D)");
+    benchmark_scheduler(MAP_MODE_2D, "Frame until idle (2D)");
+    benchmark_scheduler(MAP_MODE_3D, "Frame until idle (3D)");
+    benchmark_picking(MAP_MODE_2D, "Picking (2D)");
+    benchmark_picking(MAP_MODE_3D, "Picking (3D)");
+    benchmark_tile_lookup(MAP_MODE_2D, "2D");
+    benchmark_tile_lookup(MAP_MODE_3D, "3D");
+    benchmark_prefetch(MAP_MODE_2D, "Frame with prefetch (2D)");
+    benchmark_prefetch(MAP_MODE_3D, "Frame with prefetch (3D)");
+    benchmark_residency(RESIDENCY_DEFAULT_GPU_BUDGET, "Frame with LOD pan");
+    benchmark_residency(RESIDENCY_DEFAULT_GPU_BUDGET / 4, "Frame with LOD pan (tight budget)");
+    benchmark_input_recording();
+    benchmark_logger();
+#if PROFILER_ENABLED
+    benchmark_profiler();
+#endif
+
+    destroy_job_system();
+    destroy_temp_allocator();
+    return failed_checks ? 1 : 0;
+}
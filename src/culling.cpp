@@ -0,0 +1,89 @@
+// --- Foundation
+#include <foundation.h>
+#include <math/v3.h>
+#include <math/v4.h>
+#include <math/m4.h>
+
+// --- App
+#include "app.h"
+#include "tile.h"
+#include "culling.h"
+
+static
+v4f normalize_plane(v4f plane) {
+    f32 length = v3_length(v3f(plane.x, plane.y, plane.z));
+    return v4f(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+}
+
+Frustum make_frustum(m4f const &projection_view) {
+    //
+    // Extract the planes from the rows of the projection view matrix (Gribb & Hartmann).
+    // We only have matrix-vector products at hand, so get the rows by multiplying the
+    // matrix with the basis vectors, which yields the columns.
+    //
+    v4f columns[4] = {
+        projection_view * v4f(1, 0, 0, 0),
+        projection_view * v4f(0, 1, 0, 0),
+        projection_view * v4f(0, 0, 1, 0),
+        projection_view * v4f(0, 0, 0, 1),
+    };
+
+    v4f rows[4];
+    for(s64 i = 0; i < 4; ++i) {
+        rows[i] = v4f(columns[0].values[i], columns[1].values[i], columns[2].values[i], columns[3].values[i]);
+    }
+
+    Frustum frustum;
+    for(s64 i = 0; i < 3; ++i) {
+        // The near plane is taken from the [-w, w] depth range, which is a superset of the
+        // [0, w] range used by D3D, so that this stays conservative for either convention.
+        frustum.planes[i * 2 + 0] = normalize_plane(v4f(rows[3].x + rows[i].x, rows[3].y + rows[i].y, rows[3].z + rows[i].z, rows[3].w + rows[i].w));
+        frustum.planes[i * 2 + 1] = normalize_plane(v4f(rows[3].x - rows[i].x, rows[3].y - rows[i].y, rows[3].z - rows[i].z, rows[3].w - rows[i].w));
+    }
+
+    return frustum;
+}
+
+static
+b8 tile_is_behind_horizon(Camera *camera, Tile *tile) {
+    //
+    // A point on the globe with normal n is visible from the camera position P if
+    // dot(n, P) > R. The normals of the tile are bounded by its cone, so the tile is
+    // hidden if even the normal closest to P points below the horizon.
+    //
+    f32 camera_distance = v3_length(camera->position);
+    if(camera_distance <= WORLD_SCALE_3D) return false;
+
+    f32 horizon_angle = acosf(WORLD_SCALE_3D / camera_distance);
+    f32 axis_angle    = acosf(clamp(v3_dot(tile->bounds[MAP_MODE_3D].cone_axis, camera->position) / camera_distance, -1.0f, 1.0f));
+
+    return axis_angle - tile->bounds[MAP_MODE_3D].cone_angle > horizon_angle;
+}
+
+Cull_Result cull_tile(Camera *camera, Map_Mode map_mode, Tile *tile, Cull_Result parent_result) {
+    if(parent_result == CULL_Outside) return CULL_Outside;
+
+    if(map_mode == MAP_MODE_3D && tile_is_behind_horizon(camera, tile)) return CULL_Outside;
+
+    if(parent_result == CULL_Inside) return CULL_Inside;
+
+    Tile_Bounds *bounds = &tile->bounds[map_mode];
+    Cull_Result result  = CULL_Inside;
+
+    for(s64 i = 0; i < ARRAY_COUNT(camera->frustum.planes); ++i) {
+        v4f plane = camera->frustum.planes[i];
+        f32 distance = v3_dot(v3f(plane.x, plane.y, plane.z), bounds->center) + plane.w;
+
+        if(distance < -bounds->radius) return CULL_Outside;
+        if(distance <  bounds->radius) result = CULL_Intersecting;
+    }
+
+    return result;
+}
+
+Cull_Result cull_drawn_tile(App *app, Tile *tile, Cull_Result parent_result) {
+    // While switching the map mode, the tiles lie neither on the map nor on the globe.
+    if(app->morph.remaining > 0) return CULL_Inside;
+
+    return cull_tile(&app->camera, app->map_mode, tile, parent_result);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <foundation.h>
+#include <math/v4.h>
+#include <math/m4.h>
+
+struct App;
+struct Camera;
+struct Tile;
+enum Map_Mode : s32;
+
+struct Frustum {
+    v4f planes[6]; // Normalized, pointing inwards: dot(plane.xyz, p) + plane.w >= 0 for every p inside
+};
+
+enum Cull_Result {
+    CULL_Outside,
+    CULL_Intersecting,
+    CULL_Inside, // Completely inside the frustum, so no child needs to be tested again
+};
+
+struct Cull_Stats {
+    s64 tiles_drawn;
+    s64 tiles_culled; // Culled subtrees, not individual leaves
+};
+
+Frustum make_frustum(m4f const &projection_view);
+Cull_Result cull_tile(Camera *camera, Map_Mode map_mode, Tile *tile, Cull_Result parent_result);
+Cull_Result cull_drawn_tile(App *app, Tile *tile, Cull_Result parent_result); // With the camera the tiles are drawn with
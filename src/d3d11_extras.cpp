@@ -0,0 +1,278 @@
+// --- C
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Windows
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <d3d11.h>
+#include <d3dcompiler.h>
+
+// --- Foundation
+#include <foundation.h>
+
+// --- App
+#include "d3d11_extras.h"
+
+struct D3D11_Extras {
+    ID3D11Device *device;
+    ID3D11DeviceContext *context;
+};
+
+D3D11_Extras extras;
+
+static
+b8 check_result(HRESULT result, const char *call) {
+    if(SUCCEEDED(result)) return true;
+    foundation_error("[D3D11]: %s failed (0x%08x).", call, (u32) result);
+    return false;
+}
+
+void setup_d3d11_extras(ID3D11Device *device, ID3D11DeviceContext *context) {
+    assert(device && context);
+
+    // Held until destroy_d3d11_extras, so the extras never outlive the device.
+    extras.device  = device;
+    extras.context = context;
+    extras.device->AddRef();
+    extras.context->AddRef();
+}
+
+void destroy_d3d11_extras() {
+    if(extras.context) extras.context->Release();
+    if(extras.device) extras.device->Release();
+    extras = D3D11_Extras{};
+}
+
+static
+ID3DBlob *compile_shader(const char *file_path, const char *source, s64 size, const char *entry_point, const char *target) {
+    ID3DBlob *bytecode = null, *errors = null;
+    HRESULT result = D3DCompile(source, (SIZE_T) size, file_path, null, null, entry_point, target, D3DCOMPILE_ENABLE_STRICTNESS, 0, &bytecode, &errors);
+
+    if(FAILED(result)) {
+        if(errors) {
+            foundation_error("[D3D11]: Failed to compile '%s' of '%s':\n%s", entry_point, file_path, (const char *) errors->GetBufferPointer());
+        } else {
+            foundation_error("[D3D11]: Failed to compile '%s' of '%s' (0x%08x).", entry_point, file_path, (u32) result);
+        }
+    }
+
+    if(errors) errors->Release(); // Only warnings if the compilation succeeded
+
+    if(FAILED(result)) {
+        if(bytecode) bytecode->Release();
+        return null;
+    }
+
+    return bytecode;
+}
+
+b8 create_shader_from_file(G_Shader *shader, const char *file_path, G_Vertex_Input *inputs, s64 input_count) {
+    *shader = G_Shader{};
+
+    FILE *file = fopen(file_path, "rb");
+    if(!file) {
+        foundation_error("[D3D11]: Failed to open the shader '%s'.", file_path);
+        return false;
+    }
+
+    s64 size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    if(size <= 0 || fseek(file, 0, SEEK_SET) != 0) {
+        foundation_error("[D3D11]: Failed to get the size of the shader '%s', or it is empty.", file_path);
+        fclose(file);
+        return false;
+    }
+
+    char *source = (char *) malloc(size);
+    if(!source) {
+        foundation_error("[D3D11]: Failed to allocate %lld bytes for the shader '%s'.", size, file_path);
+        fclose(file);
+        return false;
+    }
+
+    s64 read = (s64) fread(source, 1, size, file);
+    fclose(file);
+
+    if(read != size) {
+        foundation_error("[D3D11]: Failed to read the shader '%s' (%lld of %lld bytes).", file_path, read, size);
+        free(source);
+        return false;
+    }
+
+    ID3DBlob *vertex = compile_shader(file_path, source, size, "vs_main", "vs_5_0");
+    ID3DBlob *pixel  = compile_shader(file_path, source, size, "ps_main", "ps_5_0");
+    free(source);
+
+    b8 success = vertex && pixel;
+
+    if(success) {
+        D3D11_INPUT_ELEMENT_DESC elements[8] = {};
+        assert(input_count <= (s64) ARRAY_COUNT(elements));
+
+        UINT offset = 0;
+        for(s64 i = 0; i < input_count; ++i) {
+            elements[i].SemanticName      = inputs[i].name;
+            elements[i].Format            = inputs[i].format == VERTEX_FORMAT_Float2 ? DXGI_FORMAT_R32G32_FLOAT : DXGI_FORMAT_R16G16B16A16_UNORM;
+            elements[i].AlignedByteOffset = offset;
+            elements[i].InputSlotClass    = D3D11_INPUT_PER_VERTEX_DATA;
+            offset += 8; // Both formats take eight bytes
+        }
+
+        success = check_result(extras.device->CreateVertexShader(vertex->GetBufferPointer(), vertex->GetBufferSize(), null, &shader->vertex), "CreateVertexShader") &&
+            check_result(extras.device->CreatePixelShader(pixel->GetBufferPointer(), pixel->GetBufferSize(), null, &shader->pixel), "CreatePixelShader") &&
+            check_result(extras.device->CreateInputLayout(elements, (UINT) input_count, vertex->GetBufferPointer(), vertex->GetBufferSize(), &shader->layout), "CreateInputLayout");
+    }
+
+    if(vertex) vertex->Release();
+    if(pixel) pixel->Release();
+    if(!success) destroy_shader(shader);
+    return success;
+}
+
+void destroy_shader(G_Shader *shader) {
+    if(shader->layout) shader->layout->Release();
+    if(shader->pixel) shader->pixel->Release();
+    if(shader->vertex) shader->vertex->Release();
+    *shader = G_Shader{};
+}
+
+void bind_shader(G_Shader *shader) {
+    extras.context->IASetInputLayout(shader->layout);
+    extras.context->VSSetShader(shader->vertex, null, 0);
+    extras.context->PSSetShader(shader->pixel, null, 0);
+}
+
+void create_vertex_buffer(G_Vertex_Buffer *buffer, void *vertices, s64 stride, s64 count) {
+    D3D11_BUFFER_DESC description = {};
+    description.ByteWidth      = (UINT) (count * stride);
+    description.Usage          = D3D11_USAGE_DYNAMIC;
+    description.BindFlags      = D3D11_BIND_VERTEX_BUFFER;
+    description.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    D3D11_SUBRESOURCE_DATA subresource = {};
+    subresource.pSysMem = vertices;
+
+    buffer->handle = null;
+    buffer->stride = stride;
+    buffer->count  = count;
+    check_result(extras.device->CreateBuffer(&description, &subresource, &buffer->handle), "CreateBuffer");
+}
+
+void update_vertex_buffer(G_Vertex_Buffer *buffer, void *vertices, s64 count) {
+    assert(count <= buffer->count);
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if(!check_result(extras.context->Map(buffer->handle, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped), "Map")) return;
+    memcpy(mapped.pData, vertices, count * buffer->stride);
+    extras.context->Unmap(buffer->handle, 0);
+}
+
+void destroy_vertex_buffer(G_Vertex_Buffer *buffer) {
+    if(buffer->handle) buffer->handle->Release();
+    *buffer = G_Vertex_Buffer{};
+}
+
+void bind_vertex_buffer(G_Vertex_Buffer *buffer) {
+    UINT stride = (UINT) buffer->stride, offset = 0;
+    extras.context->IASetVertexBuffers(0, 1, &buffer->handle, &stride, &offset);
+}
+
+void draw_vertices(G_Vertex_Buffer *buffer) {
+    extras.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    extras.context->Draw((UINT) buffer->count, 0);
+}
+
+void create_index_buffer(G_Index_Buffer *buffer, u16 *indices, s64 count) {
+    D3D11_BUFFER_DESC description = {};
+    description.ByteWidth = (UINT) (count * sizeof(u16));
+    description.Usage     = D3D11_USAGE_IMMUTABLE;
+    description.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+    D3D11_SUBRESOURCE_DATA subresource = {};
+    subresource.pSysMem = indices;
+
+    buffer->handle = null;
+    buffer->count  = count;
+    check_result(extras.device->CreateBuffer(&description, &subresource, &buffer->handle), "CreateBuffer");
+}
+
+void destroy_index_buffer(G_Index_Buffer *buffer) {
+    if(buffer->handle) buffer->handle->Release();
+    *buffer = G_Index_Buffer{};
+}
+
+void bind_index_buffer(G_Index_Buffer *buffer) {
+    extras.context->IASetIndexBuffer(buffer->handle, DXGI_FORMAT_R16_UINT, 0);
+}
+
+void draw_indexed(G_Index_Buffer *buffer) {
+    extras.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    extras.context->DrawIndexed((UINT) buffer->count, 0, 0);
+}
+
+void draw_indexed_instanced(G_Index_Buffer *buffer, s64 instances) {
+    extras.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    extras.context->DrawIndexedInstanced((UINT) buffer->count, (UINT) instances, 0, 0, 0);
+}
+
+void create_texture_array(G_Texture_Array *array, s64 width, s64 height, s64 layers) {
+    *array = G_Texture_Array{};
+    array->width  = width;
+    array->height = height;
+    array->layers = layers;
+
+    D3D11_TEXTURE2D_DESC texture_description = {};
+    texture_description.Width            = (UINT) width;
+    texture_description.Height           = (UINT) height;
+    texture_description.MipLevels        = 1;
+    texture_description.ArraySize        = (UINT) layers;
+    texture_description.Format           = DXGI_FORMAT_R8G8B8A8_UNORM;
+    texture_description.SampleDesc.Count = 1;
+    texture_description.Usage            = D3D11_USAGE_DEFAULT;
+    texture_description.BindFlags        = D3D11_BIND_SHADER_RESOURCE;
+    if(!check_result(extras.device->CreateTexture2D(&texture_description, null, &array->handle), "CreateTexture2D")) return;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC view_description = {};
+    view_description.Format                   = texture_description.Format;
+    view_description.ViewDimension            = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+    view_description.Texture2DArray.MipLevels = 1;
+    view_description.Texture2DArray.ArraySize = (UINT) layers;
+    check_result(extras.device->CreateShaderResourceView(array->handle, &view_description, &array->view), "CreateShaderResourceView");
+
+    // Nearest and clamped to the edges, like the tile textures have always been sampled.
+    D3D11_SAMPLER_DESC sampler_description = {};
+    sampler_description.Filter         = D3D11_FILTER_MIN_MAG_MIP_POINT;
+    sampler_description.AddressU       = D3D11_TEXTURE_ADDRESS_CLAMP;
+    sampler_description.AddressV       = D3D11_TEXTURE_ADDRESS_CLAMP;
+    sampler_description.AddressW       = D3D11_TEXTURE_ADDRESS_CLAMP;
+    sampler_description.ComparisonFunc = D3D11_COMPARISON_NEVER;
+    sampler_description.MaxLOD         = D3D11_FLOAT32_MAX;
+    check_result(extras.device->CreateSamplerState(&sampler_description, &array->sampler), "CreateSamplerState");
+}
+
+void destroy_texture_array(G_Texture_Array *array) {
+    if(array->sampler) array->sampler->Release();
+    if(array->view) array->view->Release();
+    if(array->handle) array->handle->Release();
+    *array = G_Texture_Array{};
+}
+
+void bind_texture_array(G_Texture_Array *array, s64 slot) {
+    extras.context->PSSetShaderResources((UINT) slot, 1, &array->view);
+    extras.context->PSSetSamplers((UINT) slot, 1, &array->sampler);
+}
+
+void update_texture_array_layers(G_Texture_Array *array, s64 *layers, u8 **pixels, s64 count) {
+    UINT row_pitch = (UINT) (array->width * 4), layer_pitch = (UINT) (array->width * array->height * 4);
+
+    for(s64 i = 0; i < count; ++i) {
+        assert(layers[i] >= 0 && layers[i] < array->layers);
+        extras.context->UpdateSubresource(array->handle, D3D11CalcSubresource(0, (UINT) layers[i], 1), null, pixels[i], row_pitch, layer_pitch);
+    }
+}
+
+void copy_texture_array_layer(G_Texture_Array *destination, s64 destination_layer, G_Texture_Array *source, s64 source_layer) {
+    assert(destination->width == source->width && destination->height == source->height);
+    extras.context->CopySubresourceRegion(destination->handle, D3D11CalcSubresource(0, (UINT) destination_layer, 1), 0, 0, 0, source->handle, D3D11CalcSubresource(0, (UINT) source_layer, 1), null);
+}
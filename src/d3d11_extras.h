@@ -0,0 +1,83 @@
+#pragma once
+
+#include <foundation.h>
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11Buffer;
+struct ID3D11Texture2D;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+
+//
+// The few D3D11 features the tiles need beyond what the D3D11 layer of Foundation has
+// always offered. The Foundation submodule isn't pinned to a revision, so instead of
+// relying on newer Foundation calls, these talk to the device directly. The caller
+// hands in the device and context (see setup_draw_data), nothing here reaches into
+// Foundation.
+// The shaders and vertex buffers here exist because Foundation's only take f32 inputs.
+// Everything else (constant buffers, frame buffers, swapping) still goes through
+// Foundation.
+//
+
+struct G_Index_Buffer {
+    ID3D11Buffer *handle;
+    s64 count;
+};
+
+enum Vertex_Format {
+    VERTEX_FORMAT_Float2,    // Two f32
+    VERTEX_FORMAT_Unorm16x4, // Four u16, read as floats in [0, 1]
+};
+
+struct G_Vertex_Input {
+    const char *name; // The semantic in the shader
+    Vertex_Format format;
+};
+
+struct G_Shader {
+    ID3D11VertexShader *vertex;
+    ID3D11PixelShader *pixel;
+    ID3D11InputLayout *layout;
+};
+
+struct G_Vertex_Buffer {
+    ID3D11Buffer *handle;
+    s64 stride; // In bytes
+    s64 count;
+};
+
+struct G_Texture_Array {
+    ID3D11Texture2D *handle;
+    ID3D11ShaderResourceView *view;
+    ID3D11SamplerState *sampler; // Nearest, clamped to the edges
+    s64 width, height, layers;
+};
+
+void setup_d3d11_extras(ID3D11Device *device, ID3D11DeviceContext *context); // Takes a reference to both
+void destroy_d3d11_extras();
+
+b8 create_shader_from_file(G_Shader *shader, const char *file_path, G_Vertex_Input *inputs, s64 input_count); // Compiles vs_main and ps_main
+void destroy_shader(G_Shader *shader);
+void bind_shader(G_Shader *shader);
+
+void create_vertex_buffer(G_Vertex_Buffer *buffer, void *vertices, s64 stride, s64 count); // Dynamic
+void update_vertex_buffer(G_Vertex_Buffer *buffer, void *vertices, s64 count); // At most the created count
+void destroy_vertex_buffer(G_Vertex_Buffer *buffer);
+void bind_vertex_buffer(G_Vertex_Buffer *buffer);
+void draw_vertices(G_Vertex_Buffer *buffer); // Triangles, without an index buffer
+
+void create_index_buffer(G_Index_Buffer *buffer, u16 *indices, s64 count);
+void destroy_index_buffer(G_Index_Buffer *buffer);
+void bind_index_buffer(G_Index_Buffer *buffer);
+void draw_indexed(G_Index_Buffer *buffer); // Triangles of the bound vertices
+void draw_indexed_instanced(G_Index_Buffer *buffer, s64 instances);
+
+void create_texture_array(G_Texture_Array *array, s64 width, s64 height, s64 layers); // RGBA8
+void destroy_texture_array(G_Texture_Array *array);
+void bind_texture_array(G_Texture_Array *array, s64 slot); // For the pixel shader
+void update_texture_array_layers(G_Texture_Array *array, s64 *layers, u8 **pixels, s64 count); // Tightly packed RGBA8 per layer
+void copy_texture_array_layer(G_Texture_Array *destination, s64 destination_layer, G_Texture_Array *source, s64 source_layer); // On the GPU
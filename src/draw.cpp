@@ -6,43 +6,105 @@
 
 // --- App
 #include "app.h"
+#include "d3d11_extras.h"
 #include "draw.h"
+#include "paint.h"
+#include "profiler.h"
+
+//
+// Each Tile_Vertex goes in as four 16-bit unorms, which the input assembler turns into
+// the steps across the tile for world_mesh.hlsl. Foundation's shaders and vertex buffers
+// only take floats, so the tile meshes use the ones of d3d11_extras.
+//
+G_Vertex_Input TILE_VERTEX_INPUTS[] = {
+    { "POSITION", VERTEX_FORMAT_Unorm16x4 },
+};
 
-#define IMM2D_BATCH_SIZE 512
-#define REDRAW_TILES_EVERY_FRAME true
+Shader_Input_Specification UNIT_GRID_SHADER_INPUTS[] = {
+    { "UV", 2, 0 },
+};
 
-Shader_Input_Specification TILE_SHADER_INPUTS[] = {
-    { "POSITION", 3, 0 },
-    { "UV", 2, 1 },
+struct Tile_Mesh_Constants {
+    v4f box; // lat0, lon0, lat1, lon1
+    v4f heights; // height0, height1
 };
 
-Shader_Input_Specification IMM2D_SHADER_INPUTS[] = {
-    { "POSITION", 2, 0 },
-    { "COLOR", 4, 1 },
+struct Mesh {
+    G_Vertex_Buffer vertices;
+    G_Index_Buffer *indices; // Shared between meshes, may be null
+    Tile_Mesh_Constants constants; // Decoding the quantized vertices, see Tile_Vertex_Range
 };
 
 struct Tile_Shader_Constants {
     m4f projection_view;
+    s32 map_mode;
+    f32 world_scale;
+    f32 morph; // The globe factor of Map_Morph, negative unless switching the map mode
+    f32 padding;
+    v4f morph_center; // lat, lon
+    v4f morph_origin;
+    v4f morph_east;
+    v4f morph_north;
+};
+
+struct Tile_Instance {
+    v4f box; // lat0, lon0, lat1, lon1
+    s32 layer;
+    s32 padding[3];
+};
+
+struct Tile_Texture_Layer {
+    s64 page;
+    s64 layer;
+};
+
+struct Tile_Texture_Page {
+    b8 allocated; // Released pages keep their slot, since the textures refer to their page by index
+    G_Texture_Array array;
+    s64 used_layers; // Layers below this have been handed out at some point
+    s64 *free_layers/*[TILE_TEXTURE_PAGE_LAYERS]*/;
+    s64 free_count;
+    Tile_Texture_Layer **owners/*[TILE_TEXTURE_PAGE_LAYERS]*/; // The texture in each layer below used_layers, null if free
+
+    // The visible tiles using this page in the current batch
+    Tile_Instance *instances/*[TILE_INSTANCE_BATCH_SIZE]*/;
+    s64 instance_count;
+};
+
+struct Unit_Grid {
+    Vertex_Buffer_Array vertices;
+    G_Index_Buffer *indices;
 };
 
 struct Render_Data {
     Frame_Buffer *default_fbo;
+    b8 instanced; // DRAW_TILES_INSTANCED, until switch_to_tile_meshes
 
     // Rendering the tiles on screen
-    Shader world_shader;
     Shader_Constant_Buffer world_constants_buffer;
 
-    // Rendering the tile textures
-    Frame_Buffer imm2d_fbo;
-    Shader imm2d_shader;
-    Vertex_Buffer_Array imm2d_mesh;
-    v2f *imm2d_positions/*[IMM2D_BATCH_SIZE]*/;
-    v4f *imm2d_colors/*[IMM2D_BATCH_SIZE]*/;
-    s64 imm2d_count;
+    // Rendering tiles with their own meshes
+    G_Shader tile_mesh_shader;
+    b8 tile_mesh_shader_loaded; // The reason has been reported, the tiles are skipped
+    Shader_Constant_Buffer tile_mesh_buffer;
+
+    // Rendering all tiles through instances of a shared unit grid
+    Shader world_shader;
+    Shader_Constant_Buffer tile_instances_buffer;
+    Unit_Grid unit_grids[2]; // Indexed by the map mode
+    Tile_Texture_Page tile_pages[TILE_TEXTURE_PAGES];
+    s64 tile_page_count;
 };
 
 Render_Data render_data;
 
+//
+// The device and immediate context which create_d3d11_context sets up. Foundation has
+// no accessor for them, so they are declared here and handed to d3d11_extras.
+//
+extern ID3D11Device *d3d_device;
+extern ID3D11DeviceContext *d3d_context;
+
 static
 void maybe_report_error(Error_Code error) {
     if(error != Success) {
@@ -51,174 +113,303 @@ void maybe_report_error(Error_Code error) {
     }
 }
 
-void setup_draw_data(App *app) {
-    Error_Code error;
-    
-    create_d3d11_context(&app->window, false);
-    error = create_shader_from_file(&render_data.world_shader, "data/world.hlsl"_s, TILE_SHADER_INPUTS, ARRAY_COUNT(TILE_SHADER_INPUTS));
-    maybe_report_error(error);
+static
+void create_unit_grid(App *app, Unit_Grid *grid, Map_Mode map_mode) {
+    // The uvs of a tile mesh, laid out exactly like create_tile_vertices does.
+    s64 segments = get_tile_segments(map_mode, 0, null); // The coarsest level needs the most segments to follow the globe
+    s64 stride   = segments + 1;
 
-    create_shader_constant_buffer(&render_data.world_constants_buffer, sizeof(Tile_Shader_Constants));
-    
-	render_data.default_fbo = get_default_frame_buffer(&app->window);
-    create_frame_buffer(&render_data.imm2d_fbo, 1);
-    create_frame_buffer_color_attachment(&render_data.imm2d_fbo, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION);
+    v2f *uvs = (v2f *) app->allocator.allocate(stride * stride * sizeof(v2f));
 
-    error = create_shader_from_file(&render_data.imm2d_shader, "data/imm2d.hlsl"_s, IMM2D_SHADER_INPUTS, ARRAY_COUNT(IMM2D_SHADER_INPUTS));
-    maybe_report_error(error);
+    for(s64 i = 0; i < stride; ++i) {
+        for(s64 j = 0; j < stride; ++j) {
+            uvs[i * stride + j] = v2f((f32) j / (f32) segments, (f32) i / (f32) segments);
+        }
+    }
 
-    create_vertex_buffer_array(&render_data.imm2d_mesh, VERTEX_BUFFER_Triangles);
-    allocate_vertex_data(&render_data.imm2d_mesh, IMM2D_BATCH_SIZE * 2, 2);
-    allocate_vertex_data(&render_data.imm2d_mesh, IMM2D_BATCH_SIZE * 4, 4);
+    create_vertex_buffer_array(&grid->vertices, VERTEX_BUFFER_Triangles);
+    add_vertex_data(&grid->vertices, uvs[0].values, stride * stride * 2, 2, false);
+    grid->indices = (G_Index_Buffer *) get_tile_index_buffer(app, segments);
 
-    render_data.imm2d_positions = (v2f *) app->allocator.allocate(IMM2D_BATCH_SIZE * sizeof(v2f));
-    render_data.imm2d_colors    = (v4f *) app->allocator.allocate(IMM2D_BATCH_SIZE * sizeof(v4f));
-    render_data.imm2d_count     = 0;
+    app->allocator.deallocate(uvs);
 }
 
-void destroy_draw_data(App *app) {
-    app->allocator.deallocate(render_data.imm2d_positions);
-    app->allocator.deallocate(render_data.imm2d_colors);
+static
+Tile_Texture_Page *create_tile_texture_page(App *app) {
+    Tile_Texture_Page *page = null;
 
-    destroy_vertex_buffer_array(&render_data.imm2d_mesh);
-    destroy_shader(&render_data.imm2d_shader);
-    destroy_shader_constant_buffer(&render_data.world_constants_buffer);
-    destroy_shader(&render_data.world_shader);
-    destroy_frame_buffer(&render_data.imm2d_fbo);
-    destroy_d3d11_context(&app->window);
-}
+    for(s64 i = 0; i < render_data.tile_page_count; ++i) {
+        if(!render_data.tile_pages[i].allocated) {
+            page = &render_data.tile_pages[i];
+            break;
+        }
+    }
 
+    if(!page) {
+        if(render_data.tile_page_count == TILE_TEXTURE_PAGES) {
+            log(LOG_Warning, "Ran out of tile texture pages (%lld layers), tiles wait for a texture to be freed.", (s64) TILE_TEXTURE_PAGES * TILE_TEXTURE_PAGE_LAYERS);
+            return null;
+        }
 
+        page = &render_data.tile_pages[render_data.tile_page_count];
+        ++render_data.tile_page_count;
+    }
 
-static inline
-v4f color_from_coordinate(const Coordinate &coord) {
-    return v4f{ (f32) ((coord.lon + 180.0) / 360.0), (f32) ((coord.lat + 90.0) / 180.0), 0.0, 1.0 };
+    page->allocated = true;
+    create_texture_array(&page->array, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_PAGE_LAYERS);
+
+    page->used_layers    = 0;
+    page->free_layers    = (s64 *) app->allocator.allocate(TILE_TEXTURE_PAGE_LAYERS * sizeof(s64));
+    page->free_count     = 0;
+    page->owners         = (Tile_Texture_Layer **) app->allocator.allocate(TILE_TEXTURE_PAGE_LAYERS * sizeof(Tile_Texture_Layer *));
+    page->instances      = (Tile_Instance *) app->allocator.allocate(TILE_INSTANCE_BATCH_SIZE * sizeof(Tile_Instance));
+    page->instance_count = 0;
+    return page;
 }
 
-static inline
-v2f tile_from_coordinate_space(Tile *tile, const Coordinate &coord) {
-    return v2f(
-        (f32) ((coord.lon - tile->box.lon0) / (tile->box.lon1 - tile->box.lon0) * 2.0 - 1.0),
-        (f32) (1.0 - (coord.lat - tile->box.lat0) / (tile->box.lat1 - tile->box.lat0) * 2.0));
+static
+void destroy_tile_texture_page(App *app, Tile_Texture_Page *page) {
+    destroy_texture_array(&page->array);
+    app->allocator.deallocate(page->free_layers);
+    app->allocator.deallocate(page->owners);
+    app->allocator.deallocate(page->instances);
+    *page = Tile_Texture_Page{};
 }
 
 static
-void flush_imm2d() {
-    update_vertex_data(&render_data.imm2d_mesh, 0, render_data.imm2d_positions[0].values, render_data.imm2d_count * 2);
-    update_vertex_data(&render_data.imm2d_mesh, 1, render_data.imm2d_colors[0].values, render_data.imm2d_count * 4);
+Tile_Texture_Page *find_tile_texture_page_with_free_layer(Tile_Texture_Page *excluded) {
+    for(s64 i = 0; i < render_data.tile_page_count; ++i) {
+        Tile_Texture_Page *page = &render_data.tile_pages[i];
+        if(page != excluded && page->allocated && (page->free_count || page->used_layers < TILE_TEXTURE_PAGE_LAYERS)) return page;
+    }
 
-    bind_shader(&render_data.imm2d_shader);
-    bind_vertex_buffer_array(&render_data.imm2d_mesh);
-    draw_vertex_buffer_array(&render_data.imm2d_mesh);
+    return null;
+}
 
-    render_data.imm2d_count = 0;
+static
+void assign_tile_texture_layer(Tile_Texture_Page *page, Tile_Texture_Layer *layer) {
+    layer->page  = page - render_data.tile_pages;
+    layer->layer = page->free_count ? page->free_layers[--page->free_count] : page->used_layers++;
+    page->owners[layer->layer] = layer;
 }
 
 static
-void imm2d_tile_space(const v2f &p0, const v2f &p1, const v2f &p2, const v4f &c0, const v4f &c1, const v4f &c2) {
-    if(render_data.imm2d_count + 3 > IMM2D_BATCH_SIZE) flush_imm2d();
+void destroy_tile_texture_pages(App *app) {
+    for(s64 i = 0; i < render_data.tile_page_count; ++i) {
+        if(render_data.tile_pages[i].allocated) destroy_tile_texture_page(app, &render_data.tile_pages[i]);
+    }
 
-    render_data.imm2d_positions[render_data.imm2d_count + 0] = p0;
-    render_data.imm2d_positions[render_data.imm2d_count + 1] = p1;
-    render_data.imm2d_positions[render_data.imm2d_count + 2] = p2;
+    render_data.tile_page_count = 0;
+}
 
-    render_data.imm2d_colors[render_data.imm2d_count + 0] = c0;
-    render_data.imm2d_colors[render_data.imm2d_count + 1] = c1;
-    render_data.imm2d_colors[render_data.imm2d_count + 2] = c2;
+static
+void setup_instanced_tiles(App *app) {
+    Error_Code error = create_shader_from_file(&render_data.world_shader, "data/world.hlsl"_s, UNIT_GRID_SHADER_INPUTS, ARRAY_COUNT(UNIT_GRID_SHADER_INPUTS));
+    maybe_report_error(error);
 
-    render_data.imm2d_count += 3;
+    create_shader_constant_buffer(&render_data.tile_instances_buffer, TILE_INSTANCE_BATCH_SIZE * sizeof(Tile_Instance));
+    create_unit_grid(app, &render_data.unit_grids[MAP_MODE_2D], MAP_MODE_2D);
+    create_unit_grid(app, &render_data.unit_grids[MAP_MODE_3D], MAP_MODE_3D);
 }
 
 static
-void imm2d_tile_space(const v2f &p0, const v2f &p1, const v2f &p2, const v4f &color) {
-    if(render_data.imm2d_count + 3 > IMM2D_BATCH_SIZE) flush_imm2d();
+void destroy_instanced_tiles(App *app) {
+    // The index buffers of the unit grids are owned by the tiles.
+    for(s64 i = 0; i < ARRAY_COUNT(render_data.unit_grids); ++i) {
+        destroy_vertex_buffer_array(&render_data.unit_grids[i].vertices);
+        render_data.unit_grids[i].indices = null;
+    }
 
-    render_data.imm2d_positions[render_data.imm2d_count + 0] = p0;
-    render_data.imm2d_positions[render_data.imm2d_count + 1] = p1;
-    render_data.imm2d_positions[render_data.imm2d_count + 2] = p2;
+    destroy_tile_texture_pages(app);
+    destroy_shader_constant_buffer(&render_data.tile_instances_buffer);
+    destroy_shader(&render_data.world_shader);
+}
 
-    render_data.imm2d_colors[render_data.imm2d_count + 0] = color;
-    render_data.imm2d_colors[render_data.imm2d_count + 1] = color;
-    render_data.imm2d_colors[render_data.imm2d_count + 2] = color;
+static
+void setup_tile_meshes(App *app) {
+    render_data.tile_mesh_shader_loaded = create_shader_from_file(&render_data.tile_mesh_shader, "data/world_mesh.hlsl", TILE_VERTEX_INPUTS, ARRAY_COUNT(TILE_VERTEX_INPUTS));
+    if(!render_data.tile_mesh_shader_loaded) foundation_error("The tile meshes won't be drawn without their shader.");
+    create_shader_constant_buffer(&render_data.tile_mesh_buffer, sizeof(Tile_Mesh_Constants));
+}
 
-    render_data.imm2d_count += 3;
+static
+void destroy_tile_meshes(App *app) {
+    destroy_shader_constant_buffer(&render_data.tile_mesh_buffer);
+    destroy_shader(&render_data.tile_mesh_shader);
 }
 
-static inline
-void imm2d_coordinate_space(Tile *tile, const Coordinate &p0, const Coordinate &p1, const Coordinate &p2, const v4f &color) {
-    imm2d_tile_space(tile_from_coordinate_space(tile, p0), tile_from_coordinate_space(tile, p1), tile_from_coordinate_space(tile, p2), color);
+void setup_draw_data(App *app) {
+    create_d3d11_context(&app->window, false);
+    render_data.default_fbo = get_default_frame_buffer(&app->window);
+    setup_d3d11_extras(d3d_device, d3d_context);
+
+    create_shader_constant_buffer(&render_data.world_constants_buffer, sizeof(Tile_Shader_Constants));
+
+    render_data.instanced = DRAW_TILES_INSTANCED;
+
+    if(render_data.instanced) {
+        setup_instanced_tiles(app);
+    } else {
+        setup_tile_meshes(app);
+    }
 }
 
-static inline
-void imm2d_coordinate_space(Tile *tile, const Coordinate &p0, const Coordinate &p1, const Coordinate &p2, const v4f &c0, const v4f &c1, const v4f &c2) {
-    imm2d_tile_space(tile_from_coordinate_space(tile, p0), tile_from_coordinate_space(tile, p1), tile_from_coordinate_space(tile, p2), c0, c1, c2);
+void destroy_draw_data(App *app) {
+    if(render_data.instanced) {
+        destroy_instanced_tiles(app);
+    } else {
+        destroy_tile_meshes(app);
+    }
+
+    destroy_shader_constant_buffer(&render_data.world_constants_buffer);
+    destroy_d3d11_extras();
+    destroy_d3d11_context(&app->window);
 }
 
+void switch_to_tile_meshes(App *app) {
+    if(!render_data.instanced) return;
+
+    assert(!render_data.tile_page_count); // No tile may have a texture yet
+    destroy_instanced_tiles(app);
+    setup_tile_meshes(app);
+    render_data.instanced = false;
+}
+
+
+
 static
-void maybe_repaint_tiles(Tile *tile) {
-    if((REDRAW_TILES_EVERY_FRAME && tile->leaf)|| tile->state == TILE_Requires_Repainting) {
-        bind_frame_buffer(&render_data.imm2d_fbo);
-        clear_frame_buffer(&render_data.imm2d_fbo, 255 / 255.0f, 0 / 255.0f, 0 / 255.0f);
-        
-        Coordinate p0{ tile->box.lat0, tile->box.lon0 };
-        Coordinate p1{ tile->box.lat0, tile->box.lon1 };
-        Coordinate p2{ tile->box.lat1, tile->box.lon0 };
-        Coordinate p3{ tile->box.lat1, tile->box.lon1 };
-
-        v4f c0 = color_from_coordinate(p0);
-        v4f c1 = color_from_coordinate(p1);
-        v4f c2 = color_from_coordinate(p2);
-        v4f c3 = color_from_coordinate(p3);
-
-        imm2d_coordinate_space(tile, p0, p1, p2, c0, c1, c2);
-        imm2d_coordinate_space(tile, p1, p3, p2, c1, c3, c2);
-        flush_imm2d();
-        
-        blit_frame_buffer((Texture *) tile->texture, &render_data.imm2d_fbo);
-
-        tile->state = TILE_Valid;
+void draw_mesh(Mesh *mesh) {
+    PROFILE_COUNT(PROFILE_COUNTER_Draw_Calls, 1);
+    update_shader_constant_buffer(&render_data.tile_mesh_buffer, &mesh->constants);
+    bind_vertex_buffer(&mesh->vertices);
+
+    if(mesh->indices) {
+        bind_index_buffer(mesh->indices);
+        draw_indexed(mesh->indices);
+    } else {
+        draw_vertices(&mesh->vertices);
     }
+}
 
-    if(!tile->leaf) {
-        for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
-            maybe_repaint_tiles(tile->children[i]);
-        }
-    }
+static
+Unit_Grid *get_unit_grid(App *app) {
+    // The 2D grid only has the segments of the flat map, which can't be bent onto the globe.
+    return app->morph.remaining > 0 ? &render_data.unit_grids[MAP_MODE_3D] : &render_data.unit_grids[app->map_mode];
 }
 
 static
-void draw_tiles(Tile *tile) {
-    if(tile->leaf) {
-        bind_texture((Texture *) tile->texture, 0);
-        bind_vertex_buffer_array((Vertex_Buffer_Array *) tile->mesh);
-        draw_vertex_buffer_array((Vertex_Buffer_Array *) tile->mesh);
+void flush_tile_instances(App *app, Tile_Texture_Page *page) {
+    if(!page->instance_count) return;
+
+    Unit_Grid *grid = get_unit_grid(app);
+    update_shader_constant_buffer(&render_data.tile_instances_buffer, page->instances);
+    bind_texture_array(&page->array, 0);
+    draw_indexed_instanced(grid->indices, page->instance_count);
+    PROFILE_COUNT(PROFILE_COUNTER_Draw_Calls, 1);
+
+    page->instance_count = 0;
+}
+
+static
+void draw_tile_instance(App *app, Tile *tile) {
+    Tile_Texture_Layer *layer = (Tile_Texture_Layer *) tile->texture;
+    Tile_Texture_Page *page   = &render_data.tile_pages[layer->page];
+
+    Tile_Instance *instance = &page->instances[page->instance_count];
+    instance->box   = v4f((f32) tile->box.lat0, (f32) tile->box.lon0, (f32) tile->box.lat1, (f32) tile->box.lon1);
+    instance->layer = (s32) layer->layer;
+    ++page->instance_count;
+
+    if(page->instance_count == TILE_INSTANCE_BATCH_SIZE) flush_tile_instances(app, page);
+}
+
+static
+void draw_tiles(App *app, Tile *tile, Cull_Result parent_cull) {
+    Cull_Result cull = cull_drawn_tile(app, tile, parent_cull);
+    if(cull == CULL_Outside) {
+        ++app->cull_stats.tiles_culled;
+        return;
+    }
+
+    if(tile->leaf || tile->texture) {
+        // Non-leaf tiles only have a texture while their children are still pending.
+        if(!tile_has_geometry(tile)) return;
+
+        if(render_data.instanced) {
+            draw_tile_instance(app, tile);
+        } else {
+            bind_texture_array((G_Texture_Array *) tile->texture, 0);
+            draw_mesh((Mesh *) tile->mesh);
+        }
+
+        ++app->cull_stats.tiles_drawn;
     } else {
         for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
-            draw_tiles(tile->children[i]);
+            draw_tiles(app, tile->children[i], cull);
         }
     }
 }
 
+b8 draw_requires_tile_meshes() {
+    return !render_data.instanced;
+}
+
 void draw_one_frame(App *app) {
+    PROFILE_ZONE("Draw");
+
     //
     // Redraw all required tiles
     //
-    maybe_repaint_tiles(&app->root);
+    paint_invalidated_tiles(app);
 
     //
     // Draw all tiles
     //
-    Tile_Shader_Constants tile_shader_constants;
+    Tile_Shader_Constants tile_shader_constants = {};
     tile_shader_constants.projection_view = app->camera.projection_view;
+    tile_shader_constants.map_mode        = app->map_mode;
+    tile_shader_constants.world_scale     = (app->map_mode == MAP_MODE_2D) ? WORLD_SCALE_2D : WORLD_SCALE_3D;
+    tile_shader_constants.morph           = -1;
+
+    if(app->morph.remaining > 0) {
+        Map_Morph *morph = &app->morph;
+        tile_shader_constants.projection_view = morph->projection_view;
+        tile_shader_constants.morph           = morph->globe;
+        tile_shader_constants.morph_center    = v4f((f32) morph->center.lat, (f32) morph->center.lon, 0, 0);
+        tile_shader_constants.morph_origin    = v4f(morph->origin.x, morph->origin.y, morph->origin.z, 0);
+        tile_shader_constants.morph_east      = v4f(morph->east.x, morph->east.y, morph->east.z, 0);
+        tile_shader_constants.morph_north     = v4f(morph->north.x, morph->north.y, morph->north.z, 0);
+    }
+
     update_shader_constant_buffer(&render_data.world_constants_buffer, &tile_shader_constants);
     bind_frame_buffer(render_data.default_fbo);
     clear_frame_buffer(render_data.default_fbo, 50 / 255.0f, 96 / 255.0f, 140 / 255.0f);
     bind_shader_constant_buffer(&render_data.world_constants_buffer, 0, SHADER_Vertex);
-    bind_shader(&render_data.world_shader);
 
-    draw_tiles(&app->root);
+    if(render_data.instanced) {
+        Unit_Grid *grid = get_unit_grid(app);
+        bind_shader(&render_data.world_shader);
+        bind_shader_constant_buffer(&render_data.tile_instances_buffer, 1, SHADER_Vertex);
+        bind_vertex_buffer_array(&grid->vertices);
+        bind_index_buffer(grid->indices);
+    } else {
+        bind_shader(&render_data.tile_mesh_shader);
+        bind_shader_constant_buffer(&render_data.tile_mesh_buffer, 1, SHADER_Vertex);
+    }
 
-	swap_d3d11_buffers(&app->window);
+    app->cull_stats = Cull_Stats{};
+    if(render_data.instanced || render_data.tile_mesh_shader_loaded) draw_tiles(app, &app->root, CULL_Intersecting);
+
+    if(render_data.instanced) {
+        for(s64 i = 0; i < render_data.tile_page_count; ++i) flush_tile_instances(app, &render_data.tile_pages[i]);
+    }
+
+    PROFILE_COUNT(PROFILE_COUNTER_Tiles_Drawn, app->cull_stats.tiles_drawn);
+
+    {
+        PROFILE_ZONE("Swap");
+        swap_d3d11_buffers(&app->window);
+    }
 }
 
 
@@ -246,15 +437,153 @@ void destroy_texture(App *app, G_Handle handle) {
     app->allocator.deallocate(handle);
 }
 
-G_Handle create_mesh(App *app, f32 *positions, f32 *uvs, s64 vertex_count) {
-    Vertex_Buffer_Array *mesh = app->allocator.New<Vertex_Buffer_Array>();
-    create_vertex_buffer_array(mesh, VERTEX_BUFFER_Triangles);
-    add_vertex_data(mesh, positions, vertex_count * 3, 3, false);
-    add_vertex_data(mesh, uvs, vertex_count * 2, 2, false);
+G_Handle create_tile_texture(App *app, s64 width, s64 height, s64 channels) {
+    assert(width == TILE_TEXTURE_RESOLUTION && height == TILE_TEXTURE_RESOLUTION && channels == TILE_TEXTURE_CHANNELS);
+
+    if(!render_data.instanced) {
+        // A single layer, so that both paths upload through update_texture_array_layers.
+        G_Texture_Array *array = app->allocator.New<G_Texture_Array>();
+        create_texture_array(array, width, height, 1);
+        return array;
+    }
+
+    Tile_Texture_Page *page = find_tile_texture_page_with_free_layer(null);
+    if(!page) page = create_tile_texture_page(app);
+    if(!page) return null;
+
+    Tile_Texture_Layer *layer = app->allocator.New<Tile_Texture_Layer>();
+    assign_tile_texture_layer(page, layer);
+    return layer;
+}
+
+void destroy_tile_texture(App *app, G_Handle handle) {
+    if(!render_data.instanced) {
+        destroy_texture_array((G_Texture_Array *) handle);
+        app->allocator.deallocate(handle);
+        return;
+    }
+
+    Tile_Texture_Layer *layer = (Tile_Texture_Layer *) handle;
+    Tile_Texture_Page *page   = &render_data.tile_pages[layer->page];
+    page->free_layers[page->free_count] = layer->layer;
+    page->owners[layer->layer] = null;
+    ++page->free_count;
+    app->allocator.deallocate(layer);
+}
+
+s64 get_tile_texture_page_bytes() {
+    s64 pages = 0;
+    for(s64 i = 0; i < render_data.tile_page_count; ++i) pages += render_data.tile_pages[i].allocated;
+    return pages * TILE_TEXTURE_PAGE_LAYERS * TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_CHANNELS;
+}
+
+void compact_tile_texture_pages(App *app) {
+    //
+    // Evictions free layers all over the pages, but a page only gives its memory back
+    // once none of its layers is in use. So as long as fewer pages could hold all layers
+    // in use, the layers of the emptiest page move into the gaps of the others. The
+    // texture handles stay valid, only the page and layer they refer to change.
+    //
+    s64 layers_in_use = 0, pages = 0;
+
+    for(s64 i = 0; i < render_data.tile_page_count; ++i) {
+        Tile_Texture_Page *page = &render_data.tile_pages[i];
+        if(!page->allocated) continue;
+
+        layers_in_use += page->used_layers - page->free_count;
+        ++pages;
+    }
+
+    while(pages > (layers_in_use + TILE_TEXTURE_PAGE_LAYERS - 1) / TILE_TEXTURE_PAGE_LAYERS) {
+        Tile_Texture_Page *source = null;
+
+        for(s64 i = 0; i < render_data.tile_page_count; ++i) {
+            Tile_Texture_Page *page = &render_data.tile_pages[i];
+            if(page->allocated && (!source || page->used_layers - page->free_count < source->used_layers - source->free_count)) source = page;
+        }
+
+        for(s64 i = 0; i < source->used_layers; ++i) {
+            Tile_Texture_Layer *layer = source->owners[i];
+            if(!layer) continue;
+
+            // The other pages have enough gaps, otherwise there wouldn't be a page too many.
+            Tile_Texture_Page *destination = find_tile_texture_page_with_free_layer(source);
+            assign_tile_texture_layer(destination, layer);
+            copy_texture_array_layer(&destination->array, layer->layer, &source->array, i);
+        }
+
+        destroy_tile_texture_page(app, source);
+        --pages;
+    }
+}
+
+void update_tile_textures(App *app, G_Handle *textures, u32 **pixels, s64 count) {
+    if(!render_data.instanced) {
+        s64 layer = 0;
+        for(s64 i = 0; i < count; ++i) update_texture_array_layers((G_Texture_Array *) textures[i], &layer, (u8 **) &pixels[i], 1);
+        return;
+    }
+
+    // One update per texture array, covering all of its layers in this batch.
+    s64 temp_mark = mark_temp_allocator();
+    s64 *layers = (s64 *) temp.allocate(count * sizeof(s64));
+    u8 **layer_pixels = (u8 **) temp.allocate(count * sizeof(u8 *));
+
+    for(s64 i = 0; i < render_data.tile_page_count; ++i) {
+        s64 layer_count = 0;
+
+        for(s64 j = 0; j < count; ++j) {
+            Tile_Texture_Layer *layer = (Tile_Texture_Layer *) textures[j];
+            if(layer->page != i) continue;
+
+            layers[layer_count]       = layer->layer;
+            layer_pixels[layer_count] = (u8 *) pixels[j];
+            ++layer_count;
+        }
+
+        if(layer_count) update_texture_array_layers(&render_data.tile_pages[i].array, layers, layer_pixels, layer_count);
+    }
+
+    release_temp_allocator(temp_mark);
+}
+
+G_Handle create_index_buffer(App *app, u16 *indices, s64 count) {
+    G_Index_Buffer *buffer = app->allocator.New<G_Index_Buffer>();
+    create_index_buffer(buffer, indices, count);
+    return buffer;
+}
+
+void destroy_index_buffer(App *app, G_Handle handle) {
+    destroy_index_buffer((G_Index_Buffer *) handle);
+    app->allocator.deallocate(handle);
+}
+
+static
+Tile_Mesh_Constants get_tile_mesh_constants(Tile_Vertex_Range *range) {
+    Tile_Mesh_Constants constants;
+    constants.box     = v4f(range->lat0, range->lon0, range->lat1, range->lon1);
+    constants.heights = v4f(range->height0, range->height1, 0, 0);
+    return constants;
+}
+
+G_Handle create_mesh(App *app, Tile_Vertex *vertices, s64 vertex_count, Tile_Vertex_Range *range, G_Handle index_buffer) {
+    static_assert(sizeof(Tile_Vertex) == 4 * sizeof(u16), "Tile_Vertex must match VERTEX_FORMAT_Unorm16x4");
+
+    Mesh *mesh = app->allocator.New<Mesh>();
+    create_vertex_buffer(&mesh->vertices, vertices, sizeof(Tile_Vertex), vertex_count); // Dynamic, since tile meshes get recycled
+    mesh->indices   = (G_Index_Buffer *) index_buffer;
+    mesh->constants = get_tile_mesh_constants(range);
     return mesh;
 }
 
+void update_mesh(App *app, G_Handle handle, Tile_Vertex *vertices, s64 vertex_count, Tile_Vertex_Range *range) {
+    Mesh *mesh = (Mesh *) handle;
+    update_vertex_buffer(&mesh->vertices, vertices, vertex_count);
+    mesh->constants = get_tile_mesh_constants(range);
+}
+
 void destroy_mesh(App *app, G_Handle handle) {
-    destroy_vertex_buffer_array((Vertex_Buffer_Array *) handle);
-    app->allocator.deallocate(handle);
+    Mesh *mesh = (Mesh *) handle;
+    destroy_vertex_buffer(&mesh->vertices);
+    app->allocator.deallocate(mesh);
 }
@@ -1,15 +1,62 @@
 #pragma once
 
 struct App;
+struct Tile_Vertex;
+struct Tile_Vertex_Range;
 typedef void *G_Handle; // Graphics Handle
 
+//
+// When enabled, all visible tiles are drawn through a few instanced draw calls of one
+// shared unit grid. The tile textures then live in layers of shared texture arrays and
+// the vertex shader projects lat/lon itself, so tiles don't need meshes of their own.
+// The unit grid can't be displaced, so loading a terrain switches the backend to tile
+// meshes for the rest of the run (see switch_to_tile_meshes).
+//
+#ifndef DRAW_TILES_INSTANCED
+# define DRAW_TILES_INSTANCED true
+#endif
+
+#define TILE_INSTANCE_BATCH_SIZE 1024 // Instances per draw call, limited by the constant buffer size
+#define TILE_TEXTURE_PAGE_LAYERS 2048 // Layers per texture array, the D3D11 maximum
+#define TILE_TEXTURE_PAGES 8
+
 void setup_draw_data(App *app);
 void destroy_draw_data(App *app);
 
 void draw_one_frame(App *app);
+b8 draw_requires_tile_meshes();
+void switch_to_tile_meshes(App *app); // Before any tile exists, the tile index buffers must be recreated afterwards
 
 G_Handle create_texture(App *app, u8 *pixels, s64 width, s64 height, s64 channels);
 G_Handle create_empty_texture(App *app, s64 width, s64 height, s64 channels);
 void destroy_texture(App *app, G_Handle handle);
-G_Handle create_mesh(App *app, f32 *positions, f32 *uvs, s64 count);
+G_Handle create_tile_texture(App *app, s64 width, s64 height, s64 channels); // May be a layer of a texture array
+void destroy_tile_texture(App *app, G_Handle handle);
+void update_tile_textures(App *app, G_Handle *textures, u32 **pixels, s64 count); // Tile textures from create_tile_texture, PAINT_TILE_PIXELS each
+s64 get_tile_texture_page_bytes(); // Of all allocated texture pages, zero unless the tile textures are layers of pages
+void compact_tile_texture_pages(App *app); // Moves the layers in use into as few pages as possible and releases the others
+G_Handle create_index_buffer(App *app, u16 *indices, s64 count);
+void destroy_index_buffer(App *app, G_Handle handle);
+G_Handle create_mesh(App *app, Tile_Vertex *vertices, s64 count, Tile_Vertex_Range *range, G_Handle index_buffer); // The index buffer may be null
+void update_mesh(App *app, G_Handle handle, Tile_Vertex *vertices, s64 count, Tile_Vertex_Range *range); // The vertex count must not change
 void destroy_mesh(App *app, G_Handle handle);
+
+//
+// The headless backends record the commands they would have submitted to the GPU, so
+// that the benchmarks can check how many draw calls a frame takes.
+//
+enum Draw_Command_Kind {
+    DRAW_COMMAND_Bind_Texture,
+    DRAW_COMMAND_Bind_Mesh,
+    DRAW_COMMAND_Draw,
+    DRAW_COMMAND_Draw_Instanced,
+    DRAW_COMMAND_Update_Textures,
+};
+
+struct Draw_Command {
+    Draw_Command_Kind kind;
+    s64 count; // Instances for DRAW_COMMAND_Draw_Instanced, textures for DRAW_COMMAND_Update_Textures
+};
+
+Draw_Command *get_recorded_draw_commands(s64 *count); // Of the last frame, headless backend only
+u32 *get_software_frame_buffer(s64 *width, s64 *height, s64 *stride); // RGBA8 of the last frame, software backend only
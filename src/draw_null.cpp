@@ -0,0 +1,311 @@
+// --- Foundation
+#include <foundation.h>
+
+// --- App
+#include "app.h"
+#include "draw.h"
+#include "paint.h"
+#include "profiler.h"
+
+//
+// A graphics backend which never talks to a GPU. Resources are plain bookkeeping
+// structs, so that the tile logic can run (and be benchmarked) on headless machines.
+// Instead of submitting anything, each frame records the commands that draw.cpp would
+// have issued. This replaces draw.cpp in the headless build.
+//
+
+struct Null_Texture {
+    s64 width, height, channels;
+};
+
+struct Null_Index_Buffer {
+    s64 count;
+};
+
+struct Null_Mesh {
+    s64 vertex_count;
+    Null_Index_Buffer *indices;
+};
+
+struct Null_Tile_Texture {
+    s64 page;
+    s64 layer;
+};
+
+struct Null_Tile_Page {
+    b8 allocated; // Released pages keep their slot, since the textures refer to their page by index
+    s64 used_layers;
+    s64 *free_layers/*[TILE_TEXTURE_PAGE_LAYERS]*/;
+    s64 free_count;
+    Null_Tile_Texture **owners/*[TILE_TEXTURE_PAGE_LAYERS]*/; // The texture in each layer below used_layers, null if free
+    s64 instance_count; // In the current batch
+};
+
+struct Null_Render_Data {
+    b8 instanced; // DRAW_TILES_INSTANCED, until switch_to_tile_meshes
+    Null_Tile_Page tile_pages[TILE_TEXTURE_PAGES];
+    s64 tile_page_count;
+
+    Draw_Command *commands;
+    s64 command_count;
+    s64 command_capacity;
+};
+
+Null_Render_Data null_render_data;
+
+static
+void destroy_tile_page(App *app, Null_Tile_Page *page) {
+    app->allocator.deallocate(page->free_layers);
+    app->allocator.deallocate(page->owners);
+    *page = Null_Tile_Page{};
+}
+
+static
+Null_Tile_Page *find_tile_page_with_free_layer(Null_Tile_Page *excluded) {
+    for(s64 i = 0; i < null_render_data.tile_page_count; ++i) {
+        Null_Tile_Page *page = &null_render_data.tile_pages[i];
+        if(page != excluded && page->allocated && (page->free_count || page->used_layers < TILE_TEXTURE_PAGE_LAYERS)) return page;
+    }
+
+    return null;
+}
+
+static
+void assign_tile_page_layer(Null_Tile_Page *page, Null_Tile_Texture *texture) {
+    texture->page  = page - null_render_data.tile_pages;
+    texture->layer = page->free_count ? page->free_layers[--page->free_count] : page->used_layers++;
+    page->owners[texture->layer] = texture;
+}
+
+void setup_draw_data(App *app) {
+    null_render_data = Null_Render_Data{};
+    null_render_data.instanced = DRAW_TILES_INSTANCED;
+}
+
+void destroy_draw_data(App *app) {
+    for(s64 i = 0; i < null_render_data.tile_page_count; ++i) {
+        if(null_render_data.tile_pages[i].allocated) destroy_tile_page(app, &null_render_data.tile_pages[i]);
+    }
+
+    if(null_render_data.commands) app->allocator.deallocate(null_render_data.commands);
+    null_render_data = Null_Render_Data{};
+}
+
+void switch_to_tile_meshes(App *app) {
+    assert(!null_render_data.tile_page_count); // No tile may have a texture yet
+    null_render_data.instanced = false;
+}
+
+static
+void record_command(App *app, Draw_Command_Kind kind, s64 count = 0) {
+    if(kind == DRAW_COMMAND_Draw || kind == DRAW_COMMAND_Draw_Instanced) PROFILE_COUNT(PROFILE_COUNTER_Draw_Calls, 1);
+
+    if(null_render_data.command_count == null_render_data.command_capacity) {
+        s64 capacity = max<s64>(null_render_data.command_capacity * 2, 1024);
+        Draw_Command *commands = (Draw_Command *) app->allocator.allocate(capacity * sizeof(Draw_Command));
+
+        if(null_render_data.commands) {
+            memcpy(commands, null_render_data.commands, null_render_data.command_count * sizeof(Draw_Command));
+            app->allocator.deallocate(null_render_data.commands);
+        }
+
+        null_render_data.commands         = commands;
+        null_render_data.command_capacity = capacity;
+    }
+
+    null_render_data.commands[null_render_data.command_count] = Draw_Command{ kind, count };
+    ++null_render_data.command_count;
+}
+
+Draw_Command *get_recorded_draw_commands(s64 *count) {
+    *count = null_render_data.command_count;
+    return null_render_data.commands;
+}
+
+static
+void flush_tile_instances(App *app, Null_Tile_Page *page) {
+    if(!page->instance_count) return;
+
+    record_command(app, DRAW_COMMAND_Bind_Texture);
+    record_command(app, DRAW_COMMAND_Draw_Instanced, page->instance_count);
+    page->instance_count = 0;
+}
+
+static
+void draw_tiles(App *app, Tile *tile, Cull_Result parent_cull) {
+    Cull_Result cull = cull_drawn_tile(app, tile, parent_cull);
+    if(cull == CULL_Outside) {
+        ++app->cull_stats.tiles_culled;
+        return;
+    }
+
+    if(tile->leaf || tile->texture) {
+        // Non-leaf tiles only have a texture while their children are still pending.
+        if(!tile_has_geometry(tile)) return;
+
+        if(null_render_data.instanced) {
+            Null_Tile_Page *page = &null_render_data.tile_pages[((Null_Tile_Texture *) tile->texture)->page];
+            ++page->instance_count;
+            if(page->instance_count == TILE_INSTANCE_BATCH_SIZE) flush_tile_instances(app, page);
+        } else {
+            record_command(app, DRAW_COMMAND_Bind_Texture);
+            record_command(app, DRAW_COMMAND_Bind_Mesh);
+            record_command(app, DRAW_COMMAND_Draw);
+        }
+
+        ++app->cull_stats.tiles_drawn;
+    } else {
+        for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+            draw_tiles(app, tile->children[i], cull);
+        }
+    }
+}
+
+b8 draw_requires_tile_meshes() {
+    return !null_render_data.instanced;
+}
+
+void draw_one_frame(App *app) {
+    PROFILE_ZONE("Draw");
+
+    null_render_data.command_count = 0;
+    paint_invalidated_tiles(app);
+
+    if(null_render_data.instanced) record_command(app, DRAW_COMMAND_Bind_Mesh); // The unit grid
+
+    app->cull_stats = Cull_Stats{};
+    draw_tiles(app, &app->root, CULL_Intersecting);
+
+    if(null_render_data.instanced) {
+        for(s64 i = 0; i < null_render_data.tile_page_count; ++i) flush_tile_instances(app, &null_render_data.tile_pages[i]);
+    }
+
+    PROFILE_COUNT(PROFILE_COUNTER_Tiles_Drawn, app->cull_stats.tiles_drawn);
+}
+
+
+
+G_Handle create_texture(App *app, u8 *pixels, s64 width, s64 height, s64 channels) {
+    Null_Texture *texture = app->allocator.New<Null_Texture>();
+    texture->width    = width;
+    texture->height   = height;
+    texture->channels = channels;
+    return texture;
+}
+
+G_Handle create_empty_texture(App *app, s64 width, s64 height, s64 channels) {
+    return create_texture(app, null, width, height, channels);
+}
+
+void destroy_texture(App *app, G_Handle handle) {
+    app->allocator.deallocate(handle);
+}
+
+G_Handle create_tile_texture(App *app, s64 width, s64 height, s64 channels) {
+    if(!null_render_data.instanced) return create_empty_texture(app, width, height, channels);
+
+    Null_Tile_Page *page = find_tile_page_with_free_layer(null);
+
+    for(s64 i = 0; !page && i < null_render_data.tile_page_count; ++i) {
+        if(!null_render_data.tile_pages[i].allocated) page = &null_render_data.tile_pages[i];
+    }
+
+    if(!page) {
+        if(null_render_data.tile_page_count == TILE_TEXTURE_PAGES) {
+            log(LOG_Warning, "Ran out of tile texture pages (%lld layers), tiles wait for a texture to be freed.", (s64) TILE_TEXTURE_PAGES * TILE_TEXTURE_PAGE_LAYERS);
+            return null;
+        }
+
+        page = &null_render_data.tile_pages[null_render_data.tile_page_count];
+        ++null_render_data.tile_page_count;
+    }
+
+    if(!page->allocated) {
+        page->allocated   = true;
+        page->free_layers = (s64 *) app->allocator.allocate(TILE_TEXTURE_PAGE_LAYERS * sizeof(s64));
+        page->owners      = (Null_Tile_Texture **) app->allocator.allocate(TILE_TEXTURE_PAGE_LAYERS * sizeof(Null_Tile_Texture *));
+    }
+
+    Null_Tile_Texture *texture = app->allocator.New<Null_Tile_Texture>();
+    assign_tile_page_layer(page, texture);
+    return texture;
+}
+
+void destroy_tile_texture(App *app, G_Handle handle) {
+    if(!null_render_data.instanced) {
+        destroy_texture(app, handle);
+        return;
+    }
+
+    Null_Tile_Texture *texture = (Null_Tile_Texture *) handle;
+    Null_Tile_Page *page       = &null_render_data.tile_pages[texture->page];
+    page->free_layers[page->free_count] = texture->layer;
+    page->owners[texture->layer] = null;
+    ++page->free_count;
+    app->allocator.deallocate(texture);
+}
+
+s64 get_tile_texture_page_bytes() {
+    s64 pages = 0;
+    for(s64 i = 0; i < null_render_data.tile_page_count; ++i) pages += null_render_data.tile_pages[i].allocated;
+    return pages * TILE_TEXTURE_PAGE_LAYERS * TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_CHANNELS;
+}
+
+void compact_tile_texture_pages(App *app) {
+    // Like draw.cpp, without any pixels to copy.
+    s64 layers_in_use = 0, pages = 0;
+
+    for(s64 i = 0; i < null_render_data.tile_page_count; ++i) {
+        Null_Tile_Page *page = &null_render_data.tile_pages[i];
+        if(!page->allocated) continue;
+
+        layers_in_use += page->used_layers - page->free_count;
+        ++pages;
+    }
+
+    while(pages > (layers_in_use + TILE_TEXTURE_PAGE_LAYERS - 1) / TILE_TEXTURE_PAGE_LAYERS) {
+        Null_Tile_Page *source = null;
+
+        for(s64 i = 0; i < null_render_data.tile_page_count; ++i) {
+            Null_Tile_Page *page = &null_render_data.tile_pages[i];
+            if(page->allocated && (!source || page->used_layers - page->free_count < source->used_layers - source->free_count)) source = page;
+        }
+
+        for(s64 i = 0; i < source->used_layers; ++i) {
+            if(source->owners[i]) assign_tile_page_layer(find_tile_page_with_free_layer(source), source->owners[i]);
+        }
+
+        destroy_tile_page(app, source);
+        --pages;
+    }
+}
+
+void update_tile_textures(App *app, G_Handle *textures, u32 **pixels, s64 count) {
+    record_command(app, DRAW_COMMAND_Update_Textures, count);
+}
+
+G_Handle create_index_buffer(App *app, u16 *indices, s64 count) {
+    Null_Index_Buffer *buffer = app->allocator.New<Null_Index_Buffer>();
+    buffer->count = count;
+    return buffer;
+}
+
+void destroy_index_buffer(App *app, G_Handle handle) {
+    app->allocator.deallocate(handle);
+}
+
+G_Handle create_mesh(App *app, Tile_Vertex *vertices, s64 vertex_count, Tile_Vertex_Range *range, G_Handle index_buffer) {
+    Null_Mesh *mesh = app->allocator.New<Null_Mesh>();
+    mesh->vertex_count = vertex_count;
+    mesh->indices      = (Null_Index_Buffer *) index_buffer;
+    return mesh;
+}
+
+void update_mesh(App *app, G_Handle handle, Tile_Vertex *vertices, s64 vertex_count, Tile_Vertex_Range *range) {
+    Null_Mesh *mesh = (Null_Mesh *) handle;
+    assert(mesh->vertex_count == vertex_count);
+}
+
+void destroy_mesh(App *app, G_Handle handle) {
+    app->allocator.deallocate(handle);
+}
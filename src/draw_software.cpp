@@ -0,0 +1,1096 @@
+// --- C++
+#include <atomic>
+#include <thread>
+
+// --- C
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <math/maths.h>
+#include <math/v2.h>
+#include <math/v4.h>
+#include <math/m4.h>
+
+// --- App
+#include "app.h"
+#include "draw.h"
+#include "jobs.h"
+#include "paint.h"
+#include "profiler.h"
+
+//
+// A graphics backend which renders into an in-memory frame buffer on the CPU, for
+// snapshots on headless servers and for pixel-exact regression tests. It follows the
+// D3D11 backend: The tile textures come from the painter in paint.cpp, and the world
+// pass draws all tiles with a depth buffer and nearest sampling like world.hlsl.
+//
+// The world pass runs in three phases:
+//   1. The vertices of all drawn tiles are transformed into screen space, four at a
+//      time, spread over the job system.
+//   2. Triangles are clipped if necessary and sorted into screen space bins, in
+//      submission order.
+//   3. Every bin is set up (four triangles at a time) and rasterized by one thread,
+//      so the result does not depend on the number of threads.
+// This replaces draw.cpp in the snapshot build.
+//
+
+#define SOFTWARE_BIN_SIZE       64 // Pixels, must be a multiple of four
+#define SOFTWARE_DEFAULT_WIDTH  1920
+#define SOFTWARE_DEFAULT_HEIGHT 1080
+#define SOFTWARE_NEAR_W         0.0001f
+#define SOFTWARE_GUARD_BAND     8.0f // In normalized device coordinates, larger triangles get clipped
+#define SOFTWARE_CLEAR_COLOR    0xff8c6032 // 50, 96, 140 in RGBA
+#define SOFTWARE_SUBPIXELS      256.0f // Screen positions are snapped to this many steps per pixel
+
+struct Software_Texture {
+    s64 width, height;
+    u32 *pixels; // RGBA8
+};
+
+struct Software_Index_Buffer {
+    u16 *indices;
+    s64 count;
+};
+
+struct Software_Mesh {
+    Tile_Vertex *vertices;
+    Tile_Vertex_Range range;
+    s64 vertex_count;
+    Software_Index_Buffer *indices; // May be null
+};
+
+struct Software_Frame_Buffer {
+    s64 width, height;
+    s64 stride; // Both the stride and the allocated rows are padded to the bin size
+    u32 *color;
+    f32 *depth;
+};
+
+struct Software_Draw {
+    Software_Texture *texture;
+    Software_Mesh *mesh; // Null for tiles drawn from the unit grid
+    Bounding_Box box;
+    Software_Index_Buffer *indices;
+    s64 first_vertex;
+    s64 vertex_count;
+};
+
+struct Raster_Vertex {
+    f32 x, y;  // Screen space
+    f32 z;     // Normalized device depth
+    f32 inv_w; // Zero if the vertex lies outside of the guard band
+    f32 u_w, v_w;
+};
+
+struct Bin_Entry {
+    s32 vertices[3];
+    s32 draw;
+};
+
+struct Bin {
+    Bin_Entry *entries;
+    s64 count;
+    s64 capacity;
+};
+
+struct Raster_Triangle {
+    f32 edges[3][4];  // A, B, X, Y of A * (x - X) + B * (y - Y), positive inside
+    f32 origin[2];    // The first vertex, attributes are interpolated relative to it for precision
+    f32 planes[4][3]; // z, 1/w, u/w, v/w as A * (x - origin.x) + B * (y - origin.y) + C
+    s32 top_left[3];  // Whether pixels exactly on the edge belong to this triangle
+    s32 x0, y0, x1, y1; // The pixels whose centers lie in the bounding box, inclusive
+    Software_Texture *texture;
+};
+
+struct Software_Render_Data {
+    b8 instanced; // DRAW_TILES_INSTANCED, until switch_to_tile_meshes
+    Software_Frame_Buffer frame_buffer;
+
+    // Per frame, reused across frames
+    Software_Draw *draws;
+    s64 draw_count, draw_capacity;
+    Raster_Vertex *vertices;
+    s64 vertex_count, vertex_capacity;
+    Bin *bins;
+    s64 bins_x, bins_y;
+
+    // Matches the world shader constants
+    f32 projection_columns[4][4];
+    Map_Mode map_mode;
+    f32 world_scale;
+    f32 morph; // Negative unless switching the map mode
+    Map_Morph *map_morph; // Of the app
+    Software_Index_Buffer *unit_grid_indices;
+    v2f *unit_grid_uvs; // Per map mode
+    s64 unit_grid_count;
+    s64 unit_grid_segments;
+
+    Draw_Command *commands;
+    s64 command_count, command_capacity;
+    s64 batched_instances;
+};
+
+Software_Render_Data software;
+
+template<typename T>
+static
+void reserve(App *app, T **data, s64 *capacity, s64 count, s64 required) {
+    if(required <= *capacity) return;
+
+    s64 new_capacity = max<s64>(max<s64>(*capacity * 2, required), 64);
+    T *new_data = (T *) app->allocator.allocate(new_capacity * sizeof(T));
+
+    if(*data) {
+        memcpy(new_data, *data, count * sizeof(T));
+        app->allocator.deallocate(*data);
+    }
+
+    *data     = new_data;
+    *capacity = new_capacity;
+}
+
+static
+void record_command(App *app, Draw_Command_Kind kind, s64 count = 0) {
+    if(kind == DRAW_COMMAND_Draw || kind == DRAW_COMMAND_Draw_Instanced) PROFILE_COUNT(PROFILE_COUNTER_Draw_Calls, 1);
+
+    reserve(app, &software.commands, &software.command_capacity, software.command_count, software.command_count + 1);
+    software.commands[software.command_count] = Draw_Command{ kind, count };
+    ++software.command_count;
+}
+
+Draw_Command *get_recorded_draw_commands(s64 *count) {
+    *count = software.command_count;
+    return software.commands;
+}
+
+u32 *get_software_frame_buffer(s64 *width, s64 *height, s64 *stride) {
+    *width  = software.frame_buffer.width;
+    *height = software.frame_buffer.height;
+    *stride = software.frame_buffer.stride;
+    return software.frame_buffer.color;
+}
+
+
+
+//
+// Parallel loops over the job system. The calling thread takes part as well, so this
+// also works without any workers.
+//
+
+typedef void(*Parallel_Procedure)(s64 index);
+
+struct Parallel_For {
+    Parallel_Procedure procedure;
+    s64 count;
+    std::atomic<s64> next;
+    std::atomic<s64> finished_helpers;
+};
+
+static Parallel_For parallel_for_data;
+
+static
+void run_parallel_for() {
+    s64 index;
+    while((index = parallel_for_data.next.fetch_add(1, std::memory_order_relaxed)) < parallel_for_data.count) {
+        parallel_for_data.procedure(index);
+    }
+}
+
+static
+void parallel_for_helper(void *user_data, Allocator *scratch) {
+    run_parallel_for();
+    parallel_for_data.finished_helpers.fetch_add(1, std::memory_order_release);
+}
+
+static
+void parallel_for(s64 count, Parallel_Procedure procedure) {
+    parallel_for_data.procedure = procedure;
+    parallel_for_data.count     = count;
+    parallel_for_data.next.store(0, std::memory_order_relaxed);
+    parallel_for_data.finished_helpers.store(0, std::memory_order_relaxed);
+
+    s64 helpers = min(get_job_worker_count(), count - 1);
+    for(s64 i = 0; i < helpers; ++i) submit_job(parallel_for_helper, null);
+
+    run_parallel_for();
+
+    while(parallel_for_data.finished_helpers.load(std::memory_order_acquire) < helpers) {
+        std::this_thread::yield();
+    }
+}
+
+
+
+//
+// Frame buffers
+//
+
+static
+void create_frame_buffer(App *app, Software_Frame_Buffer *frame_buffer, s64 width, s64 height) {
+    s64 padded_width  = (width + SOFTWARE_BIN_SIZE - 1) / SOFTWARE_BIN_SIZE * SOFTWARE_BIN_SIZE;
+    s64 padded_height = (height + SOFTWARE_BIN_SIZE - 1) / SOFTWARE_BIN_SIZE * SOFTWARE_BIN_SIZE;
+
+    frame_buffer->width  = width;
+    frame_buffer->height = height;
+    frame_buffer->stride = padded_width;
+    frame_buffer->color  = (u32 *) app->allocator.allocate(padded_width * padded_height * sizeof(u32));
+    frame_buffer->depth  = (f32 *) app->allocator.allocate(padded_width * padded_height * sizeof(f32));
+}
+
+static
+void destroy_frame_buffer(App *app, Software_Frame_Buffer *frame_buffer) {
+    if(frame_buffer->color) app->allocator.deallocate(frame_buffer->color);
+    if(frame_buffer->depth) app->allocator.deallocate(frame_buffer->depth);
+    *frame_buffer = Software_Frame_Buffer{};
+}
+
+static
+void resize_frame_buffer(App *app, s64 width, s64 height) {
+    if(software.frame_buffer.width == width && software.frame_buffer.height == height) return;
+
+    destroy_frame_buffer(app, &software.frame_buffer);
+    create_frame_buffer(app, &software.frame_buffer, width, height);
+
+    for(s64 i = 0; i < software.bins_x * software.bins_y; ++i) {
+        if(software.bins[i].entries) app->allocator.deallocate(software.bins[i].entries);
+    }
+
+    if(software.bins) app->allocator.deallocate(software.bins);
+
+    software.bins_x = software.frame_buffer.stride / SOFTWARE_BIN_SIZE;
+    software.bins_y = (height + SOFTWARE_BIN_SIZE - 1) / SOFTWARE_BIN_SIZE;
+    software.bins   = (Bin *) app->allocator.allocate(software.bins_x * software.bins_y * sizeof(Bin));
+    memset(software.bins, 0, software.bins_x * software.bins_y * sizeof(Bin));
+}
+
+
+
+void setup_draw_data(App *app) {
+    software = Software_Render_Data{};
+    software.instanced = DRAW_TILES_INSTANCED;
+}
+
+void destroy_draw_data(App *app) {
+    for(s64 i = 0; i < software.bins_x * software.bins_y; ++i) {
+        if(software.bins[i].entries) app->allocator.deallocate(software.bins[i].entries);
+    }
+
+    if(software.bins) app->allocator.deallocate(software.bins);
+    if(software.draws) app->allocator.deallocate(software.draws);
+    if(software.vertices) app->allocator.deallocate(software.vertices);
+    if(software.unit_grid_uvs) app->allocator.deallocate(software.unit_grid_uvs);
+    if(software.commands) app->allocator.deallocate(software.commands);
+
+    destroy_frame_buffer(app, &software.frame_buffer);
+    software = Software_Render_Data{};
+}
+
+void switch_to_tile_meshes(App *app) {
+    // The unit grid's index buffer belongs to the tiles, which drop it on the switch.
+    if(software.unit_grid_uvs) app->allocator.deallocate(software.unit_grid_uvs);
+    software.unit_grid_uvs      = null;
+    software.unit_grid_indices  = null;
+    software.unit_grid_count    = 0;
+    software.unit_grid_segments = 0;
+    software.instanced          = false;
+}
+
+
+
+//
+// Phase 1: Vertex transformation
+//
+
+static inline
+__m128 snap_to_subpixels(__m128 value) {
+    // Snapped positions inside the guard band are exact in f32, and so are the differences
+    // between them and pixel centers, which the edge functions rely on.
+    __m128i steps = _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(SOFTWARE_SUBPIXELS)));
+    return _mm_mul_ps(_mm_cvtepi32_ps(steps), _mm_set1_ps(1.0f / SOFTWARE_SUBPIXELS));
+}
+
+static inline
+void transform_vertices_4(f32 *xs, f32 *ys, f32 *zs, f32 *us, f32 *vs, Raster_Vertex *output, s64 count) {
+    __m128 x = _mm_loadu_ps(xs);
+    __m128 y = _mm_loadu_ps(ys);
+    __m128 z = _mm_loadu_ps(zs);
+
+    __m128 clip[4];
+    for(s64 i = 0; i < 4; ++i) {
+        // Row i of the clip space position, i.e. column[0][i] * x + column[1][i] * y + column[2][i] * z + column[3][i].
+        clip[i] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(software.projection_columns[0][i]), x),
+                                                   _mm_mul_ps(_mm_set1_ps(software.projection_columns[1][i]), y)),
+                                        _mm_mul_ps(_mm_set1_ps(software.projection_columns[2][i]), z)),
+                             _mm_set1_ps(software.projection_columns[3][i]));
+    }
+
+    __m128 w     = clip[3];
+    __m128 guard = _mm_mul_ps(w, _mm_set1_ps(SOFTWARE_GUARD_BAND));
+    __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128 inside = _mm_cmpge_ps(w, _mm_set1_ps(SOFTWARE_NEAR_W));
+    inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_and_ps(clip[0], abs_mask), guard));
+    inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_and_ps(clip[1], abs_mask), guard));
+
+    __m128 inv_w = _mm_div_ps(_mm_set1_ps(1.0f), w);
+    __m128 half  = _mm_set1_ps(0.5f);
+
+    __m128 sx  = snap_to_subpixels(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(clip[0], inv_w), half), half), _mm_set1_ps((f32) software.frame_buffer.width)));
+    __m128 sy  = snap_to_subpixels(_mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(_mm_mul_ps(clip[1], inv_w), half)), _mm_set1_ps((f32) software.frame_buffer.height)));
+    __m128 sz  = _mm_mul_ps(clip[2], inv_w);
+    __m128 u_w = _mm_mul_ps(_mm_loadu_ps(us), inv_w);
+    __m128 v_w = _mm_mul_ps(_mm_loadu_ps(vs), inv_w);
+    inv_w = _mm_and_ps(inv_w, inside);
+
+    alignas(16) f32 out[6][4];
+    _mm_store_ps(out[0], sx);
+    _mm_store_ps(out[1], sy);
+    _mm_store_ps(out[2], sz);
+    _mm_store_ps(out[3], inv_w);
+    _mm_store_ps(out[4], u_w);
+    _mm_store_ps(out[5], v_w);
+
+    for(s64 i = 0; i < count; ++i) {
+        output[i] = Raster_Vertex{ out[0][i], out[1][i], out[2][i], out[3][i], out[4][i], out[5][i] };
+    }
+}
+
+static inline
+v3f morph_position(f32 lat, f32 lon, f32 sin_lat, f32 cos_lat, f32 sin_lon, f32 cos_lon, f32 radius) {
+    Map_Morph *morph = software.map_morph;
+    v3f flat  = morph->origin + (morph->east * (lon - (f32) morph->center.lon) + morph->north * (lat - (f32) morph->center.lat)) * (f32) (WORLD_SCALE_3D * PI / 180.0);
+    v3f globe = v3f(sin_lon * cos_lat * radius, sin_lat * radius, cos_lon * cos_lat * radius);
+    return flat * (1 - software.morph) + globe * software.morph;
+}
+
+static inline
+v3f grid_position(f32 lat, f32 lon, f32 sin_lat, f32 cos_lat, f32 sin_lon, f32 cos_lon) {
+    if(software.morph >= 0) {
+        return morph_position(lat, lon, sin_lat, cos_lat, sin_lon, cos_lon, WORLD_SCALE_3D);
+    } else if(software.map_mode == MAP_MODE_2D) {
+        return v3f(lon / 90.0f * software.world_scale, lat / 90.0f * software.world_scale, 0);
+    } else {
+        return v3f(sin_lon * cos_lat * software.world_scale, sin_lat * software.world_scale, cos_lon * cos_lat * software.world_scale);
+    }
+}
+
+static inline
+v3f mesh_position(v3f position) {
+    // Tile space to world space, like world_mesh.hlsl.
+    f32 lat = position.y, lon = position.x;
+
+    if(software.morph < 0 && software.map_mode == MAP_MODE_2D) {
+        return v3f(lon / 90.0f * software.world_scale, lat / 90.0f * software.world_scale, 0);
+    }
+
+    f32 sigma = lat * (f32) (PI / 180.0);
+    f32 theta = lon * (f32) (PI / 180.0);
+    f32 sin_lat = sinf(sigma), cos_lat = cosf(sigma), sin_lon = sinf(theta), cos_lon = cosf(theta);
+
+    if(software.morph >= 0) {
+        return morph_position(lat, lon, sin_lat, cos_lat, sin_lon, cos_lon, WORLD_SCALE_3D + position.z);
+    }
+
+    f32 radius = software.world_scale + position.z;
+    return v3f(sin_lon * cos_lat * radius, sin_lat * radius, cos_lon * cos_lat * radius);
+}
+
+static
+void get_world_positions(Software_Draw *draw, f32 *xs, f32 *ys, f32 *zs, f32 *us, f32 *vs) {
+    // Fills in all vertices of this draw. Unit grid positions are computed exactly like world.hlsl
+    // does it, but the sines and cosines are only evaluated once per grid row and column.
+    if(draw->mesh) {
+        for(s64 i = 0; i < draw->vertex_count; ++i) {
+            Tile_Vertex vertex = draw->mesh->vertices[i];
+            v3f position = mesh_position(decode_tile_vertex(&draw->mesh->range, vertex));
+            xs[i] = position.x;
+            ys[i] = position.y;
+            zs[i] = position.z;
+            us[i] = vertex.x / TILE_VERTEX_STEPS;
+            vs[i] = vertex.y / TILE_VERTEX_STEPS;
+        }
+
+        return;
+    }
+
+    s64 stride = software.unit_grid_segments + 1;
+    f32 lat0 = (f32) draw->box.lat0, lon0 = (f32) draw->box.lon0, lat1 = (f32) draw->box.lat1, lon1 = (f32) draw->box.lon1;
+
+    f32 row_sin[TILE_MAX_SEGMENTS + 1], row_cos[TILE_MAX_SEGMENTS + 1], rows[TILE_MAX_SEGMENTS + 1];
+    f32 column_sin[TILE_MAX_SEGMENTS + 1], column_cos[TILE_MAX_SEGMENTS + 1], columns[TILE_MAX_SEGMENTS + 1];
+
+    for(s64 i = 0; i < stride; ++i) {
+        v2f uv = software.unit_grid_uvs[i * stride + i];
+        rows[i]    = lat0 * (1 - uv.y) + lat1 * uv.y;
+        columns[i] = lon0 * (1 - uv.x) + lon1 * uv.x;
+
+        f32 sigma = rows[i] * (f32) (PI / 180.0);
+        f32 theta = columns[i] * (f32) (PI / 180.0);
+        row_sin[i]    = sinf(sigma);
+        row_cos[i]    = cosf(sigma);
+        column_sin[i] = sinf(theta);
+        column_cos[i] = cosf(theta);
+    }
+
+    for(s64 i = 0; i < stride; ++i) {
+        for(s64 j = 0; j < stride; ++j) {
+            s64 idx = i * stride + j;
+
+            v3f position = grid_position(rows[i], columns[j], row_sin[i], row_cos[i], column_sin[j], column_cos[j]);
+            xs[idx] = position.x;
+            ys[idx] = position.y;
+            zs[idx] = position.z;
+            us[idx] = software.unit_grid_uvs[idx].x;
+            vs[idx] = software.unit_grid_uvs[idx].y;
+        }
+    }
+}
+
+static
+void transform_draw(s64 index) {
+    Software_Draw *draw = &software.draws[index];
+
+    const s64 MAX_VERTICES = TILE_MAX_VERTICES + 3; // Padded to a multiple of four
+    f32 xs[MAX_VERTICES], ys[MAX_VERTICES], zs[MAX_VERTICES], us[MAX_VERTICES], vs[MAX_VERTICES];
+    assert(draw->vertex_count <= MAX_VERTICES - 3);
+
+    get_world_positions(draw, xs, ys, zs, us, vs);
+
+    for(s64 i = 0; i < draw->vertex_count; i += 4) {
+        transform_vertices_4(&xs[i], &ys[i], &zs[i], &us[i], &vs[i], &software.vertices[draw->first_vertex + i], min<s64>(draw->vertex_count - i, 4));
+    }
+}
+
+
+
+//
+// Phase 2: Clipping and binning
+//
+
+struct Clip_Vertex {
+    f32 x, y, z, w, u, v;
+    s32 index; // Into the raster vertices, or -1 for vertices created by the clipper
+};
+
+static
+Clip_Vertex get_clip_vertex(Software_Draw *draw, s64 local_index) {
+    //
+    // The scalar version of get_world_positions and transform_vertices_4 for the few
+    // vertices that need clipping. This must compute bit-identical clip coordinates, so
+    // that the unclipped vertices of a clipped triangle still line up with their neighbours.
+    //
+    v3f position;
+    v2f uv;
+
+    if(draw->mesh) {
+        Tile_Vertex vertex = draw->mesh->vertices[local_index];
+        position = mesh_position(decode_tile_vertex(&draw->mesh->range, vertex));
+        uv       = v2f(vertex.x / TILE_VERTEX_STEPS, vertex.y / TILE_VERTEX_STEPS);
+    } else {
+        uv = software.unit_grid_uvs[local_index];
+
+        f32 lat = (f32) draw->box.lat0 * (1 - uv.y) + (f32) draw->box.lat1 * uv.y;
+        f32 lon = (f32) draw->box.lon0 * (1 - uv.x) + (f32) draw->box.lon1 * uv.x;
+        f32 sigma = lat * (f32) (PI / 180.0);
+        f32 theta = lon * (f32) (PI / 180.0);
+        position = grid_position(lat, lon, sinf(sigma), cosf(sigma), sinf(theta), cosf(theta));
+    }
+
+    f32 clip[4];
+    for(s64 i = 0; i < 4; ++i) {
+        clip[i] = software.projection_columns[0][i] * position.x + software.projection_columns[1][i] * position.y + software.projection_columns[2][i] * position.z + software.projection_columns[3][i];
+    }
+
+    return Clip_Vertex{ clip[0], clip[1], clip[2], clip[3], uv.x, uv.y, (s32) (draw->first_vertex + local_index) };
+}
+
+static
+f32 clip_distance(Clip_Vertex *vertex, s64 plane) {
+    switch(plane) {
+    case 0: return vertex->w - SOFTWARE_NEAR_W;
+    case 1: return vertex->w * SOFTWARE_GUARD_BAND - vertex->x;
+    case 2: return vertex->w * SOFTWARE_GUARD_BAND + vertex->x;
+    case 3: return vertex->w * SOFTWARE_GUARD_BAND - vertex->y;
+    case 4: return vertex->w * SOFTWARE_GUARD_BAND + vertex->y;
+    }
+
+    return 0;
+}
+
+static
+s32 add_clipped_vertex(App *app, Clip_Vertex *vertex) {
+    if(vertex->index >= 0 && software.vertices[vertex->index].inv_w != 0) return vertex->index;
+
+    f32 inv_w = 1.0f / vertex->w;
+
+    Raster_Vertex result;
+    result.x     = _mm_cvtss_f32(snap_to_subpixels(_mm_set1_ps((vertex->x * inv_w * 0.5f + 0.5f) * (f32) software.frame_buffer.width)));
+    result.y     = _mm_cvtss_f32(snap_to_subpixels(_mm_set1_ps((0.5f - vertex->y * inv_w * 0.5f) * (f32) software.frame_buffer.height)));
+    result.z     = vertex->z * inv_w;
+    result.inv_w = inv_w;
+    result.u_w   = vertex->u * inv_w;
+    result.v_w   = vertex->v * inv_w;
+
+    reserve(app, &software.vertices, &software.vertex_capacity, software.vertex_count, software.vertex_count + 1);
+    software.vertices[software.vertex_count] = result;
+    return (s32) software.vertex_count++;
+}
+
+static
+void bin_triangle(App *app, s32 draw, s32 v0, s32 v1, s32 v2) {
+    Raster_Vertex *a = &software.vertices[v0], *b = &software.vertices[v1], *c = &software.vertices[v2];
+
+    // The pixels whose centers lie in the bounding box.
+    f32 min_x = min(a->x, min(b->x, c->x)), max_x = max(a->x, max(b->x, c->x));
+    f32 min_y = min(a->y, min(b->y, c->y)), max_y = max(a->y, max(b->y, c->y));
+
+    s64 x0 = max<s64>((s64) ceilf(min_x - 0.5f), 0), x1 = min<s64>((s64) floorf(max_x - 0.5f), software.frame_buffer.width - 1);
+    s64 y0 = max<s64>((s64) ceilf(min_y - 0.5f), 0), y1 = min<s64>((s64) floorf(max_y - 0.5f), software.frame_buffer.height - 1);
+    if(x0 > x1 || y0 > y1) return;
+
+    for(s64 by = y0 / SOFTWARE_BIN_SIZE; by <= y1 / SOFTWARE_BIN_SIZE; ++by) {
+        for(s64 bx = x0 / SOFTWARE_BIN_SIZE; bx <= x1 / SOFTWARE_BIN_SIZE; ++bx) {
+            Bin *bin = &software.bins[by * software.bins_x + bx];
+            reserve(app, &bin->entries, &bin->capacity, bin->count, bin->count + 1);
+            bin->entries[bin->count] = Bin_Entry{ { v0, v1, v2 }, draw };
+            ++bin->count;
+        }
+    }
+}
+
+static
+void clip_and_bin_triangle(App *app, s32 draw_index, s64 i0, s64 i1, s64 i2) {
+    Software_Draw *draw = &software.draws[draw_index];
+
+    Clip_Vertex polygon[8], next[8];
+    s64 count = 3;
+    polygon[0] = get_clip_vertex(draw, i0);
+    polygon[1] = get_clip_vertex(draw, i1);
+    polygon[2] = get_clip_vertex(draw, i2);
+
+    for(s64 plane = 0; plane < 5 && count > 0; ++plane) {
+        s64 next_count = 0;
+
+        for(s64 i = 0; i < count; ++i) {
+            Clip_Vertex *from = &polygon[i], *to = &polygon[(i + 1) % count];
+            f32 d0 = clip_distance(from, plane), d1 = clip_distance(to, plane);
+
+            if(d0 >= 0) next[next_count++] = *from;
+
+            if((d0 >= 0) != (d1 >= 0)) {
+                f32 t = d0 / (d0 - d1);
+                next[next_count++] = Clip_Vertex{ from->x + (to->x - from->x) * t, from->y + (to->y - from->y) * t, from->z + (to->z - from->z) * t,
+                                                  from->w + (to->w - from->w) * t, from->u + (to->u - from->u) * t, from->v + (to->v - from->v) * t, -1 };
+            }
+        }
+
+        memcpy(polygon, next, next_count * sizeof(Clip_Vertex));
+        count = next_count;
+    }
+
+    if(count < 3) return;
+
+    s32 first = add_clipped_vertex(app, &polygon[0]);
+    s32 previous = add_clipped_vertex(app, &polygon[1]);
+
+    for(s64 i = 2; i < count; ++i) {
+        s32 current = add_clipped_vertex(app, &polygon[i]);
+        bin_triangle(app, draw_index, first, previous, current);
+        previous = current;
+    }
+}
+
+static
+void bin_draws(App *app) {
+    for(s64 i = 0; i < software.bins_x * software.bins_y; ++i) software.bins[i].count = 0;
+
+    for(s64 i = 0; i < software.draw_count; ++i) {
+        Software_Draw *draw = &software.draws[i];
+
+        s64 triangles = draw->indices ? draw->indices->count / 3 : draw->vertex_count / 3;
+
+        for(s64 j = 0; j < triangles; ++j) {
+            s64 i0 = draw->indices ? draw->indices->indices[j * 3 + 0] : j * 3 + 0;
+            s64 i1 = draw->indices ? draw->indices->indices[j * 3 + 1] : j * 3 + 1;
+            s64 i2 = draw->indices ? draw->indices->indices[j * 3 + 2] : j * 3 + 2;
+
+            s32 v0 = (s32) (draw->first_vertex + i0), v1 = (s32) (draw->first_vertex + i1), v2 = (s32) (draw->first_vertex + i2);
+
+            if(software.vertices[v0].inv_w != 0 && software.vertices[v1].inv_w != 0 && software.vertices[v2].inv_w != 0) {
+                bin_triangle(app, (s32) i, v0, v1, v2);
+            } else {
+                clip_and_bin_triangle(app, (s32) i, i0, i1, i2);
+            }
+        }
+    }
+}
+
+
+
+//
+// Phase 3: Triangle setup and rasterization
+//
+
+static
+s64 setup_triangles_4(Bin_Entry *entries, s64 count, Raster_Triangle *output) {
+    //
+    // Sets up four triangles at once, lane i holds entries[i]. Triangles are made
+    // counter-clockwise in screen space, so that all edge functions are positive
+    // inside, and every attribute becomes a plane over the screen.
+    //
+    alignas(16) f32 xs[3][4], ys[3][4], attributes[4][3][4];
+
+    for(s64 i = 0; i < 4; ++i) {
+        Bin_Entry *entry = &entries[min<s64>(i, count - 1)];
+
+        for(s64 j = 0; j < 3; ++j) {
+            Raster_Vertex *vertex = &software.vertices[entry->vertices[j]];
+            xs[j][i] = vertex->x;
+            ys[j][i] = vertex->y;
+            attributes[0][j][i] = vertex->z;
+            attributes[1][j][i] = vertex->inv_w;
+            attributes[2][j][i] = vertex->u_w;
+            attributes[3][j][i] = vertex->v_w;
+        }
+    }
+
+    __m128 x[3] = { _mm_load_ps(xs[0]), _mm_load_ps(xs[1]), _mm_load_ps(xs[2]) };
+    __m128 y[3] = { _mm_load_ps(ys[0]), _mm_load_ps(ys[1]), _mm_load_ps(ys[2]) };
+
+    //
+    // The edge functions are evaluated relative to one of the edge's end points instead of
+    // through a constant term, which would cancel catastrophically far from the origin. The
+    // end point is picked by position and not by winding, so that the two triangles sharing
+    // an edge compute exactly negated values and never overlap or leave gaps.
+    //
+    __m128 a[3], b[3], edge_x[3], edge_y[3];
+    for(s64 i = 0; i < 3; ++i) {
+        // The edge opposite of vertex i.
+        s64 from = (i + 1) % 3, to = (i + 2) % 3;
+        a[i] = _mm_sub_ps(y[from], y[to]);
+        b[i] = _mm_sub_ps(x[to], x[from]);
+
+        __m128 from_first = _mm_or_ps(_mm_cmplt_ps(y[from], y[to]), _mm_and_ps(_mm_cmpeq_ps(y[from], y[to]), _mm_cmplt_ps(x[from], x[to])));
+        edge_x[i] = _mm_or_ps(_mm_and_ps(from_first, x[from]), _mm_andnot_ps(from_first, x[to]));
+        edge_y[i] = _mm_or_ps(_mm_and_ps(from_first, y[from]), _mm_andnot_ps(from_first, y[to]));
+    }
+
+    // Twice the signed area. Computing it from the edge vectors avoids the cancellation in c.
+    __m128 dx1 = _mm_sub_ps(x[1], x[0]), dy1 = _mm_sub_ps(y[1], y[0]);
+    __m128 dx2 = _mm_sub_ps(x[2], x[0]), dy2 = _mm_sub_ps(y[2], y[0]);
+    __m128 area = _mm_sub_ps(_mm_mul_ps(dx1, dy2), _mm_mul_ps(dx2, dy1));
+    __m128 inv_determinant = _mm_div_ps(_mm_set1_ps(1.0f), area);
+
+    // Flip clockwise triangles by negating their edge functions.
+    __m128 sign = _mm_and_ps(_mm_cmplt_ps(area, _mm_setzero_ps()), _mm_castsi128_ps(_mm_set1_epi32(0x80000000)));
+    area = _mm_xor_ps(area, sign);
+
+    for(s64 i = 0; i < 3; ++i) {
+        a[i] = _mm_xor_ps(a[i], sign);
+        b[i] = _mm_xor_ps(b[i], sign);
+    }
+
+    s32 valid = _mm_movemask_ps(_mm_cmpgt_ps(area, _mm_setzero_ps()));
+
+    alignas(16) f32 edges[3][4][4], planes[4][3][4];
+    alignas(16) s32 top_left[3][4];
+
+    for(s64 i = 0; i < 3; ++i) {
+        _mm_store_ps(edges[i][0], a[i]);
+        _mm_store_ps(edges[i][1], b[i]);
+        _mm_store_ps(edges[i][2], edge_x[i]);
+        _mm_store_ps(edges[i][3], edge_y[i]);
+
+        // Pixels on an edge shared by two triangles belong to exactly one of them.
+        __m128 is_top_left = _mm_or_ps(_mm_cmpgt_ps(a[i], _mm_setzero_ps()), _mm_and_ps(_mm_cmpeq_ps(a[i], _mm_setzero_ps()), _mm_cmpgt_ps(b[i], _mm_setzero_ps())));
+        _mm_store_si128((__m128i *) top_left[i], _mm_castps_si128(is_top_left));
+    }
+
+    for(s64 k = 0; k < 4; ++k) {
+        __m128 f0  = _mm_load_ps(attributes[k][0]);
+        __m128 df1 = _mm_sub_ps(_mm_load_ps(attributes[k][1]), f0);
+        __m128 df2 = _mm_sub_ps(_mm_load_ps(attributes[k][2]), f0);
+        _mm_store_ps(planes[k][0], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(df1, dy2), _mm_mul_ps(df2, dy1)), inv_determinant));
+        _mm_store_ps(planes[k][1], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(df2, dx1), _mm_mul_ps(df1, dx2)), inv_determinant));
+        _mm_store_ps(planes[k][2], f0);
+    }
+
+    alignas(16) f32 min_x[4], min_y[4], max_x[4], max_y[4];
+    _mm_store_ps(min_x, _mm_min_ps(x[0], _mm_min_ps(x[1], x[2])));
+    _mm_store_ps(min_y, _mm_min_ps(y[0], _mm_min_ps(y[1], y[2])));
+    _mm_store_ps(max_x, _mm_max_ps(x[0], _mm_max_ps(x[1], x[2])));
+    _mm_store_ps(max_y, _mm_max_ps(y[0], _mm_max_ps(y[1], y[2])));
+
+    s64 output_count = 0;
+
+    for(s64 i = 0; i < count; ++i) {
+        if(!(valid & (1 << i))) continue; // Degenerate
+
+        Raster_Triangle *triangle = &output[output_count++];
+        for(s64 j = 0; j < 3; ++j) {
+            for(s64 k = 0; k < 4; ++k) triangle->edges[j][k] = edges[j][k][i];
+            triangle->top_left[j] = top_left[j][i];
+        }
+
+        for(s64 j = 0; j < 4; ++j) {
+            for(s64 k = 0; k < 3; ++k) triangle->planes[j][k] = planes[j][k][i];
+        }
+
+        triangle->origin[0] = xs[0][i];
+        triangle->origin[1] = ys[0][i];
+        triangle->x0 = (s32) ceilf(min_x[i] - 0.5f);
+        triangle->y0 = (s32) ceilf(min_y[i] - 0.5f);
+        triangle->x1 = (s32) floorf(max_x[i] - 0.5f);
+        triangle->y1 = (s32) floorf(max_y[i] - 0.5f);
+
+        triangle->texture = software.draws[entries[i].draw].texture;
+    }
+
+    return output_count;
+}
+
+static inline
+__m128 evaluate_plane(const f32 *plane, __m128 px, __m128 py) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), px), _mm_mul_ps(_mm_set1_ps(plane[1]), py)), _mm_set1_ps(plane[2]));
+}
+
+static
+void rasterize_triangle(Raster_Triangle *triangle, s64 bin_x0, s64 bin_y0, s64 bin_x1, s64 bin_y1) {
+    Software_Frame_Buffer *fbo = &software.frame_buffer;
+    Software_Texture *texture  = triangle->texture;
+
+    //
+    // Shrink the bin to the bounding box of the triangle, keeping the columns aligned to
+    // four pixels. The edge functions are evaluated directly at every pixel center instead
+    // of stepped, so that they stay exact negations across shared edges.
+    //
+    s64 x0 = max<s64>(bin_x0, triangle->x0 & ~3), x1 = min<s64>(bin_x1, triangle->x1 + 1);
+    s64 y0 = max<s64>(bin_y0, triangle->y0), y1 = min<s64>(bin_y1, triangle->y1 + 1);
+
+    f32 (*planes)[3] = triangle->planes;
+    __m128 texture_max_u = _mm_set1_ps((f32) (texture->width - 1));
+    __m128 texture_max_v = _mm_set1_ps((f32) (texture->height - 1));
+    __m128 texture_w = _mm_set1_ps((f32) texture->width);
+    __m128 texture_h = _mm_set1_ps((f32) texture->height);
+
+    __m128i top_left[3];
+    for(s64 i = 0; i < 3; ++i) top_left[i] = _mm_set1_epi32(triangle->top_left[i]);
+
+    __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+    for(s64 y = y0; y < y1; ++y) {
+        __m128 py = _mm_set1_ps((f32) y + 0.5f);
+        __m128 dy = _mm_sub_ps(py, _mm_set1_ps(triangle->origin[1]));
+
+        for(s64 x = x0; x < x1; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((f32) x), lane_offsets);
+            __m128 dx = _mm_sub_ps(px, _mm_set1_ps(triangle->origin[0]));
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for(s64 i = 0; i < 3; ++i) {
+                f32 *edge = triangle->edges[i];
+                __m128 e  = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge[0]), _mm_sub_ps(px, _mm_set1_ps(edge[2]))), _mm_mul_ps(_mm_set1_ps(edge[1]), _mm_sub_ps(py, _mm_set1_ps(edge[3]))));
+                __m128 on_edge = _mm_and_ps(_mm_cmpeq_ps(e, _mm_setzero_ps()), _mm_castsi128_ps(top_left[i]));
+                inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(e, _mm_setzero_ps()), on_edge));
+            }
+
+            if(!_mm_movemask_ps(inside)) continue;
+
+            f32 *depth_pointer = &fbo->depth[y * fbo->stride + x];
+            __m128 depth = _mm_loadu_ps(depth_pointer);
+            __m128 z     = evaluate_plane(planes[0], dx, dy);
+            inside = _mm_and_ps(inside, _mm_cmplt_ps(z, depth));
+
+            s32 mask = _mm_movemask_ps(inside);
+            if(!mask) continue;
+
+            // Perspective correct texture coordinates, then nearest sampling with clamping to the edge.
+            __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), evaluate_plane(planes[1], dx, dy));
+            __m128 u = _mm_mul_ps(evaluate_plane(planes[2], dx, dy), w);
+            __m128 v = _mm_mul_ps(evaluate_plane(planes[3], dx, dy), w);
+
+            __m128i tx = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(u, texture_w), _mm_setzero_ps()), texture_max_u));
+            __m128i ty = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(v, texture_h), _mm_setzero_ps()), texture_max_v));
+
+            alignas(16) s32 txs[4], tys[4];
+            _mm_store_si128((__m128i *) txs, tx);
+            _mm_store_si128((__m128i *) tys, ty);
+
+            __m128i texels = _mm_set_epi32((s32) texture->pixels[tys[3] * texture->width + txs[3]], (s32) texture->pixels[tys[2] * texture->width + txs[2]],
+                                           (s32) texture->pixels[tys[1] * texture->width + txs[1]], (s32) texture->pixels[tys[0] * texture->width + txs[0]]);
+
+            u32 *color_pointer = &fbo->color[y * fbo->stride + x];
+            __m128i color = _mm_loadu_si128((__m128i *) color_pointer);
+            __m128i mask_i = _mm_castps_si128(inside);
+
+            _mm_storeu_si128((__m128i *) color_pointer, _mm_or_si128(_mm_and_si128(mask_i, texels), _mm_andnot_si128(mask_i, color)));
+            _mm_storeu_ps(depth_pointer, _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, depth)));
+        }
+    }
+}
+
+static
+void rasterize_bin(s64 index) {
+    Software_Frame_Buffer *fbo = &software.frame_buffer;
+    Bin *bin = &software.bins[index];
+
+    s64 x0 = (index % software.bins_x) * SOFTWARE_BIN_SIZE, y0 = (index / software.bins_x) * SOFTWARE_BIN_SIZE;
+    s64 x1 = x0 + SOFTWARE_BIN_SIZE, y1 = min<s64>(y0 + SOFTWARE_BIN_SIZE, fbo->height);
+
+    for(s64 y = y0; y < y1; ++y) {
+        for(s64 x = x0; x < x1; ++x) {
+            fbo->color[y * fbo->stride + x] = SOFTWARE_CLEAR_COLOR;
+            fbo->depth[y * fbo->stride + x] = 1.0f;
+        }
+    }
+
+    Raster_Triangle triangles[4];
+
+    for(s64 i = 0; i < bin->count; i += 4) {
+        s64 count = setup_triangles_4(&bin->entries[i], min<s64>(bin->count - i, 4), triangles);
+
+        for(s64 j = 0; j < count; ++j) {
+            rasterize_triangle(&triangles[j], x0, y0, x1, y1);
+        }
+    }
+}
+
+
+
+//
+// The world pass
+//
+
+static
+void add_draw(App *app, Tile *tile) {
+    reserve(app, &software.draws, &software.draw_capacity, software.draw_count, software.draw_count + 1);
+
+    Software_Draw *draw = &software.draws[software.draw_count];
+    draw->texture      = (Software_Texture *) tile->texture;
+    draw->box          = tile->box;
+    draw->first_vertex = software.vertex_count;
+
+    if(software.instanced) {
+        draw->mesh         = null;
+        draw->indices      = software.unit_grid_indices;
+        draw->vertex_count = software.unit_grid_count;
+    } else {
+        draw->mesh         = (Software_Mesh *) tile->mesh;
+        draw->indices      = draw->mesh->indices;
+        draw->vertex_count = draw->mesh->vertex_count;
+    }
+
+    software.vertex_count += draw->vertex_count;
+    ++software.draw_count;
+}
+
+static
+void draw_tiles(App *app, Tile *tile, Cull_Result parent_cull) {
+    Cull_Result cull = cull_drawn_tile(app, tile, parent_cull);
+    if(cull == CULL_Outside) {
+        ++app->cull_stats.tiles_culled;
+        return;
+    }
+
+    if(tile->leaf || tile->texture) {
+        // Non-leaf tiles only have a texture while their children are still pending.
+        if(!tile_has_geometry(tile)) return;
+
+        add_draw(app, tile);
+
+        if(software.instanced) {
+            ++software.batched_instances;
+            if(software.batched_instances == TILE_INSTANCE_BATCH_SIZE) {
+                record_command(app, DRAW_COMMAND_Draw_Instanced, software.batched_instances);
+                software.batched_instances = 0;
+            }
+        } else {
+            record_command(app, DRAW_COMMAND_Bind_Texture);
+            record_command(app, DRAW_COMMAND_Bind_Mesh);
+            record_command(app, DRAW_COMMAND_Draw);
+        }
+
+        ++app->cull_stats.tiles_drawn;
+    } else {
+        for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+            draw_tiles(app, tile->children[i], cull);
+        }
+    }
+}
+
+static
+void prepare_unit_grid(App *app) {
+    // The coarsest level needs the most segments to follow the globe, and so does the
+    // flat map while it is bent onto the globe.
+    Map_Mode map_mode = app->morph.remaining > 0 ? MAP_MODE_3D : app->map_mode;
+    s64 segments = get_tile_segments(map_mode, 0, null);
+    if(software.unit_grid_uvs && software.unit_grid_segments == segments) return;
+
+    s64 stride = segments + 1;
+
+    if(software.unit_grid_uvs) app->allocator.deallocate(software.unit_grid_uvs);
+    software.unit_grid_uvs      = (v2f *) app->allocator.allocate(stride * stride * sizeof(v2f));
+    software.unit_grid_count    = stride * stride;
+    software.unit_grid_segments = segments;
+    software.unit_grid_indices  = (Software_Index_Buffer *) get_tile_index_buffer(app, segments);
+
+    for(s64 i = 0; i < stride; ++i) {
+        for(s64 j = 0; j < stride; ++j) {
+            software.unit_grid_uvs[i * stride + j] = v2f((f32) j / (f32) segments, (f32) i / (f32) segments);
+        }
+    }
+}
+
+b8 draw_requires_tile_meshes() {
+    return !software.instanced;
+}
+
+void draw_one_frame(App *app) {
+    PROFILE_ZONE("Draw");
+
+    s64 width  = app->camera.viewport_width  > 0 ? app->camera.viewport_width  : SOFTWARE_DEFAULT_WIDTH;
+    s64 height = app->camera.viewport_height > 0 ? app->camera.viewport_height : SOFTWARE_DEFAULT_HEIGHT;
+    resize_frame_buffer(app, width, height);
+
+    software.command_count = 0;
+
+    //
+    // Redraw all required tiles
+    //
+    paint_invalidated_tiles(app);
+
+    //
+    // Collect all visible tiles
+    //
+    Map_Morph *morph    = &app->morph;
+    m4f projection_view = morph->remaining > 0 ? morph->projection_view : app->camera.projection_view;
+
+    for(s64 i = 0; i < 4; ++i) {
+        v4f column = projection_view * v4f(i == 0, i == 1, i == 2, i == 3);
+        for(s64 j = 0; j < 4; ++j) software.projection_columns[i][j] = column.values[j];
+    }
+
+    software.map_mode    = app->map_mode;
+    software.world_scale = (app->map_mode == MAP_MODE_2D) ? WORLD_SCALE_2D : WORLD_SCALE_3D;
+    software.morph       = morph->remaining > 0 ? morph->globe : -1;
+    software.map_morph   = morph;
+    if(software.instanced) prepare_unit_grid(app);
+
+    software.batched_instances = 0;
+    software.draw_count        = 0;
+    software.vertex_count      = 0;
+    if(software.instanced) record_command(app, DRAW_COMMAND_Bind_Mesh); // The unit grid
+
+    app->cull_stats = Cull_Stats{};
+    draw_tiles(app, &app->root, CULL_Intersecting);
+
+    if(software.instanced && software.batched_instances) {
+        record_command(app, DRAW_COMMAND_Draw_Instanced, software.batched_instances);
+    }
+
+    PROFILE_COUNT(PROFILE_COUNTER_Tiles_Drawn, app->cull_stats.tiles_drawn);
+
+    //
+    // Render them
+    //
+    PROFILE_ZONE("Rasterize");
+    reserve(app, &software.vertices, &software.vertex_capacity, 0, software.vertex_count + 3); // Room for the padding of the last draw
+    parallel_for(software.draw_count, transform_draw);
+    bin_draws(app);
+    parallel_for(software.bins_x * software.bins_y, rasterize_bin);
+}
+
+
+
+G_Handle create_texture(App *app, u8 *pixels, s64 width, s64 height, s64 channels) {
+    Software_Texture *texture = app->allocator.New<Software_Texture>();
+    texture->width  = width;
+    texture->height = height;
+    texture->pixels = (u32 *) app->allocator.allocate(width * height * sizeof(u32));
+
+    for(s64 i = 0; i < width * height; ++i) {
+        u8 rgba[4] = { 0, 0, 0, 255 };
+        if(pixels) {
+            for(s64 j = 0; j < channels; ++j) rgba[j] = pixels[i * channels + j];
+        }
+
+        texture->pixels[i] = rgba[0] | (rgba[1] << 8) | (rgba[2] << 16) | ((u32) rgba[3] << 24);
+    }
+
+    return texture;
+}
+
+G_Handle create_empty_texture(App *app, s64 width, s64 height, s64 channels) {
+    return create_texture(app, null, width, height, channels);
+}
+
+void destroy_texture(App *app, G_Handle handle) {
+    Software_Texture *texture = (Software_Texture *) handle;
+    app->allocator.deallocate(texture->pixels);
+    app->allocator.deallocate(texture);
+}
+
+G_Handle create_tile_texture(App *app, s64 width, s64 height, s64 channels) {
+    // There is no binding limit to work around, so tile textures are just textures.
+    return create_empty_texture(app, width, height, channels);
+}
+
+void destroy_tile_texture(App *app, G_Handle handle) {
+    destroy_texture(app, handle);
+}
+
+s64 get_tile_texture_page_bytes() {
+    return 0; // The tile textures are just textures, see create_tile_texture
+}
+
+void compact_tile_texture_pages(App *app) {
+    // Nothing to release, see get_tile_texture_page_bytes.
+}
+
+void update_tile_textures(App *app, G_Handle *textures, u32 **pixels, s64 count) {
+    for(s64 i = 0; i < count; ++i) {
+        Software_Texture *texture = (Software_Texture *) textures[i];
+        memcpy(texture->pixels, pixels[i], PAINT_TILE_PIXELS * sizeof(u32));
+    }
+
+    record_command(app, DRAW_COMMAND_Update_Textures, count);
+}
+
+G_Handle create_index_buffer(App *app, u16 *indices, s64 count) {
+    Software_Index_Buffer *buffer = app->allocator.New<Software_Index_Buffer>();
+    buffer->indices = (u16 *) app->allocator.allocate(count * sizeof(u16));
+    buffer->count   = count;
+    memcpy(buffer->indices, indices, count * sizeof(u16));
+    return buffer;
+}
+
+void destroy_index_buffer(App *app, G_Handle handle) {
+    Software_Index_Buffer *buffer = (Software_Index_Buffer *) handle;
+    app->allocator.deallocate(buffer->indices);
+    app->allocator.deallocate(buffer);
+}
+
+G_Handle create_mesh(App *app, Tile_Vertex *vertices, s64 vertex_count, Tile_Vertex_Range *range, G_Handle index_buffer) {
+    Software_Mesh *mesh = app->allocator.New<Software_Mesh>();
+    mesh->vertices     = (Tile_Vertex *) app->allocator.allocate(vertex_count * sizeof(Tile_Vertex));
+    mesh->vertex_count = vertex_count;
+    mesh->indices      = (Software_Index_Buffer *) index_buffer;
+    update_mesh(app, mesh, vertices, vertex_count, range);
+    return mesh;
+}
+
+void update_mesh(App *app, G_Handle handle, Tile_Vertex *vertices, s64 vertex_count, Tile_Vertex_Range *range) {
+    Software_Mesh *mesh = (Software_Mesh *) handle;
+    assert(mesh->vertex_count == vertex_count);
+    memcpy(mesh->vertices, vertices, vertex_count * sizeof(Tile_Vertex));
+    mesh->range = *range;
+}
+
+void destroy_mesh(App *app, G_Handle handle) {
+    Software_Mesh *mesh = (Software_Mesh *) handle;
+    app->allocator.deallocate(mesh->vertices);
+    app->allocator.deallocate(mesh);
+}
@@ -0,0 +1,187 @@
+// --- C++
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// --- Foundation
+#include <foundation.h>
+#include <memutils.h>
+
+// --- App
+#include "jobs.h"
+
+struct Job {
+    Job_Procedure procedure;
+    void *user_data;
+};
+
+struct Job_Queue {
+    std::mutex mutex;
+    Job jobs[JOB_QUEUE_CAPACITY]; // Ring buffer
+    s64 first, count;
+};
+
+struct Job_Worker {
+    std::thread thread;
+    s64 index;
+    Job_Queue queues[JOB_PRIORITY_COUNT];
+
+    Memory_Pool scratch_pool;
+    Allocator scratch;
+};
+
+struct Job_System {
+    Job_Worker *workers;
+    s64 worker_count;
+    s64 next_worker; // Round robin for submissions
+
+    std::atomic<s64> queued_jobs;
+    std::atomic<b8> shutting_down;
+    std::mutex sleep_mutex;
+    std::condition_variable wake_up;
+};
+
+static Job_System job_system;
+
+static
+b8 push_back(Job_Queue *queue, Job job) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if(queue->count == JOB_QUEUE_CAPACITY) return false;
+
+    queue->jobs[(queue->first + queue->count) % JOB_QUEUE_CAPACITY] = job;
+    ++queue->count;
+    return true;
+}
+
+static
+b8 pop_back(Job_Queue *queue, Job *job) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if(queue->count == 0) return false;
+
+    --queue->count;
+    *job = queue->jobs[(queue->first + queue->count) % JOB_QUEUE_CAPACITY];
+    return true;
+}
+
+static
+b8 steal_front(Job_Queue *queue, Job *job) {
+    // Don't wait for a busy queue, just try the next victim.
+    std::unique_lock<std::mutex> lock(queue->mutex, std::try_to_lock);
+    if(!lock.owns_lock() || queue->count == 0) return false;
+
+    *job = queue->jobs[queue->first];
+    queue->first = (queue->first + 1) % JOB_QUEUE_CAPACITY;
+    --queue->count;
+    return true;
+}
+
+static
+b8 find_job(Job_Worker *worker, Job *job) {
+    for(s64 priority = 0; priority < JOB_PRIORITY_COUNT; ++priority) {
+        if(pop_back(&worker->queues[priority], job)) return true;
+
+        for(s64 i = 1; i < job_system.worker_count; ++i) {
+            Job_Worker *victim = &job_system.workers[(worker->index + i) % job_system.worker_count];
+            if(steal_front(&victim->queues[priority], job)) return true;
+        }
+    }
+
+    return false;
+}
+
+static
+void run_job(Job *job, Allocator *scratch) {
+    job->procedure(job->user_data, scratch);
+}
+
+static
+void worker_entry_point(Job_Worker *worker) {
+    while(true) {
+        Job job;
+        if(find_job(worker, &job)) {
+            --job_system.queued_jobs;
+            run_job(&job, &worker->scratch);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(job_system.sleep_mutex);
+        job_system.wake_up.wait(lock, [] { return job_system.queued_jobs.load() > 0 || job_system.shutting_down.load(); });
+        if(job_system.shutting_down && job_system.queued_jobs == 0) break;
+    }
+}
+
+void create_job_system(s64 worker_count) {
+    if(worker_count <= 0) worker_count = max((s64) std::thread::hardware_concurrency() - 1, (s64) 1);
+
+    job_system.workers       = new Job_Worker[worker_count];
+    job_system.worker_count  = worker_count;
+    job_system.next_worker   = 0;
+    job_system.queued_jobs   = 0;
+    job_system.shutting_down = false;
+
+    for(s64 i = 0; i < worker_count; ++i) {
+        Job_Worker *worker = &job_system.workers[i];
+        worker->index = i;
+
+        for(s64 j = 0; j < JOB_PRIORITY_COUNT; ++j) {
+            worker->queues[j].first = 0;
+            worker->queues[j].count = 0;
+        }
+
+        worker->scratch_pool.create(JOB_SCRATCH_SIZE);
+        worker->scratch = worker->scratch_pool.allocator();
+    }
+
+    // Only start the threads once every queue is set up, since workers steal from each other.
+    for(s64 i = 0; i < worker_count; ++i) {
+        job_system.workers[i].thread = std::thread(worker_entry_point, &job_system.workers[i]);
+    }
+}
+
+void destroy_job_system() {
+    {
+        std::lock_guard<std::mutex> lock(job_system.sleep_mutex);
+        job_system.shutting_down = true;
+    }
+    job_system.wake_up.notify_all();
+
+    for(s64 i = 0; i < job_system.worker_count; ++i) {
+        job_system.workers[i].thread.join();
+        job_system.workers[i].scratch_pool.destroy();
+    }
+
+    delete[] job_system.workers;
+    job_system.workers      = null;
+    job_system.worker_count = 0;
+}
+
+void submit_job(Job_Procedure procedure, void *user_data, Job_Priority priority) {
+    Job job = { procedure, user_data };
+
+    Job_Worker *worker = &job_system.workers[job_system.next_worker];
+    job_system.next_worker = (job_system.next_worker + 1) % job_system.worker_count;
+
+    // Count the job before it becomes visible, so that a worker which immediately grabs
+    // it never sees a negative count.
+    {
+        std::lock_guard<std::mutex> lock(job_system.sleep_mutex);
+        ++job_system.queued_jobs;
+    }
+
+    if(!push_back(&worker->queues[priority], job)) {
+        // All queues are saturated, so just do the work on the calling thread.
+        --job_system.queued_jobs;
+
+        s64 temp_mark = mark_temp_allocator();
+        run_job(&job, &temp);
+        release_temp_allocator(temp_mark);
+        return;
+    }
+
+    job_system.wake_up.notify_one();
+}
+
+s64 get_job_worker_count() {
+    return job_system.worker_count;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <foundation.h>
+
+//
+// A small work-stealing job system. Every worker owns a queue: it pops its own jobs
+// from the back (newest first, which keeps its caches warm) and steals from the front
+// of the other queues once its own ran dry. Every worker also owns a scratch allocator,
+// which job procedures may use for temporary data without synchronization. Procedures
+// must deallocate their scratch memory before they return.
+// Jobs come in two priorities, with a queue per worker for each: Workers only look at
+// the low priority queues (their own and everyone else's) once no high priority job is
+// left anywhere, so speculative work never delays work the current frame waits for.
+//
+
+#define JOB_QUEUE_CAPACITY 4096
+#define JOB_SCRATCH_SIZE   (4 * ONE_MEGABYTE)
+
+typedef void(*Job_Procedure)(void *user_data, Allocator *scratch);
+
+enum Job_Priority {
+    JOB_PRIORITY_High,
+    JOB_PRIORITY_Low, // E.g. prefetching for views the camera hasn't reached yet
+    JOB_PRIORITY_COUNT,
+};
+
+void create_job_system(s64 worker_count); // Pass 0 to use one worker per hardware thread but one
+void destroy_job_system();
+void submit_job(Job_Procedure procedure, void *user_data, Job_Priority priority = JOB_PRIORITY_High);
+s64 get_job_worker_count();
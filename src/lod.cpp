@@ -0,0 +1,91 @@
+// --- Foundation
+#include <foundation.h>
+#include <math/maths.h>
+#include <math/v3.h>
+
+// --- App
+#include "app.h"
+#include "tile.h"
+#include "lod.h"
+
+f64 get_tile_screen_space_error(Camera *camera, Map_Mode map_mode, Tile *tile) {
+    //
+    // The visible detail of a tile is bounded by its texture, so the geometric error
+    // is the world space size of one texel. Project that onto the screen to get the
+    // number of pixels a single texel covers.
+    //
+    Tile_Bounds *bounds = &tile->bounds[map_mode];
+    f64 texel_size = (2.0 * bounds->radius) / TILE_TEXTURE_RESOLUTION;
+    f64 viewport_height = (f64) camera->viewport_height;
+
+    switch(map_mode) {
+    case MAP_MODE_2D: {
+        // The orthographic projection maps 2 * current_distance onto the viewport height.
+        return texel_size * viewport_height / (2.0 * camera->current_distance);
+    }
+
+    case MAP_MODE_3D: {
+        f64 distance = v3_length(camera->position - bounds->center) - bounds->radius;
+        distance = max(distance, (f64) camera->near);
+
+        f64 pixels_per_unit = viewport_height / (2.0 * tan(degrees_to_radians(camera->fov) * 0.5));
+        return texel_size * pixels_per_unit / distance;
+    }
+    }
+
+    return 0;
+}
+
+static
+void update_tile_lod(App *app, Tile *tile, Cull_Result parent_cull, Lod_Stats *stats) {
+    //
+    // Tiles outside of the view don't need any detail, but they are neither split nor
+    // merged here: Their subtrees stay resident as a cache for when the view comes back,
+    // until the residency manager evicts them.
+    //
+    Cull_Result cull = cull_tile(&app->camera, app->map_mode, tile, parent_cull);
+    if(cull == CULL_Outside) return;
+
+    Residency *residency = &app->residency;
+    b8 returned = tile->last_visible_frame < residency->frame_index - 1; // Out of view in the last frame, but still here
+    tile->last_visible_frame = residency->frame_index;
+
+    f64 error = get_tile_screen_space_error(&app->camera, app->map_mode, tile);
+
+    if(tile->leaf) {
+        // Only leaves are drawn, the inner tiles above them would count every return again.
+        if(returned) ++residency->stats.hits;
+
+        if(tile->level < LOD_MAX_LEVEL && stats->splits < LOD_MAX_SPLITS_PER_FRAME && error > LOD_SPLIT_THRESHOLD) {
+            subdivide_tile(app, tile);
+            ++stats->splits;
+            stats->leaves += ARRAY_COUNT(tile->children);
+            residency->stats.misses += ARRAY_COUNT(tile->children);
+        } else {
+            ++stats->leaves;
+        }
+
+        return;
+    }
+
+    // Prefetching runs after this, so its expectations are from the last frame.
+    b8 predicted = tile->last_predicted_frame >= residency->frame_index - 1;
+
+    if(error < LOD_MERGE_THRESHOLD && !predicted) {
+        merge_tile(app, tile);
+        ++stats->merges;
+        ++stats->leaves;
+        return;
+    }
+
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+        update_tile_lod(app, tile->children[i], cull, stats);
+    }
+}
+
+void update_tile_lod(App *app) {
+    if(app->camera.viewport_height <= 0) return;
+
+    app->lod_stats = Lod_Stats{};
+    update_tile_lod(app, &app->root, CULL_Intersecting, &app->lod_stats);
+}
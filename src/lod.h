@@ -0,0 +1,31 @@
+#pragma once
+
+#include <foundation.h>
+
+struct App;
+struct Tile;
+struct Camera;
+enum Map_Mode : s32;
+
+//
+// The quadtree is refined from the camera every frame: Leaves whose projected
+// screen space error exceeds LOD_SPLIT_THRESHOLD get subdivided, subtrees whose
+// error dropped below LOD_MERGE_THRESHOLD get collapsed back into their root. The
+// gap between the two thresholds prevents tiles from flickering between levels.
+// Subtrees outside of the view are left alone, see residency.h, and so are the ones
+// the prefetcher expects to need soon, see prefetch.h.
+//
+
+#define LOD_SPLIT_THRESHOLD 8.0 // In pixels per texel
+#define LOD_MERGE_THRESHOLD (LOD_SPLIT_THRESHOLD * 0.5)
+#define LOD_MAX_LEVEL 18
+#define LOD_MAX_SPLITS_PER_FRAME 32 // Bounds the texture creation and job submission work done in a single frame
+
+struct Lod_Stats {
+    s64 splits;
+    s64 merges;
+    s64 leaves; // In view
+};
+
+f64 get_tile_screen_space_error(Camera *camera, Map_Mode map_mode, Tile *tile);
+void update_tile_lod(App *app);
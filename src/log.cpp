@@ -0,0 +1,406 @@
+// --- C++
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// --- C
+#include <stdio.h>
+#include <string.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <os_specific.h>
+
+// --- App
+#include "log.h"
+
+#define LOG_LINE_CAPACITY 1024
+#define LOG_RATE_SLOTS    64
+
+struct Log_Message {
+	std::atomic<u64> sequence; // The ring index this slot is ready for, see push_log_message
+	Log_Level level;
+	s32 argument_count;
+	s32 strings_length;
+	Hardware_Time time;
+	const char *format;
+	Log_Argument arguments[LOG_MAX_ARGUMENTS];
+	char strings[LOG_STRING_CAPACITY]; // The %s arguments, which may not outlive the call
+};
+
+struct Log_Rate {
+	const char *format; // Identifies the call site
+	s64 window; // The second since the logger was created
+	s64 count, suppressed; // In this window
+	Log_Level level;
+};
+
+struct Logger {
+	Log_Message ring[LOG_RING_CAPACITY];
+	std::atomic<u64> write_index;
+	u64 read_index; // Only touched by the logger thread
+	std::atomic<s64> dropped;
+
+	std::atomic<b8> running, stopping;
+	std::thread thread;
+
+	Hardware_Time start_time;
+	System_Time start_system_time;
+	FILE *file; // The binary log file, optional
+	b8 console;
+
+	Log_Rate rates[LOG_RATE_SLOTS];
+	s64 reported_drops;
+	Log_Stats stats;
+};
+
+Log_Level minimum_log_level = LOG_Debug;
+
+static Logger logger;
+
+static const char *LOG_LEVEL_STRING[] = {
+	"DEBUG",
+	"WARN ",
+	"ERROR"
+};
+
+
+
+static
+s64 format_log_message(char *buffer, s64 capacity, const char *format, Log_Argument *arguments, s64 argument_count, const char *strings) {
+	//
+	// Walks the format and hands every conversion with its captured argument to snprintf.
+	// Integers were widened to s64 when they were captured, so their length modifier is
+	// replaced with 'll'.
+	//
+	s64 length = 0, next_argument = 0;
+
+	auto append = [&](s64 written) { if(written > 0) length = min<s64>(length + written, capacity - 1); };
+
+	for(const char *c = format; *c && length < capacity - 1; ) {
+		if(*c != '%') {
+			buffer[length++] = *c++;
+			continue;
+		}
+
+		if(c[1] == '%') {
+			buffer[length++] = '%';
+			c += 2;
+			continue;
+		}
+
+		char specification[32];
+		s64 specification_length = 0;
+		specification[specification_length++] = *c++;
+
+		while(*c && strchr("-+ #0123456789.", *c) && specification_length < ARRAY_COUNT(specification) - 4) specification[specification_length++] = *c++;
+		while(*c && strchr("hlLqjzt", *c)) ++c;
+
+		char conversion = *c;
+		if(!conversion) break;
+		++c;
+
+		b8 integer = strchr("diouxXc", conversion) != null;
+		if(integer && conversion != 'c') {
+			specification[specification_length++] = 'l';
+			specification[specification_length++] = 'l';
+		}
+
+		specification[specification_length++] = conversion;
+		specification[specification_length]   = 0;
+
+		if(next_argument >= argument_count) {
+			append(snprintf(buffer + length, capacity - length, "<missing>"));
+			continue;
+		}
+
+		Log_Argument *argument = &arguments[next_argument++];
+
+		switch(argument->kind) {
+		case LOG_ARGUMENT_Integer:
+			if(conversion == 'c')  append(snprintf(buffer + length, capacity - length, specification, (int) argument->integer));
+			else if(integer)       append(snprintf(buffer + length, capacity - length, specification, (long long) argument->integer));
+			else if(conversion == 'p') append(snprintf(buffer + length, capacity - length, specification, (void *) argument->integer));
+			else append(snprintf(buffer + length, capacity - length, "%lld", (long long) argument->integer));
+			break;
+
+		case LOG_ARGUMENT_Real:
+			if(strchr("fFeEgGaA", conversion)) append(snprintf(buffer + length, capacity - length, specification, argument->real));
+			else append(snprintf(buffer + length, capacity - length, "%f", argument->real));
+			break;
+
+		case LOG_ARGUMENT_String:
+			if(conversion == 's') append(snprintf(buffer + length, capacity - length, specification, strings + argument->integer));
+			else append(snprintf(buffer + length, capacity - length, "%s", strings + argument->integer));
+			break;
+
+		case LOG_ARGUMENT_Pointer:
+			append(snprintf(buffer + length, capacity - length, "%p", argument->pointer));
+			break;
+		}
+	}
+
+	buffer[length] = 0;
+	return length;
+}
+
+static
+void print_log_line(Log_Level level, s64 seconds_of_day, const char *message) {
+	s64 hour = (seconds_of_day / 3600) % 24, minute = (seconds_of_day / 60) % 60, second = seconds_of_day % 60;
+	printf("[%02lld:%02lld:%02lld][%s] %s\n", hour, minute, second, LOG_LEVEL_STRING[level], message);
+}
+
+static
+s64 copy_log_strings(char *strings, Log_Argument *arguments, s64 argument_count) {
+	s64 length = 0;
+
+	for(s64 i = 0; i < argument_count; ++i) {
+		if(arguments[i].kind != LOG_ARGUMENT_String) continue;
+
+		const char *string = arguments[i].string ? arguments[i].string : "(null)";
+		s64 copied = min<s64>((s64) strlen(string), LOG_STRING_CAPACITY - length - 1);
+
+		if(copied < 0) {
+			// Out of space, refer to the terminator of the previous string instead.
+			arguments[i].integer = length - 1;
+			continue;
+		}
+
+		arguments[i].integer = length;
+		memcpy(strings + length, string, copied);
+		strings[length + copied] = 0;
+		length += copied + 1;
+	}
+
+	return length;
+}
+
+
+
+static
+s64 get_log_seconds_of_day(Hardware_Time time) {
+	System_Time *start = &logger.start_system_time;
+	f64 seconds = start->hour * 3600.0 + start->minute * 60.0 + start->second + start->millisecond / 1000.0 + os_convert_hardware_time(time - logger.start_time, Seconds);
+	return (s64) seconds;
+}
+
+static
+void report_suppressed_messages(Log_Rate *rate) {
+	if(!rate->suppressed || !logger.console) return;
+
+	char line[LOG_LINE_CAPACITY];
+	snprintf(line, sizeof(line), "Suppressed %lld more messages like \"%s\".", rate->suppressed, rate->format);
+	print_log_line(rate->level, get_log_seconds_of_day(os_get_hardware_time()), line);
+	rate->suppressed = 0;
+}
+
+static
+b8 passes_log_rate_limit(Log_Message *message) {
+	s64 window = (s64) os_convert_hardware_time(message->time - logger.start_time, Seconds);
+	Log_Rate *rate = &logger.rates[((u64) message->format >> 3) % LOG_RATE_SLOTS];
+
+	if(rate->format != message->format || rate->window != window) {
+		report_suppressed_messages(rate);
+		rate->format = message->format;
+		rate->window = window;
+		rate->count  = 0;
+		rate->level  = message->level;
+	}
+
+	if(rate->count >= LOG_RATE_LIMIT) {
+		++rate->suppressed;
+		++logger.stats.suppressed;
+		return false;
+	}
+
+	++rate->count;
+	return true;
+}
+
+static
+void report_finished_windows() {
+	// Call sites which went quiet report what they suppressed without waiting for their next message.
+	s64 window = (s64) os_convert_hardware_time(os_get_hardware_time() - logger.start_time, Seconds);
+
+	for(s64 i = 0; i < LOG_RATE_SLOTS; ++i) {
+		if(logger.rates[i].window < window) report_suppressed_messages(&logger.rates[i]);
+	}
+}
+
+static
+void write_log_file_record(Log_Message *message) {
+	Log_File_Record record;
+	record.seconds        = os_convert_hardware_time(message->time - logger.start_time, Seconds);
+	record.level          = message->level;
+	record.argument_count = message->argument_count;
+	record.format_length  = (s32) strlen(message->format);
+	record.strings_length = message->strings_length;
+
+	Log_File_Argument arguments[LOG_MAX_ARGUMENTS];
+	for(s64 i = 0; i < message->argument_count; ++i) {
+		arguments[i].kind    = message->arguments[i].kind;
+		arguments[i].padding = 0;
+		arguments[i].value   = message->arguments[i].integer;
+	}
+
+	fwrite(&record, sizeof(record), 1, logger.file);
+	fwrite(message->format, 1, record.format_length, logger.file);
+	fwrite(arguments, sizeof(Log_File_Argument), message->argument_count, logger.file);
+	fwrite(message->strings, 1, message->strings_length, logger.file);
+}
+
+static
+b8 write_next_log_message() {
+	Log_Message *message = &logger.ring[logger.read_index & (LOG_RING_CAPACITY - 1)];
+	if(message->sequence.load(std::memory_order_acquire) != logger.read_index + 1) return false; // Not published yet
+
+	if(logger.file) write_log_file_record(message);
+
+	if(logger.console && passes_log_rate_limit(message)) {
+		char line[LOG_LINE_CAPACITY];
+		format_log_message(line, sizeof(line), message->format, message->arguments, message->argument_count, message->strings);
+		print_log_line(message->level, get_log_seconds_of_day(message->time), line);
+	}
+
+	++logger.stats.messages;
+
+	// Hand the slot back to the producers, for the next lap around the ring.
+	message->sequence.store(logger.read_index + LOG_RING_CAPACITY, std::memory_order_release);
+	++logger.read_index;
+	return true;
+}
+
+static
+void report_dropped_messages() {
+	s64 dropped = logger.dropped.load(std::memory_order_relaxed);
+	if(dropped == logger.reported_drops) return;
+
+	if(logger.console) {
+		char line[LOG_LINE_CAPACITY];
+		snprintf(line, sizeof(line), "Dropped %lld log messages, the ring was full.", dropped - logger.reported_drops);
+		print_log_line(LOG_Warning, get_log_seconds_of_day(os_get_hardware_time()), line);
+	}
+
+	logger.reported_drops = dropped;
+}
+
+static
+void logger_entry_point() {
+	while(true) {
+		// Read the flag first, so that no message pushed before destroy_logger is missed.
+		b8 stopping = logger.stopping.load(std::memory_order_acquire);
+
+		s64 written = 0;
+		while(write_next_log_message()) ++written;
+
+		report_dropped_messages();
+		report_finished_windows();
+
+		if(written) {
+			fflush(stdout);
+			if(logger.file) fflush(logger.file);
+		}
+
+		if(stopping) break;
+		if(!written) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	for(s64 i = 0; i < LOG_RATE_SLOTS; ++i) report_suppressed_messages(&logger.rates[i]);
+	fflush(stdout);
+}
+
+
+
+void create_logger(const char *file_path, b8 console) {
+	if(logger.running.load()) return;
+
+	for(s64 i = 0; i < LOG_RING_CAPACITY; ++i) logger.ring[i].sequence.store(i, std::memory_order_relaxed);
+	logger.write_index.store(0, std::memory_order_relaxed);
+	logger.read_index = 0;
+	logger.dropped.store(0, std::memory_order_relaxed);
+	logger.stopping.store(false, std::memory_order_relaxed);
+
+	logger.start_time        = os_get_hardware_time();
+	logger.start_system_time = os_get_system_time();
+	logger.console           = console;
+	logger.file              = null;
+	logger.reported_drops    = 0;
+	logger.stats             = Log_Stats{};
+	memset(logger.rates, 0, sizeof(logger.rates));
+
+	if(file_path) {
+		logger.file = fopen(file_path, "wb");
+
+		if(logger.file) {
+			System_Time *time = &logger.start_system_time;
+			Log_File_Header header = { LOG_FILE_MAGIC, LOG_FILE_VERSION, time->year, time->month, time->day, time->hour, time->minute, time->second, time->millisecond };
+			fwrite(&header, sizeof(header), 1, logger.file);
+		}
+	}
+
+	logger.thread = std::thread(logger_entry_point);
+	logger.running.store(true, std::memory_order_release);
+
+	if(file_path && !logger.file) log(LOG_Warning, "Failed to open the log file '%s'.", file_path);
+}
+
+void destroy_logger() {
+	if(!logger.running.load()) return;
+
+	logger.running.store(false, std::memory_order_release); // Later messages are printed directly
+	logger.stopping.store(true, std::memory_order_release);
+	logger.thread.join();
+
+	if(logger.file) fclose(logger.file);
+	logger.file = null;
+}
+
+Log_Stats get_log_stats() {
+	Log_Stats stats = logger.stats;
+	stats.dropped = logger.dropped.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void push_log_message(Log_Level level, const char *format, Log_Argument *arguments, s64 argument_count) {
+	if(!logger.running.load(std::memory_order_acquire)) {
+		char strings[LOG_STRING_CAPACITY], line[LOG_LINE_CAPACITY];
+		copy_log_strings(strings, arguments, argument_count);
+		format_log_message(line, sizeof(line), format, arguments, argument_count, strings);
+
+		System_Time time = os_get_system_time();
+		print_log_line(level, time.hour * 3600 + time.minute * 60 + time.second, line);
+		return;
+	}
+
+	//
+	// A slot is free for ring index i once its sequence is i (see write_next_log_message).
+	// Claim the index by advancing write_index, fill the slot and publish it by setting
+	// the sequence to i + 1. If the logger thread hasn't freed the slot yet, the ring is
+	// full and the message is dropped.
+	//
+	u64 index = logger.write_index.load(std::memory_order_relaxed);
+	Log_Message *message;
+
+	while(true) {
+		message = &logger.ring[index & (LOG_RING_CAPACITY - 1)];
+		s64 difference = (s64) (message->sequence.load(std::memory_order_acquire) - index);
+
+		if(difference == 0) {
+			if(logger.write_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) break;
+		} else if(difference < 0) {
+			logger.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		} else {
+			index = logger.write_index.load(std::memory_order_relaxed);
+		}
+	}
+
+	message->level          = level;
+	message->argument_count = (s32) argument_count;
+	message->time           = os_get_hardware_time();
+	message->format         = format;
+	memcpy(message->arguments, arguments, argument_count * sizeof(Log_Argument));
+	message->strings_length = (s32) copy_log_strings(message->strings, message->arguments, argument_count);
+
+	message->sequence.store(index + 1, std::memory_order_release);
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+// --- C++
+#include <type_traits>
+
+// --- Foundation
+#include <foundation.h>
+
+//
+// log() never formats or prints on the calling thread while the logger is running.
+// It captures the format pointer, a timestamp and the arguments (copying %s strings)
+// into a slot of a lock-free multi-producer ring, and the logger thread formats and
+// writes the messages later. When the ring is full, messages are dropped and counted
+// rather than blocking the frame. Every call site may print LOG_RATE_LIMIT messages
+// per second to the console, the rest is suppressed and summarized.
+// Messages below LOG_COMPILE_LEVEL are compiled out, messages below
+// minimum_log_level are rejected before anything is captured.
+// Before create_logger and after destroy_logger, log() formats and prints directly,
+// which is what the command line tools rely on.
+//
+// The optional binary log file starts with a Log_File_Header, followed by one
+// Log_File_Record per message, which is followed by the format string, the
+// arguments and the copied strings of that message.
+//
+
+#ifndef LOG_COMPILE_LEVEL
+# define LOG_COMPILE_LEVEL LOG_Debug
+#endif
+
+#define LOG_RING_CAPACITY    4096 // Must be a power of two
+#define LOG_MAX_ARGUMENTS    16
+#define LOG_STRING_CAPACITY  256 // Per message, for all %s arguments
+#define LOG_RATE_LIMIT       10 // Per call site and second
+#define LOG_FILE_MAGIC       0x474c5657 // "WVLG"
+#define LOG_FILE_VERSION     1
+
+enum Log_Level {
+	LOG_Debug,
+	LOG_Warning,
+	LOG_Error,
+};
+
+enum Log_Argument_Kind : s32 {
+	LOG_ARGUMENT_Integer,
+	LOG_ARGUMENT_Real,
+	LOG_ARGUMENT_String,
+	LOG_ARGUMENT_Pointer,
+};
+
+struct Log_Argument {
+	Log_Argument_Kind kind;
+	union {
+		s64 integer;
+		f64 real;
+		const void *pointer;
+		const char *string; // Until the message is pushed, then the integer is its offset
+	};
+};
+
+struct Log_Stats {
+	s64 messages; // Written by the logger thread
+	s64 dropped; // Because the ring was full
+	s64 suppressed; // By the rate limit
+};
+
+struct Log_File_Header {
+	u32 magic;
+	u32 version;
+	s32 year, month, day, hour, minute, second, millisecond; // When the logger was created
+};
+
+struct Log_File_Record {
+	f64 seconds; // Since the logger was created
+	s32 level;
+	s32 argument_count; // Of Log_File_Argument
+	s32 format_length;
+	s32 strings_length;
+};
+
+struct Log_File_Argument {
+	s32 kind; // Log_Argument_Kind
+	s32 padding;
+	s64 value; // The bits of the integer, real or pointer
+};
+
+extern Log_Level minimum_log_level;
+
+void create_logger(const char *file_path = null, b8 console = true); // file_path is the optional binary log file
+void destroy_logger(); // Writes the remaining messages
+Log_Stats get_log_stats();
+
+void push_log_message(Log_Level level, const char *format, Log_Argument *arguments, s64 argument_count);
+
+static inline
+void capture_log_argument(Log_Argument *argument, s64 value, std::false_type /* floating point */) {
+	argument->kind    = LOG_ARGUMENT_Integer;
+	argument->integer = value;
+}
+
+static inline
+void capture_log_argument(Log_Argument *argument, f64 value, std::true_type /* floating point */) {
+	argument->kind = LOG_ARGUMENT_Real;
+	argument->real = value;
+}
+
+template<typename T>
+static inline
+void capture_log_argument(Log_Argument *argument, T value) {
+	capture_log_argument(argument, value, std::is_floating_point<T>()); // Integers, booleans and enums
+}
+
+template<typename T>
+static inline
+void capture_log_argument(Log_Argument *argument, T *pointer) {
+	argument->kind    = LOG_ARGUMENT_Pointer;
+	argument->pointer = pointer;
+}
+
+static inline
+void capture_log_argument(Log_Argument *argument, const char *string) {
+	argument->kind   = LOG_ARGUMENT_String;
+	argument->string = string;
+}
+
+static inline
+void capture_log_argument(Log_Argument *argument, char *string) {
+	capture_log_argument(argument, (const char *) string);
+}
+
+static inline
+void capture_log_arguments(Log_Argument * /* arguments */) {}
+
+template<typename T, typename... Rest>
+static inline
+void capture_log_arguments(Log_Argument *arguments, T first, Rest... rest) {
+	capture_log_argument(arguments, first);
+	capture_log_arguments(arguments + 1, rest...);
+}
+
+//
+// The format must outlive the logger thread, i.e. be a string literal, since only its
+// pointer is captured. It supports the printf conversions, without '*' widths.
+//
+template<typename... Arguments>
+static inline
+void log(Log_Level level, const char *format, Arguments... arguments) {
+	static_assert(sizeof...(Arguments) <= LOG_MAX_ARGUMENTS, "Too many log arguments.");
+
+	if(level < LOG_COMPILE_LEVEL || level < minimum_log_level) return;
+
+	Log_Argument captured[sizeof...(Arguments) + 1]; // One more, zero sized arrays are not allowed
+	capture_log_arguments(captured, arguments...);
+	push_log_message(level, format, captured, sizeof...(Arguments));
+}
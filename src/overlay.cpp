@@ -0,0 +1,509 @@
+// --- C
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <memutils.h>
+#include <os_specific.h>
+
+// --- App
+#include "app.h"
+#include "overlay.h"
+#include "paint.h"
+
+struct Overlay_Painter {
+    Overlay *overlay;
+    Bounding_Box box;
+    u32 *pixels;
+    f64 scale_x, scale_y; // Pixels per degree
+    s64 visible_count;
+};
+
+static
+void *grow_array(App *app, void *data, s64 count, s64 *capacity, s64 element_size, s64 required) {
+    if(required <= *capacity) return data;
+
+    s64 new_capacity = max<s64>(max<s64>(*capacity * 2, required), 256);
+    void *new_data = app->allocator.allocate(new_capacity * element_size);
+    if(count) memcpy(new_data, data, count * element_size);
+    if(data) app->allocator.deallocate(data);
+
+    *capacity = new_capacity;
+    return new_data;
+}
+
+static inline
+u32 pack_color(v4f color) {
+    u32 r = (u32) (clamp(color.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 g = (u32) (clamp(color.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 b = (u32) (clamp(color.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 a = (u32) (clamp(color.w, 0.0f, 1.0f) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static inline
+b8 boxes_touch(Bounding_Box lhs, Bounding_Box rhs) {
+    // Inclusive, so that tiles also visit the buckets they only share an edge with.
+    return lhs.lat0 <= rhs.lat1 && rhs.lat0 <= lhs.lat1 && lhs.lon0 <= rhs.lon1 && rhs.lon0 <= lhs.lon1;
+}
+
+static inline
+Bounding_Box get_child_box(Bounding_Box box, s64 child) {
+    // The child order of subdivide_tile.
+    f64 half_lat = (box.lat1 - box.lat0) * 0.5, half_lon = (box.lon1 - box.lon0) * 0.5;
+    f64 lat0 = box.lat0 + half_lat * (child / 2), lon0 = box.lon0 + half_lon * (child % 2);
+    return Bounding_Box{ lat0, lon0, lat0 + half_lat, lon0 + half_lon };
+}
+
+static
+Bounding_Box get_primitive_box(Overlay *overlay, Overlay_Primitive *primitive) {
+    Coordinate first = overlay->vertices[primitive->vertices[0]];
+    Bounding_Box box = { first.lat, first.lon, first.lat, first.lon };
+
+    for(s64 i = 1; i < 3 && primitive->vertices[i] >= 0; ++i) {
+        Coordinate vertex = overlay->vertices[primitive->vertices[i]];
+        box.lat0 = min(box.lat0, vertex.lat);
+        box.lon0 = min(box.lon0, vertex.lon);
+        box.lat1 = max(box.lat1, vertex.lat);
+        box.lon1 = max(box.lon1, vertex.lon);
+    }
+
+    return box;
+}
+
+static
+void add_primitive(App *app, s32 a, s32 b, s32 c, u32 color) {
+    Overlay *overlay = &app->overlay;
+    overlay->primitives = (Overlay_Primitive *) grow_array(app, overlay->primitives, overlay->primitive_count, &overlay->primitive_capacity, sizeof(Overlay_Primitive), overlay->primitive_count + 1);
+    overlay->primitives[overlay->primitive_count] = Overlay_Primitive{ { a, b, c }, color };
+    ++overlay->primitive_count;
+}
+
+static inline
+f64 cross(Coordinate o, Coordinate a, Coordinate b) {
+    // Longitude is x, latitude is y.
+    return (a.lon - o.lon) * (b.lat - o.lat) - (a.lat - o.lat) * (b.lon - o.lon);
+}
+
+static
+b8 is_ear(Coordinate *vertices, s32 *next, s32 a, s32 b, s32 c) {
+    if(cross(vertices[a], vertices[b], vertices[c]) <= 0) return false; // Reflex or degenerate
+
+    for(s32 p = next[c]; p != a; p = next[p]) {
+        if(cross(vertices[a], vertices[b], vertices[p]) >= 0 && cross(vertices[b], vertices[c], vertices[p]) >= 0 && cross(vertices[c], vertices[a], vertices[p]) >= 0) return false;
+    }
+
+    return true;
+}
+
+static
+void triangulate_polygon(App *app, s32 first_vertex, s64 count, u32 color) {
+    Coordinate *vertices = &app->overlay.vertices[first_vertex];
+
+    f64 area = 0;
+    for(s64 i = 0; i < count; ++i) area += cross(Coordinate{ 0, 0 }, vertices[i], vertices[(i + 1) % count]);
+
+    // Walk the outline counter clockwise, so that ears are the convex corners.
+    s32 *next = (s32 *) app->allocator.allocate(count * 2 * sizeof(s32));
+    s32 *prev = next + count;
+    for(s64 i = 0; i < count; ++i) {
+        s32 following = (s32) ((i + 1) % count), preceding = (s32) ((i + count - 1) % count);
+        next[i] = area >= 0 ? following : preceding;
+        prev[i] = area >= 0 ? preceding : following;
+    }
+
+    s64 remaining = count, attempts = 0;
+    s32 vertex = 0;
+
+    while(remaining > 3) {
+        s32 a = prev[vertex], c = next[vertex];
+
+        if(is_ear(vertices, next, a, vertex, c)) {
+            add_primitive(app, first_vertex + a, first_vertex + vertex, first_vertex + c, color);
+            next[a] = c;
+            prev[c] = a;
+            vertex  = c;
+            --remaining;
+            attempts = 0;
+        } else {
+            vertex = next[vertex];
+            if(++attempts > remaining) break;
+        }
+    }
+
+    if(remaining == 3) {
+        add_primitive(app, first_vertex + prev[vertex], first_vertex + vertex, first_vertex + next[vertex], color);
+    } else {
+        log(LOG_Warning, "Failed to triangulate an overlay polygon with %lld vertices, it is not simple.", count);
+    }
+
+    app->allocator.deallocate(next);
+}
+
+void add_overlay_feature(App *app, Overlay_Kind kind, v4f color, Coordinate *coordinates, s64 count) {
+    Overlay *overlay = &app->overlay;
+
+    // Polygons may repeat their first vertex at the end.
+    if(kind == OVERLAY_Polygon && count > 1 && coordinates[0].lat == coordinates[count - 1].lat && coordinates[0].lon == coordinates[count - 1].lon) --count;
+    if(count < (kind == OVERLAY_Polygon ? 3 : 2)) return;
+
+    s32 first_vertex = (s32) overlay->vertex_count;
+    overlay->vertices = (Coordinate *) grow_array(app, overlay->vertices, overlay->vertex_count, &overlay->vertex_capacity, sizeof(Coordinate), overlay->vertex_count + count);
+    memcpy(&overlay->vertices[first_vertex], coordinates, count * sizeof(Coordinate));
+    overlay->vertex_count += count;
+
+    u32 packed = pack_color(color);
+
+    switch(kind) {
+    case OVERLAY_Polyline:
+        for(s32 i = 0; i < count - 1; ++i) add_primitive(app, first_vertex + i, first_vertex + i + 1, -1, packed);
+        break;
+
+    case OVERLAY_Polygon:
+        triangulate_polygon(app, first_vertex, count, packed);
+        break;
+    }
+}
+
+
+
+static inline
+s64 get_containing_child(Bounding_Box box, Bounding_Box primitive_box) {
+    // The child which contains the whole primitive box, or -1 if it crosses the middle of the box.
+    f64 lat = (box.lat0 + box.lat1) * 0.5, lon = (box.lon0 + box.lon1) * 0.5;
+    s64 row    = primitive_box.lat1 <= lat ? 0 : (primitive_box.lat0 >= lat ? 1 : -1);
+    s64 column = primitive_box.lon1 <= lon ? 0 : (primitive_box.lon0 >= lon ? 1 : -1);
+    return (row < 0 || column < 0) ? -1 : row * 2 + column;
+}
+
+static
+void build_bucket(App *app, s64 bucket_index, Bounding_Box box, s64 level, s32 *primitives, Bounding_Box *boxes, s64 count) {
+    Overlay *overlay = &app->overlay;
+
+    //
+    // Sort the primitives by the child containing them, with the ones crossing the middle
+    // of the box first. Those stay in this bucket. Splitting only pays off if some
+    // primitives actually move down, otherwise dense areas (e.g. the fan of a large
+    // polygon) would split all the way down to OVERLAY_MAX_BUCKET_LEVEL.
+    //
+    s64 child_counts[5] = {};
+    s64 *children = (s64 *) app->allocator.allocate(count * sizeof(s64));
+
+    for(s64 i = 0; i < count; ++i) {
+        children[i] = (count > OVERLAY_BUCKET_CAPACITY && level < OVERLAY_MAX_BUCKET_LEVEL) ? get_containing_child(box, boxes[i]) + 1 : 0;
+        ++child_counts[children[i]];
+    }
+
+    s64 first = overlay->bucket_primitive_count;
+    overlay->bucket_primitives = (s32 *) grow_array(app, overlay->bucket_primitives, first, &overlay->bucket_primitive_capacity, sizeof(s32), first + child_counts[0]);
+    overlay->bucket_primitive_count += child_counts[0];
+
+    for(s64 i = 0, j = first; i < count; ++i) {
+        if(!children[i]) overlay->bucket_primitives[j++] = primitives[i];
+    }
+
+    if(child_counts[0] == count) {
+        overlay->buckets[bucket_index] = Overlay_Bucket{ -1, (s32) first, (s32) count };
+        app->allocator.deallocate(children);
+        return;
+    }
+
+    // The bucket array may move while the children are built, so only its indices are kept around.
+    s64 first_child = overlay->bucket_count;
+    overlay->buckets = (Overlay_Bucket *) grow_array(app, overlay->buckets, overlay->bucket_count, &overlay->bucket_capacity, sizeof(Overlay_Bucket), first_child + 4);
+    overlay->bucket_count += 4;
+    overlay->buckets[bucket_index] = Overlay_Bucket{ (s32) first_child, (s32) first, (s32) child_counts[0] };
+
+    s32 *child_primitives = (s32 *) app->allocator.allocate((count - child_counts[0]) * sizeof(s32));
+    Bounding_Box *child_boxes = (Bounding_Box *) app->allocator.allocate((count - child_counts[0]) * sizeof(Bounding_Box));
+
+    for(s64 i = 0; i < 4; ++i) {
+        s64 child_count = 0;
+
+        for(s64 j = 0; j < count; ++j) {
+            if(children[j] != i + 1) continue;
+            child_primitives[child_count] = primitives[j];
+            child_boxes[child_count] = boxes[j];
+            ++child_count;
+        }
+
+        build_bucket(app, first_child + i, get_child_box(box, i), level + 1, child_primitives, child_boxes, child_count);
+    }
+
+    app->allocator.deallocate(child_primitives);
+    app->allocator.deallocate(child_boxes);
+    app->allocator.deallocate(children);
+}
+
+static
+void free_buckets(App *app) {
+    Overlay *overlay = &app->overlay;
+    if(overlay->buckets) app->allocator.deallocate(overlay->buckets);
+    if(overlay->bucket_primitives) app->allocator.deallocate(overlay->bucket_primitives);
+    if(overlay->primitive_boxes) app->allocator.deallocate(overlay->primitive_boxes);
+    if(overlay->visible_primitives) app->allocator.deallocate(overlay->visible_primitives);
+
+    overlay->buckets            = null;
+    overlay->bucket_count       = 0;
+    overlay->bucket_capacity    = 0;
+    overlay->bucket_primitives  = null;
+    overlay->bucket_primitive_count    = 0;
+    overlay->bucket_primitive_capacity = 0;
+    overlay->primitive_boxes    = null;
+    overlay->visible_primitives = null;
+}
+
+void build_overlay(App *app) {
+    Overlay *overlay = &app->overlay;
+    Hardware_Time start = os_get_hardware_time();
+
+    free_buckets(app);
+    if(!overlay->primitive_count) return;
+
+    s32 *primitives = (s32 *) app->allocator.allocate(overlay->primitive_count * sizeof(s32));
+    Bounding_Box *boxes = (Bounding_Box *) app->allocator.allocate(overlay->primitive_count * sizeof(Bounding_Box));
+
+    overlay->bounds = get_primitive_box(overlay, &overlay->primitives[0]);
+
+    for(s64 i = 0; i < overlay->primitive_count; ++i) {
+        primitives[i] = (s32) i;
+        boxes[i] = get_primitive_box(overlay, &overlay->primitives[i]);
+        overlay->bounds.lat0 = min(overlay->bounds.lat0, boxes[i].lat0);
+        overlay->bounds.lon0 = min(overlay->bounds.lon0, boxes[i].lon0);
+        overlay->bounds.lat1 = max(overlay->bounds.lat1, boxes[i].lat1);
+        overlay->bounds.lon1 = max(overlay->bounds.lon1, boxes[i].lon1);
+    }
+
+    overlay->buckets = (Overlay_Bucket *) grow_array(app, null, 0, &overlay->bucket_capacity, sizeof(Overlay_Bucket), 1);
+    overlay->bucket_count = 1;
+    build_bucket(app, 0, Bounding_Box{ -90, -180, 90, 180 }, 0, primitives, boxes, overlay->primitive_count);
+
+    app->allocator.deallocate(primitives);
+
+    overlay->primitive_boxes    = boxes;
+    overlay->visible_primitives = (s32 *) app->allocator.allocate(overlay->primitive_count * sizeof(s32));
+
+    if(app->root.leaf || app->root.children[0]) invalidate_tiles(app, overlay->bounds); // New tiles get painted anyway
+
+    Hardware_Time end = os_get_hardware_time();
+    log(LOG_Debug, "Built the overlay (%lld vertices, %lld primitives, %lld buckets): %fms.", overlay->vertex_count, overlay->primitive_count, overlay->bucket_count, os_convert_hardware_time(end - start, Milliseconds));
+}
+
+b8 load_overlay(App *app, const char *file_path) {
+    FILE *file = fopen(file_path, "r");
+    if(!file) return false; // Overlays are optional, the caller decides whether this is an error
+
+    Coordinate *coordinates = null;
+    s64 count = 0, capacity = 0, line_number = 0;
+    Overlay_Kind kind = OVERLAY_Polyline;
+    v4f color = v4f(1, 1, 1, 1);
+    b8 in_feature = false, valid = true;
+
+    char line[256];
+    while(valid && fgets(line, sizeof(line), file)) {
+        ++line_number;
+
+        char *start = line;
+        while(*start == ' ' || *start == '\t') ++start;
+        if(*start == '#' || *start == '\n' || *start == '\r' || *start == 0) continue;
+
+        char name[16];
+        f32 r, g, b, a;
+        f64 lat, lon;
+
+        if(sscanf(start, "%15s %f %f %f %f", name, &r, &g, &b, &a) == 5 && (!strcmp(name, "line") || !strcmp(name, "polygon"))) {
+            if(in_feature) add_overlay_feature(app, kind, color, coordinates, count);
+
+            kind       = !strcmp(name, "line") ? OVERLAY_Polyline : OVERLAY_Polygon;
+            color      = v4f(r, g, b, a);
+            count      = 0;
+            in_feature = true;
+        } else if(in_feature && sscanf(start, "%lf %lf", &lat, &lon) == 2 && lat >= -90 && lat <= 90 && lon >= -180 && lon <= 180) {
+            coordinates = (Coordinate *) grow_array(app, coordinates, count, &capacity, sizeof(Coordinate), count + 1);
+            coordinates[count] = Coordinate{ lat, lon };
+            ++count;
+        } else {
+            log(LOG_Warning, "'%s' is not a valid overlay, line %lld is neither a feature nor a coordinate.", file_path, line_number);
+            valid = false;
+        }
+    }
+
+    if(valid && in_feature) add_overlay_feature(app, kind, color, coordinates, count);
+
+    if(coordinates) app->allocator.deallocate(coordinates);
+    fclose(file);
+
+    if(valid) build_overlay(app);
+    return valid;
+}
+
+void destroy_overlay(App *app) {
+    Overlay *overlay = &app->overlay;
+
+    free_buckets(app);
+    if(overlay->vertices) app->allocator.deallocate(overlay->vertices);
+    if(overlay->primitives) app->allocator.deallocate(overlay->primitives);
+
+    *overlay = Overlay{};
+}
+
+
+
+static inline
+void blend_pixel(u32 *pixel, u32 color) {
+    u32 alpha = color >> 24;
+
+    if(alpha == 255) {
+        *pixel = color;
+        return;
+    }
+
+    u32 result = 0;
+    for(s64 channel = 0; channel < 3; ++channel) {
+        u32 source = (color >> (channel * 8)) & 0xff, destination = (*pixel >> (channel * 8)) & 0xff;
+        result |= ((source * alpha + destination * (255 - alpha) + 127) / 255) << (channel * 8);
+    }
+
+    u32 destination_alpha = *pixel >> 24;
+    result |= (alpha + (destination_alpha * (255 - alpha) + 127) / 255) << 24;
+    *pixel = result;
+}
+
+static
+b8 clip_segment(f64 *x0, f64 *y0, f64 *x1, f64 *y1, f64 size) {
+    // Liang-Barsky against the [0;size] square of the tile.
+    f64 dx = *x1 - *x0, dy = *y1 - *y0;
+    f64 p[4] = { -dx, dx, -dy, dy };
+    f64 q[4] = { *x0, size - *x0, *y0, size - *y0 };
+    f64 t0 = 0, t1 = 1;
+
+    for(s64 i = 0; i < 4; ++i) {
+        if(p[i] == 0) {
+            if(q[i] < 0) return false;
+        } else {
+            f64 t = q[i] / p[i];
+            if(p[i] < 0) t0 = max(t0, t); else t1 = min(t1, t);
+        }
+    }
+
+    if(t0 > t1) return false;
+
+    f64 start_x = *x0, start_y = *y0;
+    *x0 = start_x + dx * t0;
+    *y0 = start_y + dy * t0;
+    *x1 = start_x + dx * t1;
+    *y1 = start_y + dy * t1;
+    return true;
+}
+
+static
+void paint_segment(Overlay_Painter *painter, Coordinate a, Coordinate b, u32 color) {
+    const s64 SIZE = TILE_TEXTURE_RESOLUTION;
+
+    f64 x0 = (a.lon - painter->box.lon0) * painter->scale_x, y0 = (a.lat - painter->box.lat0) * painter->scale_y;
+    f64 x1 = (b.lon - painter->box.lon0) * painter->scale_x, y1 = (b.lat - painter->box.lat0) * painter->scale_y;
+    if(!clip_segment(&x0, &y0, &x1, &y1, (f64) SIZE)) return;
+
+    // Step through the segment one pixel at a time along its major axis.
+    s64 steps = (s64) ceil(max(fabs(x1 - x0), fabs(y1 - y0)));
+    f64 step_x = steps ? (x1 - x0) / steps : 0, step_y = steps ? (y1 - y0) / steps : 0;
+
+    for(s64 i = 0; i <= steps; ++i) {
+        s64 column = clamp((s64) (x0 + step_x * i), 0, SIZE - 1);
+        s64 row    = clamp((s64) (y0 + step_y * i), 0, SIZE - 1);
+        blend_pixel(&painter->pixels[row * SIZE + column], color);
+    }
+}
+
+static
+void paint_triangle(Overlay_Painter *painter, Coordinate a, Coordinate b, Coordinate c, u32 color) {
+    const s64 SIZE = TILE_TEXTURE_RESOLUTION;
+
+    f64 x[3] = { (a.lon - painter->box.lon0) * painter->scale_x, (b.lon - painter->box.lon0) * painter->scale_x, (c.lon - painter->box.lon0) * painter->scale_x };
+    f64 y[3] = { (a.lat - painter->box.lat0) * painter->scale_y, (b.lat - painter->box.lat0) * painter->scale_y, (c.lat - painter->box.lat0) * painter->scale_y };
+    if(max(max(x[0], x[1]), x[2]) < 0 || min(min(x[0], x[1]), x[2]) > SIZE || max(max(y[0], y[1]), y[2]) < 0 || min(min(y[0], y[1]), y[2]) > SIZE) return;
+
+    // Only the pixels of the tile within the bounding box of the triangle are tested.
+    s64 column0 = clamp((s64) floor(min(min(x[0], x[1]), x[2])), 0, SIZE - 1), column1 = clamp((s64) floor(max(max(x[0], x[1]), x[2])), 0, SIZE - 1);
+    s64 row0    = clamp((s64) floor(min(min(y[0], y[1]), y[2])), 0, SIZE - 1), row1    = clamp((s64) floor(max(max(y[0], y[1]), y[2])), 0, SIZE - 1);
+
+    for(s64 row = row0; row <= row1; ++row) {
+        f64 py = row + 0.5;
+
+        for(s64 column = column0; column <= column1; ++column) {
+            f64 px = column + 0.5;
+
+            // Triangles are counter clockwise, see triangulate_polygon.
+            f64 e0 = (x[1] - x[0]) * (py - y[0]) - (y[1] - y[0]) * (px - x[0]);
+            f64 e1 = (x[2] - x[1]) * (py - y[1]) - (y[2] - y[1]) * (px - x[1]);
+            f64 e2 = (x[0] - x[2]) * (py - y[2]) - (y[0] - y[2]) * (px - x[2]);
+            if(e0 >= 0 && e1 >= 0 && e2 >= 0) blend_pixel(&painter->pixels[row * SIZE + column], color);
+        }
+    }
+}
+
+static
+void collect_visible_primitives(Overlay_Painter *painter, s64 bucket_index, Bounding_Box bucket_box) {
+    Overlay *overlay = painter->overlay;
+    if(!boxes_touch(bucket_box, painter->box)) return;
+
+    ++overlay->stats.buckets_visited;
+    Overlay_Bucket bucket = overlay->buckets[bucket_index];
+
+    for(s64 i = 0; i < bucket.primitive_count; ++i) {
+        // Every primitive is in exactly one bucket, so it can't be collected twice. The
+        // ones crossing the middle of a large bucket are mostly far away from the tile.
+        s32 primitive = overlay->bucket_primitives[bucket.first_primitive + i];
+        if(!boxes_touch(overlay->primitive_boxes[primitive], painter->box)) continue;
+
+        overlay->visible_primitives[painter->visible_count] = primitive;
+        ++painter->visible_count;
+    }
+
+    if(bucket.first_child >= 0) {
+        for(s64 i = 0; i < 4; ++i) collect_visible_primitives(painter, bucket.first_child + i, get_child_box(bucket_box, i));
+    }
+}
+
+static
+int compare_primitives(const void *lhs, const void *rhs) {
+    s32 a = *(s32 *) lhs, b = *(s32 *) rhs;
+    return (a > b) - (a < b);
+}
+
+b8 overlay_covers(Overlay *overlay, Bounding_Box box) {
+    return overlay->bucket_count && boxes_touch(overlay->bounds, box);
+}
+
+void paint_overlay(App *app, Bounding_Box box, u32 *pixels) {
+    Overlay *overlay = &app->overlay;
+    if(!overlay_covers(overlay, box)) return;
+
+    Overlay_Painter painter;
+    painter.overlay       = overlay;
+    painter.box           = box;
+    painter.pixels        = pixels;
+    painter.scale_x       = TILE_TEXTURE_RESOLUTION / (box.lon1 - box.lon0);
+    painter.scale_y       = TILE_TEXTURE_RESOLUTION / (box.lat1 - box.lat0);
+    painter.visible_count = 0;
+
+    collect_visible_primitives(&painter, 0, Bounding_Box{ -90, -180, 90, 180 });
+    qsort(overlay->visible_primitives, painter.visible_count, sizeof(s32), compare_primitives);
+
+    for(s64 i = 0; i < painter.visible_count; ++i) {
+        Overlay_Primitive *primitive = &overlay->primitives[overlay->visible_primitives[i]];
+        Coordinate a = overlay->vertices[primitive->vertices[0]], b = overlay->vertices[primitive->vertices[1]];
+
+        if(primitive->vertices[2] < 0) {
+            paint_segment(&painter, a, b, primitive->color);
+        } else {
+            paint_triangle(&painter, a, b, overlay->vertices[primitive->vertices[2]], primitive->color);
+        }
+    }
+
+    ++overlay->stats.tiles_painted;
+    overlay->stats.primitives_painted += painter.visible_count;
+}
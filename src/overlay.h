@@ -0,0 +1,86 @@
+#pragma once
+
+#include <foundation.h>
+#include <math/v4.h>
+
+#include "tile.h"
+
+struct App;
+
+//
+// The overlay holds vector data (coastlines, borders, routes) which is painted on top
+// of the tile textures. Features are polylines or polygons in lat/lon. Polygons are
+// triangulated once when they are added. After that, an overlay only consists of
+// primitives, which are line segments and triangles.
+// The primitives are bucketed into a sparse, loose quadtree aligned with the tile
+// quadtree. Each primitive goes into the smallest bucket containing its bounding box,
+// so primitives crossing the middle of a bucket stay in it. A bucket is split into four
+// once it holds more than OVERLAY_BUCKET_CAPACITY primitives, if that moves any of them
+// down, which keeps the tree linear in the primitive count however they overlap.
+// Repainting a tile only walks the buckets overlapping it, so its cost depends on the
+// primitives around the tile rather than on the size of the dataset. The primitives
+// are then clipped to the tile and rasterized into its pixels in the order they were
+// added, so that overlapping features look the same on both sides of a tile edge.
+//
+// Coordinates must lie within [-90;90] x [-180;180], features crossing the
+// antimeridian have to be split by the caller. Polygons must be simple (no holes, no
+// self intersections). They are ear clipped, which is quadratic in the vertex count,
+// so very long outlines like coastlines should be added as polylines.
+//
+// Overlay files are plain text. A feature starts with a line "line r g b a" or
+// "polygon r g b a" (colors from 0 to 1), followed by one "lat lon" line per vertex.
+// Lines starting with '#' are comments.
+//
+
+#define OVERLAY_BUCKET_CAPACITY 64 // Primitives per bucket before it gets split
+#define OVERLAY_MAX_BUCKET_LEVEL 18
+
+enum Overlay_Kind {
+    OVERLAY_Polyline,
+    OVERLAY_Polygon,
+};
+
+struct Overlay_Primitive {
+    s32 vertices[3]; // The third one is -1 for line segments
+    u32 color; // RGBA8, blended over the tile
+};
+
+struct Overlay_Bucket {
+    s32 first_child; // The four children are contiguous, -1 for leaves
+    s32 first_primitive; // Into the bucket primitives, the ones not contained by a single child
+    s32 primitive_count;
+};
+
+struct Overlay_Stats {
+    s64 tiles_painted;
+    s64 buckets_visited;
+    s64 primitives_painted;
+};
+
+struct Overlay {
+    Coordinate *vertices;
+    s64 vertex_count, vertex_capacity;
+
+    Overlay_Primitive *primitives;
+    s64 primitive_count, primitive_capacity;
+
+    Overlay_Bucket *buckets; // The first one covers the whole world
+    s64 bucket_count, bucket_capacity;
+
+    s32 *bucket_primitives;
+    s64 bucket_primitive_count, bucket_primitive_capacity;
+
+    Bounding_Box *primitive_boxes; // [primitive_count]
+    s32 *visible_primitives; // Scratch for painting a tile, [primitive_count]
+
+    Bounding_Box bounds; // Of all primitives
+    Overlay_Stats stats;
+};
+
+void add_overlay_feature(App *app, Overlay_Kind kind, v4f color, Coordinate *coordinates, s64 count);
+void build_overlay(App *app); // Buckets all features added so far and invalidates the tiles they cover
+b8 load_overlay(App *app, const char *file_path);
+void destroy_overlay(App *app);
+
+b8 overlay_covers(Overlay *overlay, Bounding_Box box); // Whether painting this area might touch any primitive
+void paint_overlay(App *app, Bounding_Box box, u32 *pixels); // PAINT_TILE_PIXELS, in the layout of paint.h
@@ -0,0 +1,204 @@
+// --- C
+#include <emmintrin.h>
+#include <string.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <memutils.h>
+
+// --- App
+#include "app.h"
+#include "draw.h"
+#include "paint.h"
+#include "pyramid.h"
+#include "overlay.h"
+#include "points.h"
+#include "profiler.h"
+#include "tile_pool.h"
+
+struct Paint_Batch {
+    G_Handle *textures/*[PAINT_BATCH_SIZE]*/;
+    u32 **pixels/*[PAINT_BATCH_SIZE]*/; // Into the staging buffer or the imagery
+    u32 *staging/*[PAINT_BATCH_SIZE * PAINT_TILE_PIXELS]*/;
+    s64 count;
+    s64 staging_count; // Tiles
+};
+
+static inline
+__m128i pack_pixels(__m128 r, __m128 g, __m128 b, __m128 a) {
+    // UNORM conversion of four pixels, like the GPU does it: Clamp, scale and round to nearest.
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f);
+
+    __m128i ri = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(r, zero), one), scale));
+    __m128i gi = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(g, zero), one), scale));
+    __m128i bi = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(b, zero), one), scale));
+    __m128i ai = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(a, zero), one), scale));
+
+    return _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 8)), _mm_or_si128(_mm_slli_epi32(bi, 16), _mm_slli_epi32(ai, 24)));
+}
+
+static inline
+void store_pixels(u32 *pixels, __m128i packed, s64 count) {
+    if(count == 4) {
+        _mm_storeu_si128((__m128i *) pixels, packed);
+    } else {
+        alignas(16) u32 lanes[4];
+        _mm_store_si128((__m128i *) lanes, packed);
+        for(s64 i = 0; i < count; ++i) pixels[i] = lanes[i];
+    }
+}
+
+void paint_fill(u32 *pixels, s64 width, s64 height, s64 stride, v4f color) {
+    __m128i packed = pack_pixels(_mm_set1_ps(color.x), _mm_set1_ps(color.y), _mm_set1_ps(color.z), _mm_set1_ps(color.w));
+
+    for(s64 y = 0; y < height; ++y) {
+        for(s64 x = 0; x < width; x += 4) {
+            store_pixels(&pixels[y * stride + x], packed, min<s64>(width - x, 4));
+        }
+    }
+}
+
+void paint_gradient(u32 *pixels, s64 width, s64 height, s64 stride, v4f south_west, v4f south_east, v4f north_west, v4f north_east) {
+    //
+    // Evaluated at the pixel centers, which is what rasterizing the area as two triangles
+    // with these vertex colors would produce for colors that are linear over the area.
+    //
+    f32 sw[4] = { south_west.x, south_west.y, south_west.z, south_west.w };
+    f32 se[4] = { south_east.x, south_east.y, south_east.z, south_east.w };
+    f32 nw[4] = { north_west.x, north_west.y, north_west.z, north_west.w };
+    f32 ne[4] = { north_east.x, north_east.y, north_east.z, north_east.w };
+
+    __m128 inv_width = _mm_set1_ps(1.0f / (f32) width);
+    __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+    for(s64 y = 0; y < height; ++y) {
+        f32 v = ((f32) y + 0.5f) / (f32) height;
+
+        __m128 west[4], delta[4];
+        for(s64 c = 0; c < 4; ++c) {
+            f32 left  = sw[c] + (nw[c] - sw[c]) * v;
+            f32 right = se[c] + (ne[c] - se[c]) * v;
+            west[c]  = _mm_set1_ps(left);
+            delta[c] = _mm_set1_ps(right - left);
+        }
+
+        for(s64 x = 0; x < width; x += 4) {
+            __m128 u = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((f32) x), lane_offsets), inv_width);
+
+            __m128 r = _mm_add_ps(west[0], _mm_mul_ps(delta[0], u));
+            __m128 g = _mm_add_ps(west[1], _mm_mul_ps(delta[1], u));
+            __m128 b = _mm_add_ps(west[2], _mm_mul_ps(delta[2], u));
+            __m128 a = _mm_add_ps(west[3], _mm_mul_ps(delta[3], u));
+
+            store_pixels(&pixels[y * stride + x], pack_pixels(r, g, b, a), min<s64>(width - x, 4));
+        }
+    }
+}
+
+static inline
+v4f color_from_coordinate(const Coordinate &coord) {
+    return v4f{ (f32) ((coord.lon + 180.0) / 360.0), (f32) ((coord.lat + 90.0) / 180.0), 0.0, 1.0 };
+}
+
+void paint_tile(Tile *tile, u32 *pixels) {
+    v4f south_west = color_from_coordinate(Coordinate{ tile->box.lat0, tile->box.lon0 });
+    v4f south_east = color_from_coordinate(Coordinate{ tile->box.lat0, tile->box.lon1 });
+    v4f north_west = color_from_coordinate(Coordinate{ tile->box.lat1, tile->box.lon0 });
+    v4f north_east = color_from_coordinate(Coordinate{ tile->box.lat1, tile->box.lon1 });
+
+    paint_gradient(pixels, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, south_west, south_east, north_west, north_east);
+}
+
+
+
+static
+void flush_paint_batch(App *app, Paint_Batch *batch) {
+    if(!batch->count) return;
+
+    update_tile_textures(app, batch->textures, batch->pixels, batch->count);
+    PROFILE_COUNT(PROFILE_COUNTER_Bytes_Uploaded, batch->count * PAINT_TILE_PIXELS * (s64) sizeof(u32));
+    ++app->paint_stats.uploads;
+    batch->count         = 0;
+    batch->staging_count = 0;
+}
+
+static
+b8 collect_invalidated_tiles(App *app, Paint_Batch *batch, Tile *tile) {
+    // Returns whether this subtree still has tiles to repaint afterwards.
+    b8 pending = false;
+
+    if(tile->state == TILE_Requires_Repainting && !tile->texture) {
+        // The texture memory was exhausted when this tile was created. Leaves try again, since
+        // evictions may have made room, inner tiles are drawn through their children anyway.
+        if(tile->leaf) {
+            tile->texture = acquire_tile_texture(app, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_CHANNELS);
+        } else {
+            tile->state = TILE_Empty;
+        }
+    }
+
+    if(tile->state == TILE_Requires_Repainting && !tile->texture) {
+        pending = true; // Stays marked until a texture is available
+    } else if(tile->state == TILE_Requires_Repainting) {
+        u32 *imagery = find_tile_pyramid_pixels(&app->imagery, tile);
+        u32 *pixels  = imagery;
+
+        if(imagery) ++app->paint_stats.tiles_streamed;
+
+        // Overlays can't be painted into the file mapping, so streamed tiles under them go through the staging buffer as well.
+        if(!imagery || overlay_covers(&app->overlay, tile->box) || point_layer_covers(app, tile)) {
+            pixels = &batch->staging[batch->staging_count * PAINT_TILE_PIXELS];
+            ++batch->staging_count;
+
+            if(imagery) {
+                memcpy(pixels, imagery, PAINT_TILE_PIXELS * sizeof(u32));
+            } else {
+                paint_tile(tile, pixels);
+                ++app->paint_stats.tiles_painted;
+            }
+
+            paint_overlay(app, tile->box, pixels);
+            paint_points(app, tile, pixels);
+        }
+
+        batch->textures[batch->count] = tile->texture;
+        batch->pixels[batch->count]   = pixels;
+        ++batch->count;
+
+        if(batch->count == PAINT_BATCH_SIZE) flush_paint_batch(app, batch);
+
+        tile->state = TILE_Valid;
+    }
+
+    // Only descend into subtrees which were marked dirty, so that static scenes don't cost anything.
+    b8 children_pending = false;
+    if(!tile->leaf && tile->children_require_repainting) {
+        for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+            children_pending |= collect_invalidated_tiles(app, batch, tile->children[i]);
+        }
+    }
+
+    tile->children_require_repainting = children_pending;
+    return pending || children_pending;
+}
+
+void paint_invalidated_tiles(App *app) {
+    PROFILE_ZONE("Repaint");
+    app->paint_stats = Paint_Stats{};
+
+    if(app->root.state != TILE_Requires_Repainting && !app->root.children_require_repainting) return;
+
+    s64 temp_mark = mark_temp_allocator();
+
+    Paint_Batch batch;
+    batch.textures      = (G_Handle *) temp.allocate(PAINT_BATCH_SIZE * sizeof(G_Handle));
+    batch.pixels        = (u32 **) temp.allocate(PAINT_BATCH_SIZE * sizeof(u32 *));
+    batch.staging       = (u32 *) temp.allocate(PAINT_BATCH_SIZE * PAINT_TILE_PIXELS * sizeof(u32));
+    batch.count         = 0;
+    batch.staging_count = 0;
+
+    collect_invalidated_tiles(app, &batch, &app->root);
+    flush_paint_batch(app, &batch);
+
+    release_temp_allocator(temp_mark);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <foundation.h>
+#include <math/v4.h>
+
+struct App;
+struct Tile;
+
+//
+// Tile textures are painted on the CPU: Invalidated tiles are collected in batches,
+// painted into one staging buffer through SSE kernels and handed to the graphics
+// backend in a single update_tile_textures call per batch. This keeps the GPU out of
+// painting entirely, so thousands of tiles per frame don't cause any state changes.
+// Tiles contained in the imagery pyramid of the app skip painting, their pixels are
+// uploaded straight out of the file mapping. The vector overlay (overlay.h) and the
+// point clusters (points.h) are painted on top of both.
+// The kernels operate on RGBA8 pixels. Rows go from the south (lat0) to the north
+// (lat1) edge of a tile, columns from the west (lon0) to the east (lon1) edge.
+//
+
+#define PAINT_BATCH_SIZE 1024 // Tiles per staging buffer and upload
+#define PAINT_TILE_PIXELS (TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_RESOLUTION)
+
+struct Paint_Stats {
+    s64 tiles_painted;
+    s64 tiles_streamed; // From the imagery pyramid
+    s64 uploads; // Calls to update_tile_textures
+};
+
+void paint_fill(u32 *pixels, s64 width, s64 height, s64 stride, v4f color);
+void paint_gradient(u32 *pixels, s64 width, s64 height, s64 stride, v4f south_west, v4f south_east, v4f north_west, v4f north_east); // Bilinear between the colors at the corners of the area
+void paint_tile(Tile *tile, u32 *pixels); // PAINT_TILE_PIXELS
+void paint_invalidated_tiles(App *app);
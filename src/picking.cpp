@@ -0,0 +1,80 @@
+// --- C
+#include <math.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <math/v3.h>
+#include <math/v4.h>
+#include <math/m4.h>
+
+// --- App
+#include "app.h"
+#include "picking.h"
+#include "projection.h"
+
+b8 pick_coordinate(Camera *camera, Map_Mode map_mode, f32 mouse_x, f32 mouse_y, Coordinate *coordinate, v3f *position) {
+    if(camera->viewport_width <= 0 || camera->viewport_height <= 0) return false;
+
+    v4f clip = v4f(mouse_x / camera->viewport_width * 2.0f - 1.0f, 1.0f - mouse_y / camera->viewport_height * 2.0f, -1.0f, 1.0f);
+    v4f eye  = camera->inverse_projection * clip;
+
+    switch(map_mode) {
+    case MAP_MODE_2D: {
+        // The projection is orthographic, so every pixel has its own ray origin but all share the view direction.
+        v4f origin    = camera->inverse_view * v4f(eye.x, eye.y, 0.0f, 1.0f);
+        v4f direction = camera->inverse_view * v4f(0.0f, 0.0f, -1.0f, 0.0f);
+        if(direction.z == 0) return false;
+
+        f32 t = -origin.z / direction.z;
+        *position = v3f(origin.x + direction.x * t, origin.y + direction.y * t, 0.0f);
+    } break;
+
+    case MAP_MODE_3D: {
+        v4f world     = camera->inverse_view * v4f(eye.x, eye.y, -1.0f, 0.0f);
+        v3f direction = v3_normalize(v3f(world.x, world.y, world.z));
+        v3f origin    = camera->position;
+
+        // The nearest intersection of origin + t * direction with the globe.
+        f32 b = v3_dot(origin, direction);
+        f32 c = v3_dot(origin, origin) - (f32) (WORLD_SCALE_3D * WORLD_SCALE_3D);
+        f32 discriminant = b * b - c;
+        if(discriminant < 0) return false;
+
+        f32 root = sqrtf(discriminant);
+        f32 t    = (-b - root >= 0) ? -b - root : -b + root;
+        if(t < 0) return false;
+
+        *position = origin + direction * t;
+    } break;
+    }
+
+    *coordinate = coordinate_from_world_space(map_mode, *position);
+
+    // The 2D plane goes on forever, but the map doesn't.
+    return coordinate->lat >= -90.0 && coordinate->lat <= 90.0 && coordinate->lon >= -180.0 && coordinate->lon <= 180.0;
+}
+
+Tile *find_drawn_tile(Tile *root, Coordinate coordinate) {
+    Tile *tile = root;
+
+    // Like in draw_tiles, a split tile keeps drawing itself while it still has a texture.
+    while(!tile->leaf && !tile->texture) {
+        f64 lat_center = (tile->box.lat0 + tile->box.lat1) * 0.5;
+        f64 lon_center = (tile->box.lon0 + tile->box.lon1) * 0.5;
+        tile = tile->children[(coordinate.lat >= lat_center) * 2 + (coordinate.lon >= lon_center)]; // The child order of subdivide_tile
+    }
+
+    return tile;
+}
+
+Pick_Result pick_tile(App *app, f32 mouse_x, f32 mouse_y) {
+    Pick_Result result = {};
+    result.hit = pick_coordinate(&app->camera, app->map_mode, mouse_x, mouse_y, &result.coordinate, &result.position);
+
+    if(result.hit) {
+        result.tile  = find_drawn_tile(&app->root, result.coordinate);
+        result.level = result.tile->level;
+    }
+
+    return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <foundation.h>
+#include <math/v3.h>
+
+#include "tile.h"
+
+struct App;
+struct Camera;
+enum Map_Mode : s32;
+
+//
+// Picking maps a position on the screen (in pixels from the top left corner of the
+// viewport) back onto the map: The ray through that pixel is intersected with the
+// z = 0 plane of the 2D map or the sphere of the globe. Both only take a few vector
+// operations, since the inverse camera matrices are cached by update_camera_matrices.
+// The tile under the cursor is then found by descending the quadtree along the child
+// containing the coordinate, which is one comparison per level.
+//
+
+struct Pick_Result {
+    b8 hit; // Whether the ray hit the map at all, everything else is only set if it did
+    Coordinate coordinate;
+    v3f position; // In world space
+    Tile *tile; // The tile drawn at this coordinate, valid until the next LOD update
+    s64 level;
+};
+
+b8 pick_coordinate(Camera *camera, Map_Mode map_mode, f32 mouse_x, f32 mouse_y, Coordinate *coordinate, v3f *position);
+Tile *find_drawn_tile(Tile *root, Coordinate coordinate);
+Pick_Result pick_tile(App *app, f32 mouse_x, f32 mouse_y);
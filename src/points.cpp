@@ -0,0 +1,335 @@
+// --- C
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <memutils.h>
+#include <os_specific.h>
+
+// --- App
+#include "app.h"
+#include "points.h"
+#include "paint.h"
+#include "pyramid.h"
+#include "tile_index.h"
+
+#define POINT_LAST_LEVEL (POINT_LEVELS - 1)
+#define POINT_CLUSTER_COLOR 0xff0080ff // Opaque orange in RGBA8
+
+static inline
+u64 get_cell_index(s64 level, s64 x, s64 y) {
+    // The Morton code of the position, without the level in the top bits of the key.
+    return get_tile_pyramid_key(level, x, y) & (((u64) 1 << 58) - 1);
+}
+
+Bounding_Box get_cell_box(s64 level, s64 x, s64 y) {
+    f64 cells_per_side = (f64) ((s64) 1 << level);
+    return Bounding_Box{ -90.0 + 180.0 * y / cells_per_side, -180.0 + 360.0 * x / cells_per_side, -90.0 + 180.0 * (y + 1) / cells_per_side, -180.0 + 360.0 * (x + 1) / cells_per_side };
+}
+
+static inline
+void invalidate_point_tiles(App *app, Bounding_Box box) {
+    if(app->root.leaf || app->root.children[0]) invalidate_tiles(app, box); // New tiles get painted anyway
+}
+
+static inline
+b8 is_valid_record(Point_Record record) {
+    // Also rejects NaN, which marks free slots.
+    return record.lat >= -90.0f && record.lat <= 90.0f && record.lon >= -180.0f && record.lon <= 180.0f;
+}
+
+static
+void reserve_points(App *app, s64 capacity) {
+    Point_Layer *layer = &app->points;
+    if(capacity <= layer->capacity) return;
+
+    Point_Record *records = (Point_Record *) app->allocator.allocate(capacity * sizeof(Point_Record));
+    s32 *next     = (s32 *) app->allocator.allocate(capacity * sizeof(s32));
+    s32 *previous = (s32 *) app->allocator.allocate(capacity * sizeof(s32));
+
+    if(layer->count) {
+        memcpy(records, layer->records, layer->count * sizeof(Point_Record));
+        memcpy(next, layer->next, layer->count * sizeof(s32));
+        memcpy(previous, layer->previous, layer->count * sizeof(s32));
+    }
+
+    if(layer->records) {
+        app->allocator.deallocate(layer->records);
+        app->allocator.deallocate(layer->next);
+        app->allocator.deallocate(layer->previous);
+    }
+
+    layer->records  = records;
+    layer->next     = next;
+    layer->previous = previous;
+    layer->capacity = capacity;
+}
+
+static
+u64 link_point(Point_Layer *layer, s32 slot) {
+    // Chains the point into its cell on the last level and counts it there.
+    s64 x, y;
+    get_tile_position(POINT_LAST_LEVEL, Coordinate{ layer->records[slot].lat, layer->records[slot].lon }, &x, &y);
+    u64 cell = get_cell_index(POINT_LAST_LEVEL, x, y);
+
+    s32 first = layer->cell_points[cell];
+    layer->next[slot]     = first;
+    layer->previous[slot] = -1;
+    if(first >= 0) layer->previous[first] = slot;
+    layer->cell_points[cell] = slot;
+
+    ++layer->counts[POINT_LAST_LEVEL][cell];
+    ++layer->live_count;
+    return cell;
+}
+
+static
+void ingest_records(App *app, Point_Record *records, s64 count) {
+    Point_Layer *layer = &app->points;
+    s64 skipped = 0;
+
+    for(s64 i = 0; i < count; ++i) {
+        if(!is_valid_record(records[i])) {
+            ++skipped;
+            continue;
+        }
+
+        s32 slot = (s32) layer->count;
+        layer->records[slot] = records[i];
+        ++layer->count;
+        link_point(layer, slot);
+    }
+
+    if(skipped) log(LOG_Warning, "Skipped %lld points outside of the world.", skipped);
+}
+
+static
+void aggregate_point_pyramid(App *app) {
+    Point_Layer *layer = &app->points;
+
+    for(s64 level = POINT_LAST_LEVEL - 1; level >= 0; --level) {
+        u32 *parents = layer->counts[level], *children = layer->counts[level + 1];
+        s64 cell_count = (s64) 1 << (level * 2);
+
+        for(s64 i = 0; i < cell_count; ++i) parents[i] = children[i * 4] + children[i * 4 + 1] + children[i * 4 + 2] + children[i * 4 + 3];
+    }
+
+    invalidate_point_tiles(app, Bounding_Box{ -90, -180, 90, 180 });
+}
+
+void create_point_layer(App *app) {
+    Point_Layer *layer = &app->points;
+    *layer = Point_Layer{};
+
+    for(s64 level = 0; level < POINT_LEVELS; ++level) {
+        s64 cell_count = (s64) 1 << (level * 2);
+        layer->counts[level] = (u32 *) app->allocator.allocate(cell_count * sizeof(u32));
+        memset(layer->counts[level], 0, cell_count * sizeof(u32));
+    }
+
+    s64 last_cell_count = (s64) 1 << (POINT_LAST_LEVEL * 2);
+    layer->cell_points = (s32 *) app->allocator.allocate(last_cell_count * sizeof(s32));
+    memset(layer->cell_points, 0xff, last_cell_count * sizeof(s32));
+
+    layer->free_slots = -1;
+}
+
+void destroy_point_layer(App *app) {
+    Point_Layer *layer = &app->points;
+    if(!layer->counts[0]) return;
+
+    for(s64 level = 0; level < POINT_LEVELS; ++level) app->allocator.deallocate(layer->counts[level]);
+    app->allocator.deallocate(layer->cell_points);
+
+    if(layer->records) {
+        app->allocator.deallocate(layer->records);
+        app->allocator.deallocate(layer->next);
+        app->allocator.deallocate(layer->previous);
+    }
+
+    *layer = Point_Layer{};
+}
+
+void add_points(App *app, Point_Record *records, s64 count) {
+    if(!app->points.counts[0]) create_point_layer(app);
+
+    reserve_points(app, app->points.count + count);
+    ingest_records(app, records, count);
+    aggregate_point_pyramid(app);
+}
+
+b8 load_points(App *app, const char *file_path) {
+    FILE *file = fopen(file_path, "rb");
+    if(!file) return false; // Points are optional, the caller decides whether this is an error
+
+    Hardware_Time start = os_get_hardware_time();
+
+    Point_File_Header header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != POINT_FILE_MAGIC || header.version != POINT_FILE_VERSION || header.count < 0 || header.count > 0x7fffffff) {
+        log(LOG_Warning, "'%s' is not a point file.", file_path);
+        fclose(file);
+        return false;
+    }
+
+    if(!app->points.counts[0]) create_point_layer(app);
+    reserve_points(app, app->points.count + header.count);
+
+    Point_Record *block = (Point_Record *) app->allocator.allocate(POINT_INGEST_BLOCK * sizeof(Point_Record));
+    s64 remaining = header.count;
+
+    while(remaining > 0) {
+        s64 size = min<s64>(remaining, POINT_INGEST_BLOCK);
+        s64 read = (s64) fread(block, sizeof(Point_Record), size, file);
+        ingest_records(app, block, read);
+        remaining -= read;
+
+        if(read < size) {
+            log(LOG_Warning, "'%s' ends after %lld of %lld points.", file_path, header.count - remaining, header.count);
+            break;
+        }
+    }
+
+    app->allocator.deallocate(block);
+    fclose(file);
+
+    aggregate_point_pyramid(app);
+
+    Hardware_Time end = os_get_hardware_time();
+    log(LOG_Debug, "Loaded %lld points from '%s': %fms.", header.count - remaining, file_path, os_convert_hardware_time(end - start, Milliseconds));
+    return true;
+}
+
+s64 insert_point(App *app, Coordinate coordinate) {
+    Point_Layer *layer = &app->points;
+    if(!layer->counts[0]) create_point_layer(app);
+
+    Point_Record record = { (f32) coordinate.lat, (f32) coordinate.lon };
+    if(!is_valid_record(record)) return -1;
+
+    s32 slot = layer->free_slots;
+
+    if(slot >= 0) {
+        layer->free_slots = layer->next[slot];
+    } else {
+        if(layer->count == layer->capacity) reserve_points(app, max<s64>(layer->capacity * 2, 1024));
+        slot = (s32) layer->count;
+        ++layer->count;
+    }
+
+    layer->records[slot] = record;
+    u64 cell = link_point(layer, slot);
+
+    for(s64 level = POINT_LAST_LEVEL - 1; level >= 0; --level) ++layer->counts[level][cell >> ((POINT_LAST_LEVEL - level) * 2)];
+
+    s64 x, y;
+    get_tile_position(POINT_LAST_LEVEL, Coordinate{ record.lat, record.lon }, &x, &y);
+    invalidate_point_tiles(app, get_cell_box(POINT_LAST_LEVEL, x, y));
+    return slot;
+}
+
+void remove_point(App *app, s64 id) {
+    Point_Layer *layer = &app->points;
+    if(id < 0 || id >= layer->count || !is_valid_record(layer->records[id])) return;
+
+    s32 slot = (s32) id;
+    Coordinate coordinate = { layer->records[slot].lat, layer->records[slot].lon };
+
+    s64 x, y;
+    get_tile_position(POINT_LAST_LEVEL, coordinate, &x, &y);
+    u64 cell = get_cell_index(POINT_LAST_LEVEL, x, y);
+
+    if(layer->previous[slot] >= 0) {
+        layer->next[layer->previous[slot]] = layer->next[slot];
+    } else {
+        layer->cell_points[cell] = layer->next[slot];
+    }
+
+    if(layer->next[slot] >= 0) layer->previous[layer->next[slot]] = layer->previous[slot];
+
+    for(s64 level = POINT_LAST_LEVEL; level >= 0; --level) --layer->counts[level][cell >> ((POINT_LAST_LEVEL - level) * 2)];
+    --layer->live_count;
+
+    layer->records[slot].lat = NAN;
+    layer->next[slot]  = layer->free_slots;
+    layer->free_slots  = slot;
+
+    invalidate_point_tiles(app, get_cell_box(POINT_LAST_LEVEL, x, y));
+}
+
+
+
+static
+void count_chained_points(Point_Layer *layer, s64 level, s64 x0, s64 y0, s64 side, u32 *counts) {
+    //
+    // Counts the points in the side x side cells of the grid at this level, starting at
+    // x0, y0, by walking the chains of the last level cells covering them.
+    //
+    s64 shift = level - POINT_LAST_LEVEL;
+    s64 first_x = x0 >> shift, first_y = y0 >> shift;
+    s64 last_x = (x0 + side - 1) >> shift, last_y = (y0 + side - 1) >> shift;
+
+    for(s64 cell_y = first_y; cell_y <= last_y; ++cell_y) {
+        for(s64 cell_x = first_x; cell_x <= last_x; ++cell_x) {
+            for(s32 point = layer->cell_points[get_cell_index(POINT_LAST_LEVEL, cell_x, cell_y)]; point >= 0; point = layer->next[point]) {
+                s64 x, y;
+                get_tile_position(level, Coordinate{ layer->records[point].lat, layer->records[point].lon }, &x, &y);
+                if(x >= x0 && x < x0 + side && y >= y0 && y < y0 + side) ++counts[(y - y0) * side + (x - x0)];
+            }
+        }
+    }
+}
+
+u32 count_points(App *app, s64 level, s64 x, s64 y) {
+    Point_Layer *layer = &app->points;
+    if(!layer->counts[0]) return 0;
+
+    if(level <= POINT_LAST_LEVEL) return layer->counts[level][get_cell_index(level, x, y)];
+
+    u32 count = 0;
+    count_chained_points(layer, level, x, y, 1, &count);
+    return count;
+}
+
+b8 point_layer_covers(App *app, Tile *tile) {
+    return count_points(app, tile->level, tile->x, tile->y) > 0;
+}
+
+void paint_points(App *app, Tile *tile, u32 *pixels) {
+    const s64 SIDE  = POINT_CLUSTERS_PER_SIDE;
+    const s64 BLOCK = TILE_TEXTURE_RESOLUTION / POINT_CLUSTERS_PER_SIDE; // Pixels per cluster and side
+
+    Point_Layer *layer = &app->points;
+    if(!point_layer_covers(app, tile)) return;
+
+    s64 level = tile->level + POINT_CLUSTER_LEVELS;
+    s64 x0 = tile->x * SIDE, y0 = tile->y * SIDE;
+    u32 clusters[POINT_CLUSTERS_PER_SIDE * POINT_CLUSTERS_PER_SIDE] = {};
+
+    if(level <= POINT_LAST_LEVEL) {
+        for(s64 y = 0; y < SIDE; ++y) {
+            for(s64 x = 0; x < SIDE; ++x) clusters[y * SIDE + x] = layer->counts[level][get_cell_index(level, x0 + x, y0 + y)];
+        }
+    } else {
+        count_chained_points(layer, level, x0, y0, SIDE, clusters);
+    }
+
+    for(s64 i = 0; i < SIDE * SIDE; ++i) {
+        u32 count = clusters[i];
+        if(!count) continue;
+
+        // One pixel for single points, one more per order of magnitude.
+        s64 size   = min<s64>(1 + (count >= 10) + (count >= 100) + (count >= 1000), BLOCK);
+        s64 offset = (BLOCK - size) / 2;
+        s64 row0 = (i / SIDE) * BLOCK + offset, column0 = (i % SIDE) * BLOCK + offset;
+
+        for(s64 row = row0; row < row0 + size; ++row) {
+            for(s64 column = column0; column < column0 + size; ++column) pixels[row * TILE_TEXTURE_RESOLUTION + column] = POINT_CLUSTER_COLOR;
+        }
+
+        ++layer->stats.clusters_painted;
+    }
+
+    ++layer->stats.tiles_painted;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <foundation.h>
+
+#include "tile.h"
+
+struct App;
+
+//
+// The point layer shows large sets of lat/lon points (sensor positions, events) as
+// clusters painted into the tile textures. Each tile shows a grid of
+// POINT_CLUSTERS_PER_SIDE^2 clusters. Every cluster is a dot whose size grows with
+// the number of points in its cell, so a tile costs the same however many points it
+// covers.
+// The counts come from an aggregation pyramid: A dense count grid per level, up to
+// POINT_LEVELS - 1, in Morton order so that the four children of a cell are adjacent.
+// Points are chained into the cell of the last level they fall into. Cluster cells
+// deeper than that are counted from these chains, which only hold a handful of points
+// each. Inserting or removing a point updates one count per level and invalidates the
+// tiles above it, bulk ingestion counts the last level only and aggregates the
+// pyramid once at the end.
+//
+// Point files start with a Point_File_Header followed by count Point_Records.
+//
+
+#define POINT_LEVELS 12 // 4^11 cells on the last level, 22mb of counts in total
+#define POINT_CLUSTERS_PER_SIDE 4
+#define POINT_CLUSTER_LEVELS 2 // log2(POINT_CLUSTERS_PER_SIDE)
+#define POINT_FILE_MAGIC 0x54505657 // "WVPT"
+#define POINT_FILE_VERSION 1
+#define POINT_INGEST_BLOCK 65536 // Records read from the file at once
+
+struct Point_File_Header {
+    u32 magic;
+    u32 version;
+    s64 count;
+};
+
+struct Point_Record {
+    f32 lat, lon;
+};
+
+struct Point_Layer_Stats {
+    s64 tiles_painted;
+    s64 clusters_painted;
+};
+
+struct Point_Layer {
+    u32 *counts[POINT_LEVELS]; // Points per cell, 4^level cells on each level
+    s32 *cell_points; // First point in each cell of the last level, -1 if empty
+
+    Point_Record *records;
+    s32 *next, *previous; // Chains of the points in a cell, free slots are chained through next
+    s64 count, capacity; // Slots in use, including free ones
+    s64 live_count;
+    s32 free_slots;
+
+    Point_Layer_Stats stats;
+};
+
+void create_point_layer(App *app);
+void destroy_point_layer(App *app);
+
+void add_points(App *app, Point_Record *records, s64 count); // Bulk ingestion, doesn't return ids
+b8 load_points(App *app, const char *file_path);
+s64 insert_point(App *app, Coordinate coordinate); // Returns the id of the point
+void remove_point(App *app, s64 id);
+
+u32 count_points(App *app, s64 level, s64 x, s64 y); // In the cell of the tile grid at this level
+Bounding_Box get_cell_box(s64 level, s64 x, s64 y); // Of the cell of the tile grid at this level
+b8 point_layer_covers(App *app, Tile *tile);
+void paint_points(App *app, Tile *tile, u32 *pixels); // PAINT_TILE_PIXELS, in the layout of paint.h
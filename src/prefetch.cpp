@@ -0,0 +1,131 @@
+// --- C
+#include <math.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <math/maths.h>
+
+// --- App
+#include "app.h"
+#include "tile.h"
+#include "lod.h"
+#include "culling.h"
+#include "pyramid.h"
+#include "prefetch.h"
+#include "simulation.h"
+
+static
+f64 get_longitude_delta(Map_Mode map_mode, f64 from, f64 to) {
+    // The camera takes the short way around the date line on the globe.
+    f64 delta = to - from;
+
+    if(map_mode == MAP_MODE_3D) {
+        if(delta > 180.0) delta -= 360.0;
+        if(delta < -180.0) delta += 360.0;
+    }
+
+    return delta;
+}
+
+static
+Camera predict_camera(App *app, Coordinate center, f64 zoom_level) {
+    center.lat = clamp(center.lat, -90.0, 90.0);
+
+    if(app->map_mode == MAP_MODE_3D) {
+        if(center.lon > 180.0) center.lon -= 360.0;
+        if(center.lon < -180.0) center.lon += 360.0;
+    } else {
+        center.lon = clamp(center.lon, -180.0, 180.0);
+    }
+
+    Camera result = app->camera;
+    result.current_center   = center;
+    result.current_distance = get_camera_distance(&app->camera, app->map_mode, clamp(zoom_level, 0.001, 1.0));
+    update_camera_matrices(&result, app->map_mode);
+    return result;
+}
+
+static
+void read_ahead_children(App *app, Tile *tile) {
+    // The children don't exist yet, but their position in the pyramid is known.
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+        prefetch_tile_pyramid_pixels(&app->imagery, tile->level + 1, tile->x * 2 + i % 2, tile->y * 2 + i / 2);
+    }
+
+    ++app->prefetcher.stats.readaheads;
+}
+
+static
+void prefetch_tile(App *app, Camera *camera, Tile *tile, Cull_Result parent_cull) {
+    Prefetch_Stats *stats = &app->prefetcher.stats;
+
+    Cull_Result cull = cull_tile(camera, app->map_mode, tile, parent_cull);
+    if(cull == CULL_Outside) return;
+
+    f64 error = get_tile_screen_space_error(camera, app->map_mode, tile);
+    if(error < LOD_MERGE_THRESHOLD) return; // The predicted view doesn't need anything below this tile
+
+    if(tile->leaf) {
+        if(tile->level == LOD_MAX_LEVEL || error <= LOD_SPLIT_THRESHOLD) return;
+
+        if(stats->splits < PREFETCH_MAX_SPLITS_PER_FRAME) {
+            subdivide_tile(app, tile, JOB_PRIORITY_Low);
+            ++stats->splits;
+        } else {
+            if(app->imagery.header && stats->readaheads < PREFETCH_MAX_READAHEADS_PER_FRAME) read_ahead_children(app, tile);
+            return;
+        }
+    }
+
+    tile->last_predicted_frame = app->residency.frame_index;
+
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+        prefetch_tile(app, camera, tile->children[i], cull);
+    }
+}
+
+static
+void prefetch_view(App *app, Coordinate center, f64 zoom_level, f64 zoom_delta) {
+    f64 lat_delta = fabs(center.lat - app->camera.current_center.lat);
+    f64 lon_delta = fabs(get_longitude_delta(app->map_mode, app->camera.current_center.lon, center.lon));
+    if(max(max(lat_delta, lon_delta), zoom_delta) < PREFETCH_MIN_DISTANCE) return; // The LOD already takes care of this view
+
+    Camera predicted = predict_camera(app, center, zoom_level);
+    prefetch_tile(app, &predicted, &app->root, CULL_Intersecting);
+    ++app->prefetcher.stats.views;
+}
+
+void prefetch_tiles(App *app) {
+    Prefetcher *prefetcher = &app->prefetcher;
+    Camera *camera = &app->camera;
+
+    prefetcher->stats = Prefetch_Stats{};
+    if(prefetcher->disabled) return;
+
+    if(camera->viewport_height > 0) {
+        //
+        // The destination of the lerps goes first, since the camera gets there for sure.
+        // The zoom level is already the one of the target.
+        //
+        f64 min_distance, max_distance;
+        get_camera_distance_range(camera, app->map_mode, &min_distance, &max_distance);
+        f64 distance_delta = fabs(camera->target_distance - camera->current_distance) / (max_distance - min_distance);
+
+        prefetch_view(app, camera->target_center, camera->zoom_level, distance_delta);
+
+        if(prefetcher->has_previous_target) {
+            // Then where the target is heading if the gesture goes on.
+            Coordinate velocity;
+            velocity.lat = camera->target_center.lat - prefetcher->previous_target_center.lat;
+            velocity.lon = get_longitude_delta(app->map_mode, prefetcher->previous_target_center.lon, camera->target_center.lon);
+            f64 zoom_velocity = camera->zoom_level - prefetcher->previous_zoom_level;
+
+            Coordinate center = { camera->target_center.lat + velocity.lat * PREFETCH_LOOKAHEAD_FRAMES, camera->target_center.lon + velocity.lon * PREFETCH_LOOKAHEAD_FRAMES };
+            prefetch_view(app, center, camera->zoom_level + zoom_velocity * PREFETCH_LOOKAHEAD_FRAMES, fabs(zoom_velocity) * PREFETCH_LOOKAHEAD_FRAMES);
+        }
+    }
+
+    prefetcher->previous_target_center = camera->target_center;
+    prefetcher->previous_zoom_level    = camera->zoom_level;
+    prefetcher->has_previous_target    = true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <foundation.h>
+
+#include "tile.h"
+
+struct App;
+
+//
+// The view of the next frames can be predicted from the camera: It lerps towards its
+// target center and distance, and while a drag or zoom gesture is going on, the target
+// itself keeps moving in the same direction. The prefetcher refines the quadtree for
+// both the lerp destination and the target extrapolated PREFETCH_LOOKAHEAD_FRAMES ahead
+// like the LOD would, but with low priority mesh jobs and a split budget of its own, so
+// that gestures land on tiles which are already there instead of popping them in.
+// Tiles it expects to need are protected from merges and evictions. Leaves it didn't get
+// to in this frame have the imagery of their children read in the background.
+//
+
+#define PREFETCH_LOOKAHEAD_FRAMES 8
+#define PREFETCH_MAX_SPLITS_PER_FRAME 16 // Half of the LOD budget, the current view goes first
+#define PREFETCH_MAX_READAHEADS_PER_FRAME 64 // Leaves whose children get read ahead
+#define PREFETCH_MIN_DISTANCE 0.001 // Predicted views closer than this to the current one (in degrees, or fractions of the zoom range) are skipped
+
+struct Prefetch_Stats {
+    s64 views; // Predicted in this frame
+    s64 splits;
+    s64 readaheads;
+};
+
+struct Prefetcher {
+    Coordinate previous_target_center; // Of the last frame, for the velocity of gestures
+    f64 previous_zoom_level;
+    b8 has_previous_target;
+    b8 disabled; // Leaves everything to the LOD, for comparisons
+
+    Prefetch_Stats stats; // Of the last frame
+};
+
+void prefetch_tiles(App *app); // After the LOD update
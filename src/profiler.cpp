@@ -0,0 +1,138 @@
+// --- C++
+#include <atomic>
+
+// --- C
+#include <stdio.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <os_specific.h>
+
+// --- App
+#include "profiler.h"
+
+#if PROFILER_ENABLED
+
+enum Profile_Event_Kind : s32 {
+    PROFILE_EVENT_Zone,
+    PROFILE_EVENT_Counter,
+};
+
+struct Profile_Event {
+    std::atomic<u64> sequence; // Index + 1 once the event was written, 0 while it is being written
+    Profile_Event_Kind kind;
+    s32 thread;
+    const char *name;
+    Hardware_Time start;
+    s64 value; // The end time of zones, the value of counters
+};
+
+const char *PROFILE_COUNTER_NAMES[PROFILE_COUNTER_COUNT] = {
+    "Tiles created",
+    "Tiles destroyed",
+    "Tiles drawn",
+    "Draw calls",
+    "Bytes uploaded",
+    "Microseconds saved",
+};
+
+Profile_Event profile_events[PROFILER_EVENT_CAPACITY];
+std::atomic<u64> profile_event_count;
+std::atomic<s64> profile_counters[PROFILE_COUNTER_COUNT];
+std::atomic<s32> profile_thread_count;
+thread_local s32 profile_thread = -1;
+Hardware_Time profile_epoch = os_get_hardware_time(); // Trace timestamps start at program startup
+
+static
+void record_profile_event(Profile_Event_Kind kind, const char *name, Hardware_Time start, s64 value) {
+    if(profile_thread < 0) profile_thread = profile_thread_count.fetch_add(1, std::memory_order_relaxed);
+
+    u64 index = profile_event_count.fetch_add(1, std::memory_order_relaxed);
+    Profile_Event *event = &profile_events[index & (PROFILER_EVENT_CAPACITY - 1)];
+
+    // Readers skip the slot until the new sequence number is published.
+    event->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    event->kind   = kind;
+    event->thread = profile_thread;
+    event->name   = name;
+    event->start  = start;
+    event->value  = value;
+    event->sequence.store(index + 1, std::memory_order_release);
+}
+
+Profile_Scope::Profile_Scope(const char *name) {
+    this->name  = name;
+    this->start = os_get_hardware_time();
+}
+
+Profile_Scope::~Profile_Scope() {
+    record_profile_zone(this->name, this->start, os_get_hardware_time());
+}
+
+void record_profile_zone(const char *name, Hardware_Time start, Hardware_Time end) {
+    record_profile_event(PROFILE_EVENT_Zone, name, start, end);
+}
+
+void add_profile_counter(Profile_Counter counter, s64 value) {
+    profile_counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+void finish_profile_frame() {
+    Hardware_Time now = os_get_hardware_time();
+
+    for(s64 i = 0; i < PROFILE_COUNTER_COUNT; ++i) {
+        record_profile_event(PROFILE_EVENT_Counter, PROFILE_COUNTER_NAMES[i], now, profile_counters[i].exchange(0, std::memory_order_relaxed));
+    }
+}
+
+b8 write_chrome_trace(const char *file_path) {
+    //
+    // Events which are overwritten while this runs fail the sequence check and are
+    // left out, so this can be called at any time, e.g. right after a slow frame.
+    //
+    FILE *file = fopen(file_path, "w");
+    if(!file) return false;
+
+    u64 count = profile_event_count.load(std::memory_order_acquire);
+    u64 first = count > PROFILER_EVENT_CAPACITY ? count - PROFILER_EVENT_CAPACITY : 0;
+
+    b8 first_event = true;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+
+    for(u64 index = first; index < count; ++index) {
+        Profile_Event *event = &profile_events[index & (PROFILER_EVENT_CAPACITY - 1)];
+        if(event->sequence.load(std::memory_order_acquire) != index + 1) continue;
+
+        Profile_Event copy;
+        copy.kind   = event->kind;
+        copy.thread = event->thread;
+        copy.name   = event->name;
+        copy.start  = event->start;
+        copy.value  = event->value;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(event->sequence.load(std::memory_order_relaxed) != index + 1) continue;
+
+        f64 timestamp = os_convert_hardware_time(copy.start - profile_epoch, Microseconds);
+
+        if(!first_event) fprintf(file, ",\n");
+        first_event = false;
+
+        if(copy.kind == PROFILE_EVENT_Zone) {
+            f64 duration = os_convert_hardware_time(copy.value - copy.start, Microseconds);
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", copy.name, copy.thread, timestamp, duration);
+        } else {
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%lld}}", copy.name, copy.thread, timestamp, copy.value);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    b8 written = !ferror(file);
+    fclose(file);
+    return written;
+}
+
+#endif
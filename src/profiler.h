@@ -0,0 +1,64 @@
+#pragma once
+
+#include <foundation.h>
+#include <os_specific.h>
+
+//
+// The profiler records scoped zones and per-frame counters into a lock-free ring
+// buffer, from any thread. Writers claim a slot with a single atomic increment and
+// publish it through its sequence number, so recording never blocks and old events
+// are simply overwritten. write_chrome_trace exports the events still in the ring as
+// Chrome trace JSON (chrome://tracing, Perfetto), in which a slow frame shows up as
+// one wide "Frame" zone with the zones and counters that made it slow.
+// Outside of developer builds PROFILER_ENABLED is false, and the macros below
+// compile to nothing.
+//
+
+#ifndef PROFILER_ENABLED
+# ifdef FOUNDATION_DEVELOPER
+#  define PROFILER_ENABLED true
+# else
+#  define PROFILER_ENABLED false
+# endif
+#endif
+
+#define PROFILER_EVENT_CAPACITY 65536 // Must be a power of two
+
+enum Profile_Counter {
+    PROFILE_COUNTER_Tiles_Created,
+    PROFILE_COUNTER_Tiles_Destroyed,
+    PROFILE_COUNTER_Tiles_Drawn,
+    PROFILE_COUNTER_Draw_Calls,
+    PROFILE_COUNTER_Bytes_Uploaded,
+    PROFILE_COUNTER_Microseconds_Saved, // By not drawing while idle, see scheduler.h
+    PROFILE_COUNTER_COUNT,
+};
+
+#if PROFILER_ENABLED
+
+struct Profile_Scope {
+    const char *name; // Must be a string literal, only the pointer is recorded
+    Hardware_Time start;
+
+    Profile_Scope(const char *name);
+    ~Profile_Scope();
+};
+
+void record_profile_zone(const char *name, Hardware_Time start, Hardware_Time end);
+void add_profile_counter(Profile_Counter counter, s64 value);
+void finish_profile_frame(); // Records the counters of this frame and resets them
+b8 write_chrome_trace(const char *file_path);
+
+# define PROFILE_CONCAT_(lhs, rhs) lhs##rhs
+# define PROFILE_CONCAT(lhs, rhs) PROFILE_CONCAT_(lhs, rhs)
+# define PROFILE_ZONE(name) Profile_Scope PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+# define PROFILE_COUNT(counter, value) add_profile_counter(counter, value)
+# define PROFILE_FRAME() finish_profile_frame()
+
+#else
+
+# define PROFILE_ZONE(name)
+# define PROFILE_COUNT(counter, value)
+# define PROFILE_FRAME()
+
+#endif
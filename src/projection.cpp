@@ -0,0 +1,61 @@
+// --- C
+#include <math.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <math/maths.h>
+#include <math/v3.h>
+
+// --- App
+#include "app.h"
+#include "projection.h"
+
+v3f world_from_coordinate_space(Map_Mode map_mode, f64 lat, f64 lon) {
+    switch(map_mode) {
+    case MAP_MODE_2D: return { (f32) (lon / 90.0) * WORLD_SCALE_2D, (f32) (lat / 90.0) * WORLD_SCALE_2D, 0 };
+    case MAP_MODE_3D: return globe_from_coordinate_space(lat, lon, WORLD_SCALE_3D);
+    }
+
+    return v3f(0, 0, 0);
+}
+
+v3f globe_from_coordinate_space(f64 lat, f64 lon, f64 radius) {
+    f64 theta = degrees_to_radians(lon);
+    f64 sigma = degrees_to_radians(lat);
+    return { (f32) (sin(theta) * cos(sigma) * radius), (f32) (sin(sigma) * radius), (f32) (cos(theta) * cos(sigma) * radius) };
+}
+
+Coordinate coordinate_from_world_space(Map_Mode map_mode, v3f position) {
+    switch(map_mode) {
+    case MAP_MODE_2D: return Coordinate{ position.y / WORLD_SCALE_2D * 90.0, position.x / WORLD_SCALE_2D * 90.0 };
+
+    case MAP_MODE_3D: {
+        f64 length = v3_length(position);
+        if(length == 0) return Coordinate{ 0, 0 };
+
+        f64 lat = asin(clamp(position.y / length, -1.0, 1.0));
+        f64 lon = atan2((f64) position.x, (f64) position.z);
+        return Coordinate{ radians_to_degrees(lat), radians_to_degrees(lon) };
+    }
+    }
+
+    return Coordinate{ 0, 0 };
+}
+
+v3f world_from_tile_space(Map_Mode map_mode, v3f position) {
+    switch(map_mode) {
+    case MAP_MODE_2D: return world_from_coordinate_space(MAP_MODE_2D, position.y, position.x);
+    case MAP_MODE_3D: return globe_from_coordinate_space(position.y, position.x, WORLD_SCALE_3D + position.z);
+    }
+
+    return v3f(0, 0, 0);
+}
+
+v3f morph_from_coordinate_space(Map_Morph *morph, f64 lat, f64 lon, f64 height) {
+    // The flat map keeps the equirectangular scale of the 2D mode, so it is stretched
+    // east-west compared to the globe away from the equator.
+    f64 scale = degrees_to_radians(WORLD_SCALE_3D);
+    v3f flat  = morph->origin + morph->east * (f32) ((lon - morph->center.lon) * scale) + morph->north * (f32) ((lat - morph->center.lat) * scale);
+    v3f globe = globe_from_coordinate_space(lat, lon, WORLD_SCALE_3D + height);
+    return flat * (1 - morph->globe) + globe * morph->globe;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <foundation.h>
+#include <math/v3.h>
+
+struct Coordinate;
+struct Map_Morph;
+enum Map_Mode : s32;
+
+//
+// Conversion from geographic coordinates (in degrees) to world space. The 2D map is an
+// equirectangular projection scaled by WORLD_SCALE_2D, the 3D globe a sphere of radius
+// WORLD_SCALE_3D with lon 0 / lat 0 on the +z axis and the north pole on +y.
+//
+
+v3f world_from_coordinate_space(Map_Mode map_mode, f64 lat, f64 lon);
+v3f globe_from_coordinate_space(f64 lat, f64 lon, f64 radius); // Along the surface normal of the globe, independent of the map mode
+Coordinate coordinate_from_world_space(Map_Mode map_mode, v3f position); // The inverse of world_from_coordinate_space for points on the map
+v3f world_from_tile_space(Map_Mode map_mode, v3f position); // Of a tile mesh vertex, see Vertices
+v3f morph_from_coordinate_space(Map_Morph *morph, f64 lat, f64 lon, f64 height); // Between the flat map and the globe, see Map_Morph
@@ -0,0 +1,350 @@
+// --- C
+#if FOUNDATION_WIN32
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <math/maths.h>
+
+// --- App
+#include "app.h"
+#include "pyramid.h"
+
+#define PYRAMID_TILE_PIXELS (TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_RESOLUTION)
+
+struct Pyramid_Builder {
+    Pyramid_Raster raster;
+    s64 max_level;
+
+    FILE *output;
+    s64 offset; // Bytes written so far
+    b8 failed;
+
+    Tile_Pyramid_Entry *entries;
+    s64 entry_count;
+    s64 entry_capacity;
+};
+
+static inline
+u64 spread_bits(u64 value) {
+    // Moves bit i of a 32-bit value to bit 2 * i.
+    value &= 0xffffffff;
+    value = (value | (value << 16)) & 0x0000ffff0000ffff;
+    value = (value | (value << 8))  & 0x00ff00ff00ff00ff;
+    value = (value | (value << 4))  & 0x0f0f0f0f0f0f0f0f;
+    value = (value | (value << 2))  & 0x3333333333333333;
+    value = (value | (value << 1))  & 0x5555555555555555;
+    return value;
+}
+
+u64 get_tile_pyramid_key(s64 level, s64 x, s64 y) {
+    // The x bit of each level comes first, like the child order of subdivide_tile.
+    return ((u64) level << 58) | spread_bits((u64) x) | (spread_bits((u64) y) << 1);
+}
+
+static
+b8 map_file(Tile_Pyramid *pyramid, const char *file_path) {
+#if FOUNDATION_WIN32
+    HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, null, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, null);
+    if(file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = null;
+    void *base     = null;
+
+    if(GetFileSizeEx(file, &size) && size.QuadPart > 0) mapping = CreateFileMappingA(file, null, PAGE_READONLY, 0, 0, null);
+    if(mapping) base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if(!base) {
+        if(mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    pyramid->base    = (u8 *) base;
+    pyramid->size    = size.QuadPart;
+    pyramid->file    = file;
+    pyramid->mapping = mapping;
+    return true;
+#else
+    int file = open(file_path, O_RDONLY);
+    if(file < 0) return false;
+
+    struct stat status;
+    void *base = MAP_FAILED;
+
+    if(fstat(file, &status) == 0 && status.st_size > 0) base = mmap(null, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    close(file); // The mapping keeps the file alive
+
+    if(base == MAP_FAILED) return false;
+
+    // Tiles are looked up all over the file, read-ahead would mostly page in tiles nobody asked for.
+    madvise(base, status.st_size, MADV_RANDOM);
+
+    pyramid->base = (u8 *) base;
+    pyramid->size = status.st_size;
+    return true;
+#endif
+}
+
+static
+void unmap_file(Tile_Pyramid *pyramid) {
+#if FOUNDATION_WIN32
+    UnmapViewOfFile(pyramid->base);
+    CloseHandle(pyramid->mapping);
+    CloseHandle(pyramid->file);
+#else
+    munmap(pyramid->base, pyramid->size);
+#endif
+}
+
+b8 open_tile_pyramid(Tile_Pyramid *pyramid, const char *file_path) {
+    *pyramid = Tile_Pyramid{};
+
+    if(!map_file(pyramid, file_path)) return false; // Imagery is optional, the caller decides whether this is an error
+
+    //
+    // Only the header is validated here. Touching the index or the pixels would page
+    // them in, which is what the mapping is supposed to avoid.
+    //
+    Tile_Pyramid_Header *header = (Tile_Pyramid_Header *) pyramid->base;
+    s64 tile_size = TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_CHANNELS;
+
+    b8 valid = pyramid->size >= (s64) sizeof(Tile_Pyramid_Header) &&
+        header->magic == PYRAMID_MAGIC && header->version == PYRAMID_VERSION &&
+        header->tile_resolution == TILE_TEXTURE_RESOLUTION && header->channels == TILE_TEXTURE_CHANNELS &&
+        header->max_level >= 0 && header->max_level <= PYRAMID_MAX_LEVEL &&
+        header->tile_count >= 0 && header->tile_count <= pyramid->size / (s64) sizeof(Tile_Pyramid_Entry) &&
+        header->index_offset >= (s64) sizeof(Tile_Pyramid_Header) && header->index_offset <= pyramid->size && header->index_offset % alignof(Tile_Pyramid_Entry) == 0 &&
+        header->index_offset + header->tile_count * (s64) sizeof(Tile_Pyramid_Entry) <= pyramid->size &&
+        header->index_offset >= (s64) sizeof(Tile_Pyramid_Header) + header->tile_count * tile_size;
+
+    if(!valid) {
+        log(LOG_Warning, "'%s' is not a tile pyramid for %dx%d tiles with %d channels.", file_path, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_CHANNELS);
+        close_tile_pyramid(pyramid);
+        return false;
+    }
+
+    pyramid->header = header;
+    pyramid->index  = (Tile_Pyramid_Entry *) (pyramid->base + header->index_offset);
+
+    log(LOG_Debug, "Opened the tile pyramid '%s' (%lld tiles, levels 0 to %lld, %fmb).", file_path, header->tile_count, header->max_level, convert_to_memory_unit(pyramid->size, Megabytes));
+    return true;
+}
+
+void close_tile_pyramid(Tile_Pyramid *pyramid) {
+    if(pyramid->base) unmap_file(pyramid);
+    *pyramid = Tile_Pyramid{};
+}
+
+u32 *find_tile_pyramid_pixels(Tile_Pyramid *pyramid, s64 level, s64 x, s64 y) {
+    if(!pyramid->header || level > pyramid->header->max_level) return null;
+
+    u64 key = get_tile_pyramid_key(level, x, y);
+    s64 tile_size = TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_CHANNELS;
+
+    s64 low = 0, high = pyramid->header->tile_count;
+
+    while(low < high) {
+        s64 middle = low + (high - low) / 2;
+        if(pyramid->index[middle].key < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if(low == pyramid->header->tile_count || pyramid->index[low].key != key) return null;
+
+    s64 offset = pyramid->index[low].offset;
+    if(offset < (s64) sizeof(Tile_Pyramid_Header) || offset % PYRAMID_TILE_ALIGNMENT != 0 || offset + tile_size > pyramid->header->index_offset) return null; // Corrupt entry
+
+    return (u32 *) (pyramid->base + offset);
+}
+
+u32 *find_tile_pyramid_pixels(Tile_Pyramid *pyramid, Tile *tile) {
+    return find_tile_pyramid_pixels(pyramid, tile->level, tile->x, tile->y);
+}
+
+void prefetch_tile_pyramid_pixels(Tile_Pyramid *pyramid, s64 level, s64 x, s64 y) {
+    u8 *pixels = (u8 *) find_tile_pyramid_pixels(pyramid, level, x, y);
+    if(!pixels) return;
+
+    s64 tile_size = TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_RESOLUTION * TILE_TEXTURE_CHANNELS;
+
+#if FOUNDATION_WIN32
+    WIN32_MEMORY_RANGE_ENTRY range = { pixels, (SIZE_T) tile_size };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    // The advice has to start on a page boundary.
+    u64 page_size = (u64) sysconf(_SC_PAGESIZE);
+    u8 *start = (u8 *) ((u64) pixels & ~(page_size - 1));
+    madvise(start, pixels + tile_size - start, MADV_WILLNEED);
+#endif
+}
+
+
+
+static
+void sample_raster(Pyramid_Raster *raster, s64 level, s64 x, s64 y, u32 *pixels) {
+    f64 tiles_per_side = (f64) ((s64) 1 << level);
+
+    for(s64 row = 0; row < TILE_TEXTURE_RESOLUTION; ++row) {
+        // Tile rows go from south to north, raster rows from north to south.
+        f64 south = (y + (f64) row / TILE_TEXTURE_RESOLUTION) / tiles_per_side;
+        f64 north = (y + (f64) (row + 1) / TILE_TEXTURE_RESOLUTION) / tiles_per_side;
+        s64 y0 = (s64) floor((1.0 - north) * raster->height + 0.5);
+        s64 y1 = (s64) floor((1.0 - south) * raster->height + 0.5);
+        y0 = clamp(y0, 0, raster->height - 1);
+        y1 = clamp(y1, y0 + 1, raster->height);
+
+        for(s64 column = 0; column < TILE_TEXTURE_RESOLUTION; ++column) {
+            f64 west = (x + (f64) column / TILE_TEXTURE_RESOLUTION) / tiles_per_side;
+            f64 east = (x + (f64) (column + 1) / TILE_TEXTURE_RESOLUTION) / tiles_per_side;
+            s64 x0 = (s64) floor(west * raster->width + 0.5);
+            s64 x1 = (s64) floor(east * raster->width + 0.5);
+            x0 = clamp(x0, 0, raster->width - 1);
+            x1 = clamp(x1, x0 + 1, raster->width); // At least the nearest pixel when upsampling
+
+            u64 sums[3] = { 0, 0, 0 };
+            for(s64 i = y0; i < y1; ++i) {
+                u8 *source = &raster->pixels[(i * raster->width + x0) * 3];
+                for(s64 j = x0; j < x1; ++j, source += 3) {
+                    sums[0] += source[0];
+                    sums[1] += source[1];
+                    sums[2] += source[2];
+                }
+            }
+
+            u64 count = (u64) ((y1 - y0) * (x1 - x0));
+            u32 r = (u32) ((sums[0] + count / 2) / count);
+            u32 g = (u32) ((sums[1] + count / 2) / count);
+            u32 b = (u32) ((sums[2] + count / 2) / count);
+            pixels[row * TILE_TEXTURE_RESOLUTION + column] = r | (g << 8) | (b << 16) | (255u << 24);
+        }
+    }
+}
+
+static
+void downsample_children(u32 children[4][PYRAMID_TILE_PIXELS], u32 *pixels) {
+    const s64 HALF = TILE_TEXTURE_RESOLUTION / 2;
+
+    for(s64 row = 0; row < TILE_TEXTURE_RESOLUTION; ++row) {
+        for(s64 column = 0; column < TILE_TEXTURE_RESOLUTION; ++column) {
+            // Children are ordered like in subdivide_tile: west before east, south before north.
+            u32 *child = children[(row / HALF) * 2 + column / HALF];
+            s64 child_row = (row % HALF) * 2, child_column = (column % HALF) * 2;
+
+            u32 texels[4] = { child[child_row * TILE_TEXTURE_RESOLUTION + child_column], child[child_row * TILE_TEXTURE_RESOLUTION + child_column + 1],
+                              child[(child_row + 1) * TILE_TEXTURE_RESOLUTION + child_column], child[(child_row + 1) * TILE_TEXTURE_RESOLUTION + child_column + 1] };
+
+            u32 result = 0;
+            for(s64 channel = 0; channel < 4; ++channel) {
+                u32 sum = 0;
+                for(s64 i = 0; i < 4; ++i) sum += (texels[i] >> (channel * 8)) & 0xff;
+                result |= ((sum + 2) / 4) << (channel * 8);
+            }
+
+            pixels[row * TILE_TEXTURE_RESOLUTION + column] = result;
+        }
+    }
+}
+
+static
+void write_bytes(Pyramid_Builder *builder, void *data, s64 size) {
+    // After a failed write the rest is skipped, build_tile_pyramid reports it.
+    if(builder->failed || fwrite(data, 1, size, builder->output) != (size_t) size) {
+        builder->failed = true;
+        return;
+    }
+
+    builder->offset += size;
+}
+
+static
+void align_output(Pyramid_Builder *builder, s64 alignment) {
+    u8 zeros[PYRAMID_TILE_ALIGNMENT] = {};
+    s64 padding = (alignment - builder->offset % alignment) % alignment;
+    write_bytes(builder, zeros, padding);
+}
+
+static
+void write_tile(Pyramid_Builder *builder, s64 level, s64 x, s64 y, u32 *pixels) {
+    if(builder->entry_count == builder->entry_capacity) {
+        builder->entry_capacity = max<s64>(builder->entry_capacity * 2, 1024);
+        builder->entries = (Tile_Pyramid_Entry *) realloc(builder->entries, builder->entry_capacity * sizeof(Tile_Pyramid_Entry));
+    }
+
+    align_output(builder, PYRAMID_TILE_ALIGNMENT);
+    builder->entries[builder->entry_count] = Tile_Pyramid_Entry{ get_tile_pyramid_key(level, x, y), builder->offset };
+    ++builder->entry_count;
+
+    write_bytes(builder, pixels, PYRAMID_TILE_PIXELS * sizeof(u32));
+}
+
+static
+void build_tile(Pyramid_Builder *builder, s64 level, s64 x, s64 y, u32 *pixels) {
+    if(level == builder->max_level) {
+        sample_raster(&builder->raster, level, x, y, pixels);
+    } else {
+        u32 children[4][PYRAMID_TILE_PIXELS];
+
+        for(s64 i = 0; i < 4; ++i) {
+            build_tile(builder, level + 1, x * 2 + i % 2, y * 2 + i / 2, children[i]);
+        }
+
+        downsample_children(children, pixels);
+    }
+
+    write_tile(builder, level, x, y, pixels);
+}
+
+static
+int compare_entries(const void *lhs, const void *rhs) {
+    u64 a = ((Tile_Pyramid_Entry *) lhs)->key, b = ((Tile_Pyramid_Entry *) rhs)->key;
+    return (a > b) - (a < b);
+}
+
+b8 build_tile_pyramid(const char *file_path, Pyramid_Raster raster, s64 max_level, s64 *file_size) {
+    Pyramid_Builder builder = {};
+    builder.raster    = raster;
+    builder.max_level = max_level;
+    builder.output    = fopen(file_path, "wb");
+    if(!builder.output) return false;
+
+    Tile_Pyramid_Header header = {};
+    write_bytes(&builder, &header, sizeof(header)); // Filled in once the index is known
+
+    u32 root[PYRAMID_TILE_PIXELS];
+    build_tile(&builder, 0, 0, 0, root);
+
+    qsort(builder.entries, builder.entry_count, sizeof(Tile_Pyramid_Entry), compare_entries);
+
+    align_output(&builder, alignof(Tile_Pyramid_Entry));
+    header.magic           = PYRAMID_MAGIC;
+    header.version         = PYRAMID_VERSION;
+    header.tile_resolution = TILE_TEXTURE_RESOLUTION;
+    header.channels        = TILE_TEXTURE_CHANNELS;
+    header.max_level       = builder.max_level;
+    header.tile_count      = builder.entry_count;
+    header.index_offset    = builder.offset;
+    write_bytes(&builder, builder.entries, builder.entry_count * sizeof(Tile_Pyramid_Entry));
+
+    b8 written = !builder.failed && fseek(builder.output, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, builder.output) == 1;
+    written &= fclose(builder.output) == 0;
+
+    free(builder.entries);
+
+    if(file_size) *file_size = builder.offset;
+    return written;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <foundation.h>
+
+struct Tile;
+
+//
+// Tile pyramids hold pre-built imagery for the quadtree on disk. A tile is addressed by
+// its level and its x (west to east) and y (south to north) position in the 2^level by
+// 2^level grid of that level, which matches how subdivide_tile splits the world. Every
+// tile stores TILE_TEXTURE_RESOLUTION^2 RGBA8 pixels in the layout of paint.h.
+//
+// File layout:
+//   Tile_Pyramid_Header
+//   Pixel data of all tiles, PYRAMID_TILE_ALIGNMENT aligned, in the order of the builder
+//   Index of tile_count Tile_Pyramid_Entry, sorted by key
+//
+// The file is memory mapped and nothing is read up front, so opening a pyramid is
+// instant whatever its size. Lookups binary search the mapped index, and the returned
+// pixels point straight into the mapping, so only the pages of touched tiles (and the
+// index pages on their search path) are ever read from disk.
+// Pyramids are built offline by WorldView_Pyramid (pyramid_builder.cpp), through
+// build_tile_pyramid. It builds the quadtree depth first: Tiles on the last level box
+// filter the raster pixels they cover, every other tile is downsampled from its four
+// children. That way each raster pixel is read once and only one tile per level is kept
+// in memory, so rasters far larger than memory work as well when they are mapped.
+//
+
+#define PYRAMID_MAGIC 0x50545657 // "WVTP"
+#define PYRAMID_VERSION 1
+#define PYRAMID_MAX_LEVEL 29 // Keys hold the level and 2 * level bits of position
+#define PYRAMID_TILE_ALIGNMENT 64
+
+struct Tile_Pyramid_Header {
+    u32 magic;
+    u32 version;
+    u32 tile_resolution;
+    u32 channels;
+    s64 max_level;
+    s64 tile_count;
+    s64 index_offset; // In bytes from the start of the file
+};
+
+struct Tile_Pyramid_Entry {
+    u64 key; // See get_tile_pyramid_key
+    s64 offset; // Of the pixels, in bytes from the start of the file
+};
+
+struct Pyramid_Raster {
+    u8 *pixels; // RGB8 of an equirectangular image of the whole world, rows from north to south
+    s64 width, height;
+};
+
+struct Tile_Pyramid {
+    u8 *base;
+    s64 size;
+
+    Tile_Pyramid_Header *header;
+    Tile_Pyramid_Entry *index;
+
+#if FOUNDATION_WIN32
+    void *file;
+    void *mapping;
+#endif
+};
+
+u64 get_tile_pyramid_key(s64 level, s64 x, s64 y); // The level in the top bits, then the Morton code of x and y
+
+b8 open_tile_pyramid(Tile_Pyramid *pyramid, const char *file_path);
+void close_tile_pyramid(Tile_Pyramid *pyramid);
+u32 *find_tile_pyramid_pixels(Tile_Pyramid *pyramid, s64 level, s64 x, s64 y); // Null if the pyramid doesn't contain this tile
+u32 *find_tile_pyramid_pixels(Tile_Pyramid *pyramid, Tile *tile);
+void prefetch_tile_pyramid_pixels(Tile_Pyramid *pyramid, s64 level, s64 x, s64 y); // Has the OS read the pixels in the background, if the pyramid contains this tile
+
+b8 build_tile_pyramid(const char *file_path, Pyramid_Raster raster, s64 max_level, s64 *file_size); // False if the file couldn't be written
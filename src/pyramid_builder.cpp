@@ -0,0 +1,128 @@
+// --- C
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <os_specific.h>
+#include <math/maths.h>
+
+// --- App
+#include "app.h"
+#include "lod.h"
+#include "pyramid.h"
+
+//
+// Builds a tile pyramid (see pyramid.h) from an equirectangular raster of the whole
+// world, north up, as a binary PPM. The raster is memory mapped and handed to
+// build_tile_pyramid, which reads each of its pixels once.
+// Usage: WorldView_Pyramid input.ppm output.wvp [max_level]
+//
+
+struct Raster {
+    u8 *file;
+    s64 file_size;
+    Pyramid_Raster image;
+};
+
+static
+b8 read_ppm_number(Raster *raster, s64 *cursor, s64 *value) {
+    // Skips whitespace and comments, then reads a decimal number.
+    while(*cursor < raster->file_size) {
+        u8 character = raster->file[*cursor];
+        if(character == '#') {
+            while(*cursor < raster->file_size && raster->file[*cursor] != '\n') ++*cursor;
+        } else if(isspace(character)) {
+            ++*cursor;
+        } else {
+            break;
+        }
+    }
+
+    if(*cursor == raster->file_size || !isdigit(raster->file[*cursor])) return false;
+
+    *value = 0;
+    while(*cursor < raster->file_size && isdigit(raster->file[*cursor])) {
+        *value = *value * 10 + (raster->file[*cursor] - '0');
+        ++*cursor;
+    }
+
+    return true;
+}
+
+static
+b8 open_raster(Raster *raster, const char *file_path) {
+    int file = open(file_path, O_RDONLY);
+    if(file < 0) return false;
+
+    struct stat status;
+    void *base = MAP_FAILED;
+    if(fstat(file, &status) == 0 && status.st_size > 0) base = mmap(null, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if(base == MAP_FAILED) return false;
+
+    raster->file      = (u8 *) base;
+    raster->file_size = status.st_size;
+
+    Pyramid_Raster *image = &raster->image;
+    s64 cursor = 2, max_value = 0;
+    b8 valid = raster->file_size > 2 && raster->file[0] == 'P' && raster->file[1] == '6' &&
+        read_ppm_number(raster, &cursor, &image->width) && read_ppm_number(raster, &cursor, &image->height) && read_ppm_number(raster, &cursor, &max_value) &&
+        max_value == 255 && image->width > 0 && image->height > 0;
+
+    ++cursor; // The single whitespace character before the pixels
+
+    if(!valid || cursor + image->width * image->height * 3 > raster->file_size) {
+        munmap(raster->file, raster->file_size);
+        return false;
+    }
+
+    image->pixels = raster->file + cursor;
+
+    // The leaves walk the raster roughly in order, unlike the pyramid reader.
+    madvise(raster->file, raster->file_size, MADV_SEQUENTIAL);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 3) {
+        printf("Usage: %s input.ppm output.wvp [max_level]\n", argv[0]);
+        return 1;
+    }
+
+    os_enable_high_resolution_clock();
+    Hardware_Time start = os_get_hardware_time();
+
+    Raster raster = {};
+
+    if(!open_raster(&raster, argv[1])) {
+        printf("Failed to read %s, expected a binary PPM with 8 bits per channel.\n", argv[1]);
+        return 1;
+    }
+
+    // By default, go deep enough for the leaves to show every raster pixel.
+    s64 max_level = 0;
+    while(max_level < LOD_MAX_LEVEL && ((s64) TILE_TEXTURE_RESOLUTION << max_level) < raster.image.width) ++max_level;
+    if(argc > 3) max_level = clamp(atoi(argv[3]), 0, PYRAMID_MAX_LEVEL);
+
+    s64 file_size = 0;
+    b8 written = build_tile_pyramid(argv[2], raster.image, max_level, &file_size);
+    munmap(raster.file, raster.file_size);
+
+    if(!written) {
+        printf("Failed to write %s.\n", argv[2]);
+        return 1;
+    }
+
+    s64 tile_count = (((s64) 1 << (2 * max_level + 2)) - 1) / 3; // Every tile of every level
+    Hardware_Time end = os_get_hardware_time();
+    printf("Wrote %s (%lldx%lld raster, levels 0 to %lld, %lld tiles, %fmb in %fs).\n", argv[2], raster.image.width, raster.image.height, max_level, tile_count,
+           convert_to_memory_unit(file_size, Megabytes), os_convert_hardware_time(end - start, Seconds));
+    return 0;
+}
@@ -0,0 +1,175 @@
+// --- C
+#include <stdio.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <memutils.h>
+
+// --- App
+#include "app.h"
+#include "replay.h"
+
+static inline
+s16 clamp_to_s16(s32 value) {
+    return (s16) clamp(value, -32768, 32767);
+}
+
+static inline
+u16 quantize_frame_time(f64 frame_time) {
+    return (u16) clamp(frame_time / INPUT_FRAME_TIME_UNIT + 0.5, 1.0, 65535.0);
+}
+
+static
+Input_Run make_input_run(Frame_Input *input) {
+    Input_Run run = {};
+    run.frames            = 1;
+    run.viewport_width    = clamp_to_s16(input->viewport_width);
+    run.viewport_height   = clamp_to_s16(input->viewport_height);
+    run.mouse_x           = clamp_to_s16(input->mouse_x);
+    run.mouse_y           = clamp_to_s16(input->mouse_y);
+    run.mouse_delta_x     = clamp_to_s16(input->mouse_delta_x);
+    run.mouse_delta_y     = clamp_to_s16(input->mouse_delta_y);
+    run.frame_time        = quantize_frame_time(input->frame_time);
+    run.flags             = (input->dragging ? INPUT_Dragging : 0) | (input->toggle_map_mode ? INPUT_Toggle_Map_Mode : 0);
+    run.mouse_wheel_turns = input->mouse_wheel_turns;
+    return run;
+}
+
+static inline
+b8 extends_input_run(Input_Run *run, Input_Run *next) {
+    return run->frames < 0xffff &&
+        run->viewport_width == next->viewport_width && run->viewport_height == next->viewport_height &&
+        run->mouse_x == next->mouse_x && run->mouse_y == next->mouse_y &&
+        run->mouse_delta_x == next->mouse_delta_x && run->mouse_delta_y == next->mouse_delta_y &&
+        run->frame_time == next->frame_time && run->flags == next->flags && run->mouse_wheel_turns == next->mouse_wheel_turns;
+}
+
+b8 begin_input_recording(Input_Recorder *recorder, App *app, const char *file_path) {
+    *recorder = Input_Recorder{};
+
+    recorder->file = fopen(file_path, "wb");
+    if(!recorder->file) {
+        log(LOG_Warning, "Failed to create the input recording '%s'.", file_path);
+        return false;
+    }
+
+    Input_Recording_Header *header = &recorder->header;
+    header->magic      = INPUT_RECORDING_MAGIC;
+    header->version    = INPUT_RECORDING_VERSION;
+    header->map_mode   = app->map_mode;
+    header->center_lat = app->camera.target_center.lat;
+    header->center_lon = app->camera.target_center.lon;
+    header->zoom_level = app->camera.zoom_level;
+
+    // The counts are patched in by end_input_recording.
+    fwrite(header, sizeof(Input_Recording_Header), 1, recorder->file);
+
+    log(LOG_Debug, "Recording the input to '%s'.", file_path);
+    return true;
+}
+
+void record_input_frame(Input_Recorder *recorder, Frame_Input *input) {
+    if(!recorder->file) return;
+
+    Input_Run next = make_input_run(input);
+
+    // The session goes on with the frame time the replay will see.
+    input->frame_time = next.frame_time * INPUT_FRAME_TIME_UNIT;
+
+    if(recorder->run.frames && extends_input_run(&recorder->run, &next)) {
+        ++recorder->run.frames;
+    } else {
+        if(recorder->run.frames) {
+            fwrite(&recorder->run, sizeof(Input_Run), 1, recorder->file);
+            ++recorder->header.run_count;
+        }
+
+        recorder->run = next;
+    }
+
+    ++recorder->header.frame_count;
+}
+
+void end_input_recording(Input_Recorder *recorder) {
+    if(!recorder->file) return;
+
+    if(recorder->run.frames) {
+        fwrite(&recorder->run, sizeof(Input_Run), 1, recorder->file);
+        ++recorder->header.run_count;
+    }
+
+    fseek(recorder->file, 0, SEEK_SET);
+    fwrite(&recorder->header, sizeof(Input_Recording_Header), 1, recorder->file);
+    fclose(recorder->file);
+
+    log(LOG_Debug, "Recorded %lld frames of input in %lld runs.", recorder->header.frame_count, recorder->header.run_count);
+    *recorder = Input_Recorder{};
+}
+
+b8 load_input_replay(Input_Replay *replay, Allocator *allocator, const char *file_path) {
+    *replay = Input_Replay{};
+
+    FILE *file = fopen(file_path, "rb");
+    if(!file) return false;
+
+    Input_Recording_Header header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != INPUT_RECORDING_MAGIC || header.version != INPUT_RECORDING_VERSION ||
+       header.run_count < 0 || header.frame_count < header.run_count || (header.map_mode != MAP_MODE_2D && header.map_mode != MAP_MODE_3D)) {
+        log(LOG_Warning, "'%s' is not an input recording.", file_path);
+        fclose(file);
+        return false;
+    }
+
+    Input_Run *runs = (Input_Run *) allocator->allocate(max<s64>(header.run_count, 1) * sizeof(Input_Run));
+
+    if((s64) fread(runs, sizeof(Input_Run), header.run_count, file) != header.run_count) {
+        log(LOG_Warning, "'%s' ends before its %lld input runs.", file_path, header.run_count);
+        allocator->deallocate(runs);
+        fclose(file);
+        return false;
+    }
+
+    fclose(file);
+
+    replay->header = header;
+    replay->runs   = runs;
+    return true;
+}
+
+void destroy_input_replay(Input_Replay *replay, Allocator *allocator) {
+    if(replay->runs) allocator->deallocate(replay->runs);
+    *replay = Input_Replay{};
+}
+
+void apply_input_replay_camera(Input_Replay *replay, App *app) {
+    app->map_mode                = (Map_Mode) replay->header.map_mode;
+    app->camera.target_center    = Coordinate{ replay->header.center_lat, replay->header.center_lon };
+    app->camera.zoom_level       = replay->header.zoom_level;
+    app->camera.target_distance  = 0;
+    app->camera.current_center   = app->camera.target_center;
+    app->camera.current_distance = app->camera.target_distance;
+}
+
+b8 next_input_replay_frame(Input_Replay *replay, Frame_Input *input) {
+    if(replay->run_index >= replay->header.run_count) return false;
+
+    Input_Run *run = &replay->runs[replay->run_index];
+
+    input->frame_time        = run->frame_time * INPUT_FRAME_TIME_UNIT;
+    input->viewport_width    = run->viewport_width;
+    input->viewport_height   = run->viewport_height;
+    input->mouse_x           = run->mouse_x;
+    input->mouse_y           = run->mouse_y;
+    input->mouse_delta_x     = run->mouse_delta_x;
+    input->mouse_delta_y     = run->mouse_delta_y;
+    input->mouse_wheel_turns = run->mouse_wheel_turns;
+    input->dragging          = (run->flags & INPUT_Dragging) != 0;
+    input->toggle_map_mode   = (run->flags & INPUT_Toggle_Map_Mode) != 0;
+
+    if(++replay->run_frame >= run->frames) {
+        ++replay->run_index;
+        replay->run_frame = 0;
+    }
+
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdio.h>
+#include <foundation.h>
+
+#include "simulation.h"
+
+struct App;
+struct Allocator;
+
+//
+// Input recordings capture the Frame_Input of every frame, so that a session can be
+// replayed deterministically without a window (see the --replay mode of the bench).
+// Replays run with the recorded frame times rather than measuring their own, so that
+// the camera takes the same path however fast the replaying machine is. The frame
+// times are quantized to INPUT_FRAME_TIME_UNIT, and while recording, the app simulates
+// with the quantized frame time as well, so that the replay reproduces the session
+// exactly (including the frame rates the scheduler picked).
+// The camera state the recording started from is part of the header.
+//
+// Most frames repeat the previous input (nobody touches the mouse), so the frames are
+// run-length encoded: every Input_Run holds one input and how many frames it lasted.
+// Jittering frame times do split the runs, but runs are small.
+//
+// File layout:
+//   Input_Recording_Header
+//   run_count Input_Run
+//
+
+#define INPUT_RECORDING_MAGIC 0x52495657 // "WVIR"
+#define INPUT_RECORDING_VERSION 2
+#define INPUT_FRAME_TIME_UNIT 1e-4 // In seconds, of Input_Run::frame_time
+
+enum Input_Flags : u8 {
+    INPUT_Dragging        = 0x1,
+    INPUT_Toggle_Map_Mode = 0x2,
+};
+
+struct Input_Recording_Header {
+    u32 magic;
+    u32 version;
+    s64 frame_count;
+    s64 run_count;
+
+    // The camera when the recording started.
+    s32 map_mode;
+    s32 padding;
+    f64 center_lat, center_lon;
+    f64 zoom_level;
+};
+
+struct Input_Run {
+    u16 frames; // At least one
+    s16 viewport_width, viewport_height;
+    s16 mouse_x, mouse_y;
+    s16 mouse_delta_x, mouse_delta_y;
+    u16 frame_time; // In INPUT_FRAME_TIME_UNIT, at least one
+    u8 flags; // Input_Flags
+    u8 padding;
+    f32 mouse_wheel_turns;
+};
+
+struct Input_Recorder {
+    FILE *file; // Null while not recording
+    Input_Recording_Header header;
+    Input_Run run; // Not written yet, since the next frame may extend it
+};
+
+struct Input_Replay {
+    Input_Recording_Header header;
+    Input_Run *runs;
+    s64 run_index, run_frame; // The next frame
+};
+
+b8 begin_input_recording(Input_Recorder *recorder, App *app, const char *file_path);
+void record_input_frame(Input_Recorder *recorder, Frame_Input *input); // Quantizes the frame time of the input
+void end_input_recording(Input_Recorder *recorder);
+
+b8 load_input_replay(Input_Replay *replay, Allocator *allocator, const char *file_path);
+void destroy_input_replay(Input_Replay *replay, Allocator *allocator);
+void apply_input_replay_camera(Input_Replay *replay, App *app); // Moves the camera to where the recording started
+b8 next_input_replay_frame(Input_Replay *replay, Frame_Input *input); // False once all frames were replayed
@@ -0,0 +1,123 @@
+// --- C
+#include <stdlib.h>
+#include <string.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <memutils.h>
+
+// --- App
+#include "app.h"
+#include "draw.h"
+#include "tile.h"
+#include "tile_pool.h"
+#include "tile_index.h"
+#include "residency.h"
+
+struct Eviction_Candidates {
+    Tile **tiles;
+    s64 count;
+    s64 capacity;
+};
+
+static
+void measure_residency(App *app) {
+    // The root is part of the app, every other tile comes out of the pool.
+    app->residency.cpu_bytes = app->tile_pool.blocks_in_use * 4 * (s64) sizeof(Tile) + get_tile_index_bytes(&app->tile_index);
+    // Layers of texture pages don't free any memory by themselves, only whole pages do.
+    s64 page_bytes = get_tile_texture_page_bytes();
+    app->residency.gpu_bytes = (page_bytes ? page_bytes : app->tile_pool.texture_bytes) + app->tile_pool.mesh_bytes;
+}
+
+static
+b8 residency_over_budget(App *app, f64 fraction) {
+    measure_residency(app);
+    return app->residency.cpu_bytes > app->residency.cpu_budget * fraction || app->residency.gpu_bytes > app->residency.gpu_budget * fraction;
+}
+
+static
+void collect_eviction_candidates(App *app, Eviction_Candidates *candidates, Tile *tile) {
+    //
+    // Only the parents of four leaves can be merged without losing anything but the
+    // leaves. A parent is visible whenever one of its children is, so a candidate which
+    // isn't visible in this frame has no visible children either. The same goes for
+    // tiles the prefetcher expects to become visible.
+    //
+    if(tile->leaf) return;
+
+    b8 children_are_leaves = true;
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+        collect_eviction_candidates(app, candidates, tile->children[i]);
+        children_are_leaves &= tile->children[i]->leaf;
+    }
+
+    if(!children_are_leaves || tile->last_visible_frame == app->residency.frame_index || tile->last_predicted_frame == app->residency.frame_index) return;
+
+    if(candidates->count == candidates->capacity) {
+        // The previous array stays in the temp allocator until the end of the eviction.
+        s64 capacity = max<s64>(candidates->capacity * 2, 256);
+        Tile **tiles = (Tile **) temp.allocate(capacity * sizeof(Tile *));
+        if(candidates->count) memcpy(tiles, candidates->tiles, candidates->count * sizeof(Tile *));
+
+        candidates->tiles    = tiles;
+        candidates->capacity = capacity;
+    }
+
+    candidates->tiles[candidates->count] = tile;
+    ++candidates->count;
+}
+
+static
+int compare_last_visible_frames(const void *lhs, const void *rhs) {
+    s64 a = (*(Tile **) lhs)->last_visible_frame, b = (*(Tile **) rhs)->last_visible_frame;
+    return (a > b) - (a < b);
+}
+
+void create_residency(App *app, s64 cpu_budget, s64 gpu_budget) {
+    app->residency = Residency{};
+    app->residency.cpu_budget  = cpu_budget;
+    app->residency.gpu_budget  = gpu_budget;
+    app->residency.frame_index = 1;
+}
+
+void update_tile_residency(App *app) {
+    if(residency_over_budget(app, 1.0)) {
+        // Idle resources don't cache any tile, so they are the cheapest to give up.
+        trim_tile_pool(app);
+
+        s64 temp_mark = mark_temp_allocator();
+
+        while(residency_over_budget(app, RESIDENCY_EVICTION_TARGET)) {
+            Eviction_Candidates candidates = {};
+            collect_eviction_candidates(app, &candidates, &app->root);
+            if(!candidates.count) break; // Everything left is visible
+
+            qsort(candidates.tiles, candidates.count, sizeof(Tile *), compare_last_visible_frames);
+
+            //
+            // Merging one candidate can turn its parent into a candidate as well, but that
+            // parent was visible at least as recently, so it goes into the next round.
+            //
+            for(s64 i = 0; i < candidates.count && residency_over_budget(app, RESIDENCY_EVICTION_TARGET); ++i) {
+                merge_tile(app, candidates.tiles[i]);
+                app->residency.stats.evictions += ARRAY_COUNT(candidates.tiles[i]->children);
+
+                // The merge released the leaf resources into the pool, where they would still count.
+                trim_tile_pool(app);
+            }
+        }
+
+        release_temp_allocator(temp_mark);
+    }
+
+    b8 over_budget = residency_over_budget(app, 1.0);
+
+    if(over_budget && !app->residency.over_budget) {
+        log(LOG_Warning, "The tiles in view exceed the residency budget (cpu: %fmb of %fmb, gpu: %fmb of %fmb).",
+            convert_to_memory_unit(app->residency.cpu_bytes, Megabytes), convert_to_memory_unit(app->residency.cpu_budget, Megabytes),
+            convert_to_memory_unit(app->residency.gpu_bytes, Megabytes), convert_to_memory_unit(app->residency.gpu_budget, Megabytes));
+    }
+
+    app->residency.over_budget = over_budget;
+    ++app->residency.frame_index;
+}
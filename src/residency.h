@@ -0,0 +1,43 @@
+#pragma once
+
+#include <foundation.h>
+
+struct App;
+
+//
+// Subtrees which leave the view are not collapsed by the LOD, they stay in the tree as a
+// cache so that coming back to a region doesn't have to recreate and repaint it. The
+// residency manager keeps that cache within two budgets: The CPU memory of the tile
+// nodes, and the graphics memory of all tile textures and meshes (including the idle
+// ones in the tile pool). Where the tile textures are layers of texture pages, the
+// allocated pages count in full, and trimming the pool compacts the layers in use into
+// as few pages as possible. Whenever a budget is exceeded, the idle resources go first,
+// then the subtrees which have been out of view for the longest time are evicted. An
+// eviction merges four leaves into their parent, so the coarser parent stays resident
+// as a fallback. Tiles visible in the current frame, or expected to become visible by
+// the prefetcher, are never evicted.
+//
+
+#define RESIDENCY_DEFAULT_CPU_BUDGET (16 * ONE_MEGABYTE)
+#define RESIDENCY_DEFAULT_GPU_BUDGET (12 * ONE_MEGABYTE) // Six of the eight 2mb tile texture pages of the instanced renderer
+#define RESIDENCY_EVICTION_TARGET 0.9 // Evictions free up some headroom, so that they don't have to run again in the next frame
+
+struct Residency_Stats {
+    s64 hits;      // Leaves which came back into view while still resident
+    s64 misses;    // Leaves which had to be created for the view
+    s64 evictions; // Leaves evicted to stay within the budgets
+};
+
+struct Residency {
+    s64 cpu_budget; // In bytes
+    s64 gpu_budget; // In bytes
+    s64 cpu_bytes;  // As of the end of the last frame
+    s64 gpu_bytes;
+    b8 over_budget; // Nothing but tiles in view was left to evict
+
+    s64 frame_index; // Tiles visible in this frame have it as their last_visible_frame
+    Residency_Stats stats; // Since create_residency
+};
+
+void create_residency(App *app, s64 cpu_budget, s64 gpu_budget);
+void update_tile_residency(App *app); // Once per frame, after the LOD update
@@ -0,0 +1,123 @@
+// --- C
+#include <math.h>
+#if FOUNDATION_WIN32
+# define WIN32_LEAN_AND_MEAN
+# define NOMINMAX
+# include <windows.h>
+#endif
+
+// --- Foundation
+#include <foundation.h>
+#include <os_specific.h>
+#include <math/v4.h>
+
+// --- App
+#include "app.h"
+#include "scheduler.h"
+#include "projection.h"
+#include "picking.h"
+#include "profiler.h"
+
+void create_frame_scheduler(Frame_Scheduler *scheduler) {
+    *scheduler = Frame_Scheduler{};
+    scheduler->rate_divisor = 1;
+}
+
+static inline
+b8 input_is_idle(Frame_Input *input, Frame_Input *previous) {
+    // Moving the mouse without dragging doesn't change the picture, only the hover pick (see update_idle_hover).
+    return (!input->dragging || (input->mouse_delta_x == 0 && input->mouse_delta_y == 0)) && input->mouse_wheel_turns == 0 && !input->toggle_map_mode &&
+        input->viewport_width == previous->viewport_width && input->viewport_height == previous->viewport_height;
+}
+
+b8 frame_is_required(Frame_Scheduler *scheduler, App *app, Frame_Input *input) {
+    if(!scheduler->settled || !scheduler->has_previous_input) return true;
+
+    // Invalidated tiles (points or overlays changing) are repainted while drawing.
+    if(app->root.state == TILE_Requires_Repainting || app->root.state == TILE_Requires_Regeneration || app->root.children_require_repainting) return true;
+
+    return !input_is_idle(input, &scheduler->previous_input);
+}
+
+void update_idle_hover(Frame_Scheduler *scheduler, App *app, Frame_Input *input) {
+    Frame_Input *previous = &scheduler->previous_input;
+    if(input->mouse_x == previous->mouse_x && input->mouse_y == previous->mouse_y) return;
+
+    // The tree and the camera haven't changed since the last frame, so the pick is as good as a simulated one.
+    app->hover = pick_tile(app, (f32) input->mouse_x, (f32) input->mouse_y);
+    previous->mouse_x = input->mouse_x;
+    previous->mouse_y = input->mouse_y;
+}
+
+void wait_for_idle_input(f64 seconds) {
+#if FOUNDATION_WIN32
+    //
+    // Foundation's window layer only polls, but the messages of the window arrive in the
+    // queue of this thread. update_window has already looked at the messages queued so far,
+    // MWMO_INPUTAVAILABLE makes them count anyway.
+    //
+    MsgWaitForMultipleObjectsEx(0, null, (DWORD) (seconds * 1000.0), QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+#else
+    Hardware_Time now = os_get_hardware_time();
+    os_sleep_to_tick_rate(now, now, (f32) (1.0 / seconds));
+#endif
+}
+
+void finish_scheduled_frame(Frame_Scheduler *scheduler, App *app, Frame_Input *input, f64 seconds) {
+    ++scheduler->stats.frames_drawn;
+
+    if(scheduler->stats.frames_drawn == 1) {
+        scheduler->frame_cost = seconds;
+    } else {
+        scheduler->frame_cost += (seconds - scheduler->frame_cost) * 0.1;
+    }
+
+    scheduler->settled            = app_has_converged(app);
+    scheduler->previous_input     = *input;
+    scheduler->has_previous_input = true;
+
+    //
+    // Only step down once the frames clearly miss their budget, so that a swap waiting
+    // for the vertical blank doesn't count as load, and only step up again once the
+    // frames leave some headroom at the higher rate.
+    //
+    f64 budget = (f64) scheduler->rate_divisor / FRAME_RATE;
+
+    if(scheduler->frame_cost > budget * 1.1 && scheduler->rate_divisor < SCHEDULER_MAX_RATE_DIVISOR) {
+        ++scheduler->rate_divisor;
+    } else if(scheduler->rate_divisor > 1 && scheduler->frame_cost < (f64) (scheduler->rate_divisor - 1) / FRAME_RATE * 0.75) {
+        --scheduler->rate_divisor;
+    }
+}
+
+void skip_scheduled_frame(Frame_Scheduler *scheduler, f64 seconds) {
+    f64 saved = seconds * get_scheduled_frame_rate(scheduler) * scheduler->frame_cost;
+
+    scheduler->stats.idle_seconds  += seconds;
+    scheduler->stats.seconds_saved += saved;
+    PROFILE_COUNT(PROFILE_COUNTER_Microseconds_Saved, (s64) (saved * 1000000.0));
+}
+
+f32 get_scheduled_frame_rate(Frame_Scheduler *scheduler) {
+    return (f32) FRAME_RATE / (f32) scheduler->rate_divisor;
+}
+
+b8 app_has_converged(App *app) {
+    if(app->morph.remaining > 0 || app->tile_jobs) return false;
+    if(app->lod_stats.splits || app->lod_stats.merges || app->prefetcher.stats.splits) return false;
+
+    Camera *camera = &app->camera;
+    if(fabs(camera->current_distance - camera->target_distance) > camera->target_distance * SCHEDULER_SETTLED_DISTANCE) return false;
+
+    //
+    // The camera looks at its current center, so the target center must project within
+    // a fraction of a pixel of the middle of the viewport.
+    //
+    v3f target = world_from_coordinate_space(app->map_mode, camera->target_center.lat, camera->target_center.lon);
+    v4f clip   = camera->projection_view * v4f(target.x, target.y, target.z, 1);
+    if(clip.w <= 0) return false;
+
+    f64 x = clip.x / clip.w * camera->viewport_width * 0.5;
+    f64 y = clip.y / clip.w * camera->viewport_height * 0.5;
+    return x * x + y * y <= SCHEDULER_SETTLED_PIXELS * SCHEDULER_SETTLED_PIXELS;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <foundation.h>
+
+#include "simulation.h"
+
+struct App;
+
+//
+// The frame scheduler decides whether the main loop has to simulate and draw a frame
+// at all. Once the camera has reached its target, no map mode switch is running and
+// the last frame neither split nor merged tiles or left jobs in flight, the picture
+// can't change anymore without new input. The main loop then blocks until the window
+// receives input (see wait_for_idle_input), for SCHEDULER_IDLE_TIMEOUT at most.
+// Moving the mouse without dragging only changes the hover pick, which nothing on screen
+// shows, so while idle it only re-picks instead of simulating and drawing a frame.
+// While drawing, the frame rate adapts to the load: It drops to FRAME_RATE / 2 or / 3
+// when the frames don't fit into their budget, which keeps the pacing even instead of
+// missing every other deadline, and goes back up once they fit comfortably again.
+//
+
+#define SCHEDULER_IDLE_TIMEOUT     0.25 // Seconds of waiting for input while idle, before checking the scene again
+#define SCHEDULER_MAX_RATE_DIVISOR 3 // The adaptive frame rate goes down to FRAME_RATE / this
+#define SCHEDULER_SETTLED_PIXELS   0.25 // How far the camera may be off its target to count as converged
+#define SCHEDULER_SETTLED_DISTANCE 1e-4 // Relative to the target distance
+
+struct Frame_Scheduler_Stats {
+    s64 frames_drawn;
+    f64 idle_seconds;
+    f64 seconds_saved; // The estimated cost of the frames that weren't drawn while idle
+};
+
+struct Frame_Scheduler {
+    s64 rate_divisor; // Of FRAME_RATE, see get_scheduled_frame_rate
+    f64 frame_cost; // Smoothed seconds of simulating and drawing a frame
+    b8 settled; // Whether the last drawn frame has converged
+
+    Frame_Input previous_input; // Of the last drawn frame
+    b8 has_previous_input;
+
+    Frame_Scheduler_Stats stats;
+};
+
+void create_frame_scheduler(Frame_Scheduler *scheduler);
+b8 frame_is_required(Frame_Scheduler *scheduler, App *app, Frame_Input *input); // False while idle, see above
+void update_idle_hover(Frame_Scheduler *scheduler, App *app, Frame_Input *input); // Instead of a frame, re-picks if the mouse moved
+void wait_for_idle_input(f64 seconds); // Returns early once the window receives input
+void finish_scheduled_frame(Frame_Scheduler *scheduler, App *app, Frame_Input *input, f64 seconds); // After drawing the frame, with the time it took
+void skip_scheduled_frame(Frame_Scheduler *scheduler, f64 seconds); // With the time since the last frame or poll
+f32 get_scheduled_frame_rate(Frame_Scheduler *scheduler);
+b8 app_has_converged(App *app); // After simulating and drawing a frame
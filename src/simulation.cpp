@@ -0,0 +1,248 @@
+// --- Foundation
+#include <foundation.h>
+#include <window.h>
+#include <math/maths.h>
+#include <math/algebra.h>
+
+// --- App
+#include "app.h"
+#include "simulation.h"
+#include "lod.h"
+#include "residency.h"
+#include "prefetch.h"
+#include "profiler.h"
+#include "projection.h"
+#include "picking.h"
+
+static
+void lerp(f64 *value, f64 target, f64 speed) {
+	*value += (target - *value) * speed;
+}
+
+static
+f64 wrap(f64 value, f64 low, f64 high) {
+	if(value >= 0 || low >= 0) {
+		return fmod(value - low, high - low) + low;
+	} else {
+		return high - fmod(-value - low, high - low);
+	}
+}
+
+static
+void lerp_with_wrap(f64 *value, f64 target, f64 speed, f64 low, f64 high) {
+	f64 direct_distance    = fabs(target - *value);
+	f64 wrap_high_distance = (high - *value) + (target - low);
+	f64 wrap_low_distance  = (high - target) + (*value - low);
+
+	if(direct_distance < wrap_high_distance && direct_distance < wrap_low_distance) {
+		*value += (target - *value) * speed;
+	} else if(wrap_high_distance < wrap_low_distance) {
+		*value += wrap_high_distance * speed;	
+	} else {
+		*value -= wrap_low_distance * speed;	
+	}
+
+	*value = wrap(*value, low, high);
+}
+
+Frame_Input frame_input_from_window(Window *window) {
+	Frame_Input input;
+	input.frame_time        = window->frame_time;
+	input.viewport_width    = window->w;
+	input.viewport_height   = window->h;
+	input.mouse_x           = window->mouse_x;
+	input.mouse_y           = window->mouse_y;
+	input.mouse_delta_x     = window->mouse_delta_x;
+	input.mouse_delta_y     = window->mouse_delta_y;
+	input.mouse_wheel_turns = window->mouse_wheel_turns;
+	input.dragging          = (window->buttons[BUTTON_Left] & BUTTON_Down) != 0;
+	input.toggle_map_mode   = (window->keys[KEY_Tab] & KEY_Pressed) != 0;
+	return input;
+}
+
+void update_camera_matrices(Camera *camera, Map_Mode map_mode) {
+	switch(map_mode) {
+	case MAP_MODE_2D: {
+		v3f position = world_from_coordinate_space(MAP_MODE_2D, camera->current_center.lat, camera->current_center.lon);
+		v3f rotation = v3f(0, 0, 0);
+		camera->projection = make_orthographic_projection_matrix((f32) (camera->current_distance * camera->ratio * 2.0), (f32) (camera->current_distance * 2.0), WORLD_SCALE_2D);
+		camera->view = make_view_matrix(position, rotation);
+		camera->position = position;
+	} break;
+
+	case MAP_MODE_3D: {
+		v3f position = globe_from_coordinate_space(camera->current_center.lat, camera->current_center.lon, camera->current_distance);
+		v3f rotation = v3f((f32) (camera->current_center.lat / 180.0 * 0.5), (f32) -(camera->current_center.lon / 180.0 * 0.5f), 0);
+
+		camera->projection = make_perspective_projection_matrix_vertical_fov(camera->fov, camera->ratio, camera->near, camera->far);
+		camera->view = make_view_matrix(position, rotation);
+		camera->position = position;
+	} break;
+	}
+
+	camera->projection_view    = camera->projection * camera->view;
+	camera->inverse_projection = m4_inverse(camera->projection); // For picking, which happens far more often than the camera moves
+	camera->inverse_view       = m4_inverse(camera->view);
+	camera->frustum = make_frustum(camera->projection_view);
+}
+
+void get_camera_distance_range(Camera *camera, Map_Mode map_mode, f64 *min_distance, f64 *max_distance) {
+	switch(map_mode) {
+	case MAP_MODE_2D: *min_distance = 0.001f; *max_distance = WORLD_SCALE_2D; break;
+	case MAP_MODE_3D: *min_distance = WORLD_SCALE_3D; *max_distance = camera->far; break;
+	}
+}
+
+f64 get_camera_distance(Camera *camera, Map_Mode map_mode, f64 zoom_level) {
+#define ZOOM_STEP 1.13
+	f64 min_distance, max_distance;
+	get_camera_distance_range(camera, map_mode, &min_distance, &max_distance);
+	return pow(ZOOM_STEP, 50 * (zoom_level - 1)) * (max_distance - min_distance) + min_distance;
+#undef ZOOM_STEP
+}
+
+void update_camera(App *app, Frame_Input *input) {
+#define INTERP_SPEED clamp(input->frame_time * 100, 0, 1)
+
+	app->camera.fov   = 61.0f;
+	app->camera.near  = 0.001f;
+	app->camera.far   = WORLD_SCALE_3D * 2.0f;
+	app->camera.ratio = (f32) input->viewport_width / (f32) input->viewport_height;
+	app->camera.viewport_width  = input->viewport_width;
+	app->camera.viewport_height = input->viewport_height;
+
+	//
+	// Adjust the distance
+	//
+	app->camera.zoom_level -= input->mouse_wheel_turns / 20;
+	app->camera.zoom_level  = clamp(app->camera.zoom_level, 0.001f, 1.f);
+	
+	f64 min_distance, max_distance;
+	get_camera_distance_range(&app->camera, app->map_mode, &min_distance, &max_distance);
+
+	app->camera.target_distance = get_camera_distance(&app->camera, app->map_mode, app->camera.zoom_level);
+
+	//
+	// Adjust the center
+	//
+	if(input->dragging) {
+		f64 dy = (f64) input->mouse_delta_y / (f64) input->viewport_height;
+		f64 dx = (f64) input->mouse_delta_x / (f64) input->viewport_height;
+		f64 x = (app->camera.current_distance - min_distance) / (max_distance - min_distance);
+		f64 sensitivity;
+		
+		switch(app->map_mode) {
+		case MAP_MODE_2D: sensitivity = 180.0 * x; break;
+		case MAP_MODE_3D: sensitivity = 180.0 * (log(x + 1) / log(3.2)); break;
+		}
+		
+		app->camera.target_center.lat += dy * sensitivity;
+		app->camera.target_center.lon -= dx * sensitivity;
+	}
+	
+	app->camera.target_center.lat = clamp(app->camera.target_center.lat, -90.0, 90.0);
+
+	switch(app->map_mode) {
+	case MAP_MODE_2D: app->camera.target_center.lon = clamp(app->camera.target_center.lon, -180.0, 180.0); break;
+	case MAP_MODE_3D: app->camera.target_center.lon = wrap(app->camera.target_center.lon, -180.0, 180.0); break;
+	}
+	
+	//
+	// Lerp from the current to the target 
+	//
+
+	lerp(&app->camera.current_center.lat, app->camera.target_center.lat, INTERP_SPEED);
+	
+	switch(app->map_mode) {
+	case MAP_MODE_2D: lerp(&app->camera.current_center.lon, app->camera.target_center.lon, INTERP_SPEED); break;
+	case MAP_MODE_3D: lerp_with_wrap(&app->camera.current_center.lon, app->camera.target_center.lon, INTERP_SPEED, -180, 180); break;
+	}
+	lerp(&app->camera.current_distance, app->camera.target_distance, INTERP_SPEED);
+
+	app->camera.current_center.lat = clamp(app->camera.current_center.lat, -90.0, 90.0);
+	app->camera.current_center.lon = clamp(app->camera.current_center.lon, -180.0, 180.0);
+
+	update_camera_matrices(&app->camera, app->map_mode);
+
+#undef INTERP_SPEED
+}
+
+static
+void update_map_morph(App *app, Frame_Input *input) {
+	Map_Morph *morph = &app->morph;
+	if(morph->remaining <= 0) return;
+
+	morph->remaining = max(morph->remaining - input->frame_time, 0.0);
+
+	f64 progress = 1.0 - morph->remaining / MAP_MORPH_DURATION;
+	f64 eased    = progress * progress * (3.0 - 2.0 * progress); // Symmetric, so reversing halfway continues smoothly
+	morph->globe = (f32) (app->map_mode == MAP_MODE_3D ? eased : 1.0 - eased);
+
+	Coordinate center = app->camera.current_center;
+	f64 sin_lat = sin(degrees_to_radians(center.lat)), cos_lat = cos(degrees_to_radians(center.lat));
+	f64 sin_lon = sin(degrees_to_radians(center.lon)), cos_lon = cos(degrees_to_radians(center.lon));
+
+	morph->center = center;
+	morph->origin = globe_from_coordinate_space(center.lat, center.lon, WORLD_SCALE_3D);
+	morph->east   = v3f((f32) cos_lon, 0, (f32) -sin_lon);
+	morph->north  = v3f((f32) (-sin_lat * sin_lon), (f32) cos_lat, (f32) (-sin_lat * cos_lon));
+
+	//
+	// The 2D camera shows distance_2d / WORLD_SCALE_2D * 90 degrees above the center,
+	// which the morph camera matches on the flat map from flat_distance above the globe.
+	//
+	Camera camera = app->camera;
+	f64 half_height   = degrees_to_radians(get_camera_distance(&camera, MAP_MODE_2D, camera.zoom_level) / WORLD_SCALE_2D * 90.0) * WORLD_SCALE_3D;
+	f64 flat_distance = WORLD_SCALE_3D + half_height / tan(degrees_to_radians(camera.fov) * 0.5);
+	f64 globe_distance = get_camera_distance(&camera, MAP_MODE_3D, camera.zoom_level);
+
+	camera.current_distance = flat_distance * (1.0 - morph->globe) + globe_distance * morph->globe;
+	camera.far              = (f32) (camera.current_distance + WORLD_SCALE_3D * 4.0); // The flat map reaches pi * WORLD_SCALE_3D to either side
+	update_camera_matrices(&camera, MAP_MODE_3D);
+	morph->projection_view = camera.projection_view;
+}
+
+void simulate_one_frame(App *app, Frame_Input *input) {
+	//
+	// Update the mode. The tiles don't depend on it, see Map_Morph.
+	//
+	if(input->toggle_map_mode) {
+		switch(app->map_mode) {
+		case MAP_MODE_2D: app->map_mode = MAP_MODE_3D; break;
+		case MAP_MODE_3D: app->map_mode = MAP_MODE_2D; break;
+		}
+
+		app->morph.remaining = MAP_MORPH_DURATION - app->morph.remaining;
+	}
+
+	{
+		PROFILE_ZONE("Regenerate");
+		maybe_regenerate_tiles(app, &app->root);
+		flush_tile_jobs(app);
+	}
+
+	//
+	// Update the camera
+	//
+	{
+		PROFILE_ZONE("Camera update");
+		update_camera(app, input);
+		update_map_morph(app, input);
+	}
+
+	//
+	// Split and merge tiles for the new view, prepare the ones the camera is heading
+	// towards, then evict what doesn't fit anymore
+	//
+	{
+		PROFILE_ZONE("Tile LOD");
+		update_tile_lod(app);
+		prefetch_tiles(app);
+		update_tile_residency(app);
+	}
+
+	//
+	// Find what is under the cursor in the final tree of this frame
+	//
+	app->hover = pick_tile(app, (f32) input->mouse_x, (f32) input->mouse_y);
+}
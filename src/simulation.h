@@ -0,0 +1,32 @@
+#pragma once
+
+#include <foundation.h>
+
+struct App;
+struct Window;
+struct Camera;
+enum Map_Mode : s32;
+
+//
+// Everything the simulation reads from the platform in a single frame. The window
+// layer fills this in, the headless benchmark synthesizes it, so that the camera
+// and tile logic never touch the Window directly.
+//
+struct Frame_Input {
+    f64 frame_time;
+    s32 viewport_width, viewport_height;
+
+    s32 mouse_x, mouse_y; // In pixels from the top left corner of the viewport
+    s32 mouse_delta_x, mouse_delta_y;
+    f32 mouse_wheel_turns;
+    b8 dragging;
+
+    b8 toggle_map_mode;
+};
+
+Frame_Input frame_input_from_window(Window *window);
+void get_camera_distance_range(Camera *camera, Map_Mode map_mode, f64 *min_distance, f64 *max_distance);
+f64 get_camera_distance(Camera *camera, Map_Mode map_mode, f64 zoom_level);
+void update_camera_matrices(Camera *camera, Map_Mode map_mode); // From the current center and distance
+void update_camera(App *app, Frame_Input *input);
+void simulate_one_frame(App *app, Frame_Input *input);
@@ -0,0 +1,147 @@
+// --- C
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <os_specific.h>
+
+// --- App
+#include "app.h"
+#include "draw.h"
+#include "simulation.h"
+#include "jobs.h"
+
+//
+// Renders a single frame through the software backend (draw_software.cpp) and writes
+// it as a binary PPM. Rendering is deterministic, so two snapshots of the same view
+// can be compared byte by byte.
+// Usage: WorldView_Snapshot output.ppm [2d|3d] [lat lon zoom_level] [width height] [imagery.wvp] [overlay.txt] [points.wvpt] [elevation.wvdm]
+//
+
+#define SNAPSHOT_MAX_FRAMES 600 // Until the camera and the LOD have settled
+
+static
+b8 write_ppm(const char *file_path, u32 *pixels, s64 width, s64 height, s64 stride) {
+    FILE *file = fopen(file_path, "wb");
+    if(!file) return false;
+
+    fprintf(file, "P6\n%lld %lld\n255\n", width, height);
+
+    u8 *row = (u8 *) malloc(width * 3);
+
+    for(s64 y = 0; y < height; ++y) {
+        for(s64 x = 0; x < width; ++x) {
+            u32 pixel = pixels[y * stride + x];
+            row[x * 3 + 0] = (u8) (pixel >> 0);
+            row[x * 3 + 1] = (u8) (pixel >> 8);
+            row[x * 3 + 2] = (u8) (pixel >> 16);
+        }
+
+        fwrite(row, 1, width * 3, file);
+    }
+
+    free(row);
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        printf("Usage: %s output.ppm [2d|3d] [lat lon zoom_level] [width height] [imagery.wvp] [overlay.txt] [points.wvpt] [elevation.wvdm]\n", argv[0]);
+        return 1;
+    }
+
+    const char *output = argv[1];
+
+    os_enable_high_resolution_clock();
+    create_temp_allocator(4 * ONE_MEGABYTE);
+    create_job_system(0);
+    minimum_log_level = LOG_Warning;
+
+    App app = {};
+    app.pool.create(512 * ONE_MEGABYTE);
+    app.allocator = app.pool.allocator();
+
+    setup_draw_data(&app);
+    create_tile_pool(&app);
+    create_tile_index(&app);
+    create_residency(&app, RESIDENCY_DEFAULT_CPU_BUDGET, RESIDENCY_DEFAULT_GPU_BUDGET);
+
+    app.map_mode = (argc > 2 && strcmp(argv[2], "2d") == 0) ? MAP_MODE_2D : MAP_MODE_3D;
+    app.camera.target_center = Coordinate{ argc > 4 ? atof(argv[3]) : 0, argc > 4 ? atof(argv[4]) : 0 };
+    app.camera.zoom_level    = argc > 5 ? atof(argv[5]) : 0.5;
+    app.camera.current_center = app.camera.target_center;
+
+    Frame_Input input = {};
+    input.frame_time      = 1.0 / FRAME_RATE;
+    input.viewport_width  = argc > 7 ? atoi(argv[6]) : 1920;
+    input.viewport_height = argc > 7 ? atoi(argv[7]) : 1080;
+
+    if(argc > 8 && argv[8][0] && !open_tile_pyramid(&app.imagery, argv[8])) { // An empty path skips the imagery
+        printf("Failed to open the tile pyramid %s.\n", argv[8]);
+        return 1;
+    }
+
+    if(argc > 9 && argv[9][0] && !load_overlay(&app, argv[9])) {
+        printf("Failed to load the overlay %s.\n", argv[9]);
+        return 1;
+    }
+
+    if(argc > 10 && argv[10][0] && !load_points(&app, argv[10])) {
+        printf("Failed to load the points %s.\n", argv[10]);
+        return 1;
+    }
+
+    if(argc > 11 && !load_terrain(&app, argv[11])) {
+        printf("Failed to load the terrain %s.\n", argv[11]);
+        return 1;
+    }
+
+    create_tile(&app, &app.root, Bounding_Box{ -90, -180, 90, 180 });
+
+    // Jump straight to the target distance, then let the LOD converge.
+    update_camera(&app, &input);
+    app.camera.current_distance = app.camera.target_distance;
+
+    s64 frames = 0;
+    Hardware_Time start = os_get_hardware_time();
+
+    while(frames < SNAPSHOT_MAX_FRAMES) {
+        simulate_one_frame(&app, &input);
+        wait_for_tile_jobs(&app);
+        draw_one_frame(&app);
+        ++frames;
+
+        if(app.lod_stats.splits == 0 && app.lod_stats.merges == 0) break;
+    }
+
+    Hardware_Time end = os_get_hardware_time();
+
+    s64 width, height, stride;
+    u32 *pixels = get_software_frame_buffer(&width, &height, &stride);
+    b8 written  = write_ppm(output, pixels, width, height, stride);
+
+    if(written) {
+        printf("Wrote %s (%lldx%lld, %lld tiles drawn, %lld frames in %fms).\n", output, width, height, app.cull_stats.tiles_drawn, frames, os_convert_hardware_time(end - start, Milliseconds));
+    } else {
+        printf("Failed to write %s.\n", output);
+    }
+
+    destroy_tile(&app, &app.root, true);
+    wait_for_tile_jobs(&app);
+    destroy_tile_pool(&app);
+    destroy_tile_index(&app);
+    destroy_tile_index_buffers(&app);
+    destroy_draw_data(&app);
+    close_tile_pyramid(&app.imagery);
+    destroy_overlay(&app);
+    destroy_point_layer(&app);
+    destroy_terrain(&app);
+    app.pool.destroy();
+
+    destroy_job_system();
+    destroy_temp_allocator();
+    return written ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// --- C
+#include <math.h>
+#include <stdio.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <memutils.h>
+#include <os_specific.h>
+
+// --- App
+#include "app.h"
+#include "draw.h"
+#include "terrain.h"
+
+static inline
+f64 get_height(Terrain *terrain, s64 row, s64 column) {
+    return (f64) terrain->heights[row * terrain->width + column];
+}
+
+static
+f64 get_surplus(Terrain *terrain, s64 row, s64 column, s64 spacing) {
+    //
+    // How far this sample lies off the bilinear interpolation of the samples spacing
+    // apart around it. The last cell of a row or column may be cut short by the edge
+    // of the DEM.
+    //
+    s64 row0    = row / spacing * spacing,    row1    = min<s64>(row0 + spacing, terrain->height - 1);
+    s64 column0 = column / spacing * spacing, column1 = min<s64>(column0 + spacing, terrain->width - 1);
+
+    f64 v = (row1 > row0) ? (f64) (row - row0) / (f64) (row1 - row0) : 0.0;
+    f64 u = (column1 > column0) ? (f64) (column - column0) / (f64) (column1 - column0) : 0.0;
+
+    f64 south = get_height(terrain, row0, column0) * (1 - u) + get_height(terrain, row0, column1) * u;
+    f64 north = get_height(terrain, row1, column0) * (1 - u) + get_height(terrain, row1, column1) * u;
+    return fabs(get_height(terrain, row, column) - (south * (1 - v) + north * v));
+}
+
+static
+void compute_terrain_errors(Terrain *terrain) {
+    terrain->errors[0] = 0; // The DEM itself
+
+    for(s64 level = 1; level < TERRAIN_ERROR_LEVELS; ++level) {
+        s64 spacing = (s64) 1 << level, half = spacing / 2;
+        f64 surplus = 0;
+
+        // Only the samples which are part of the finer level but not of this one.
+        for(s64 row = 0; row < terrain->height; row += half) {
+            b8 coarse_row = row % spacing == 0;
+
+            for(s64 column = coarse_row ? half : 0; column < terrain->width; column += coarse_row ? spacing : half) {
+                surplus = max(surplus, get_surplus(terrain, row, column, spacing));
+            }
+        }
+
+        terrain->errors[level] = terrain->errors[level - 1] + surplus;
+    }
+}
+
+b8 load_terrain(App *app, const char *file_path) {
+    FILE *file = fopen(file_path, "rb");
+    if(!file) return false; // Terrain is optional, the caller decides whether this is an error
+
+    b8 tiles_exist = app->root.leaf || app->root.children[0];
+    if(!draw_requires_tile_meshes() && tiles_exist) {
+        // The instanced tiles can't be turned into meshes on the fly.
+        log(LOG_Warning, "Ignoring the terrain '%s', it must be loaded before the instanced tiles are created.", file_path);
+        fclose(file);
+        return false;
+    }
+
+    Hardware_Time start = os_get_hardware_time();
+
+    Terrain_File_Header header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != TERRAIN_FILE_MAGIC || header.version != TERRAIN_FILE_VERSION || header.width < 2 || header.height < 2) {
+        log(LOG_Warning, "'%s' is not a terrain file.", file_path);
+        fclose(file);
+        return false;
+    }
+
+    s64 count = (s64) header.width * (s64) header.height;
+    s16 *heights = (s16 *) app->allocator.allocate(count * sizeof(s16));
+
+    if((s64) fread(heights, sizeof(s16), count, file) != count) {
+        log(LOG_Warning, "'%s' ends before its %dx%d heights.", file_path, header.width, header.height);
+        app->allocator.deallocate(heights);
+        fclose(file);
+        return false;
+    }
+
+    fclose(file);
+
+    if(!draw_requires_tile_meshes()) {
+        // The shared unit grid can't be displaced, only tile meshes show the heights. Its
+        // index buffers have no skirts, so the tile meshes get their own.
+        log(LOG_Debug, "Drawing tile meshes instead of instances to show the terrain '%s'.", file_path);
+        switch_to_tile_meshes(app);
+        destroy_tile_index_buffers(app);
+    }
+
+    destroy_terrain(app);
+
+    Terrain *terrain = &app->terrain;
+    terrain->heights    = heights;
+    terrain->width      = header.width;
+    terrain->height     = header.height;
+    terrain->min_height = heights[0];
+    terrain->max_height = heights[0];
+
+    for(s64 i = 0; i < count; ++i) {
+        terrain->min_height = min(terrain->min_height, (f32) heights[i]);
+        terrain->max_height = max(terrain->max_height, (f32) heights[i]);
+    }
+
+    compute_terrain_errors(terrain);
+
+    // Existing tiles were built without the heights, or with the previous ones.
+    if(tiles_exist) app->root.state = TILE_Requires_Regeneration;
+
+    Hardware_Time end = os_get_hardware_time();
+    log(LOG_Debug, "Loaded the terrain '%s' (%lldx%lld, %f to %f meters): %fms.", file_path, terrain->width, terrain->height, terrain->min_height, terrain->max_height, os_convert_hardware_time(end - start, Milliseconds));
+    return true;
+}
+
+void destroy_terrain(App *app) {
+    if(app->terrain.heights) app->allocator.deallocate(app->terrain.heights);
+    app->terrain = Terrain{};
+}
+
+f64 sample_terrain(Terrain *terrain, f64 lat, f64 lon) {
+    if(!terrain->heights) return 0;
+
+    f64 y = clamp((lat + 90.0) / 180.0, 0.0, 1.0) * (f64) (terrain->height - 1);
+    f64 x = clamp((lon + 180.0) / 360.0, 0.0, 1.0) * (f64) (terrain->width - 1);
+
+    s64 row0    = min<s64>((s64) y, terrain->height - 2);
+    s64 column0 = min<s64>((s64) x, terrain->width - 2);
+    f64 v = y - (f64) row0, u = x - (f64) column0;
+
+    f64 south = get_height(terrain, row0, column0) * (1 - u) + get_height(terrain, row0, column0 + 1) * u;
+    f64 north = get_height(terrain, row0 + 1, column0) * (1 - u) + get_height(terrain, row0 + 1, column0 + 1) * u;
+    return south * (1 - v) + north * v;
+}
+
+f64 get_terrain_scale() {
+    return TERRAIN_EXAGGERATION * WORLD_SCALE_3D / TERRAIN_EARTH_RADIUS;
+}
+
+f64 get_terrain_error(Terrain *terrain, s64 level, s64 segments) {
+    if(!terrain || !terrain->heights) return 0;
+
+    // The distance between two mesh vertices in samples, along the coarser axis.
+    f64 tiles_per_side = (f64) ((s64) 1 << level);
+    f64 spacing = max((f64) (terrain->width - 1), (f64) (terrain->height - 1)) / tiles_per_side / (f64) segments;
+    if(spacing <= 1.0) return 0; // Finer than the DEM
+
+    s64 error_level = min<s64>((s64) ceil(log2(spacing)), TERRAIN_ERROR_LEVELS - 1);
+    return terrain->errors[error_level] * get_terrain_scale();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <foundation.h>
+
+struct App;
+
+//
+// Terrain displaces the 3D tile meshes along the globe normal by the heights of a
+// digital elevation model. The DEM is a single equirectangular grid covering the
+// whole world, sampled at the grid corners: Row 0 lies on the south pole and the last
+// row on the north pole, column 0 on -180 and the last column on 180 degrees.
+// Between samples the heights are interpolated bilinearly.
+// The mesh resolution of a tile only depends on its level (see get_tile_segments).
+// To pick it, the DEM is summarized once when it is loaded: errors[k] bounds how far
+// the DEM may deviate from its bilinear interpolation between samples 2^k apart. The
+// bound is the sum of the hierarchical surpluses up to k, so it costs about one pass
+// over the samples.
+//
+// Terrain files start with a Terrain_File_Header followed by height * width s16
+// heights in meters. Only the tile meshes generated on the CPU are displaced, so
+// loading a terrain switches an instanced backend to tile meshes (see draw.h). That
+// has to happen before the first tile is created.
+//
+
+#define TERRAIN_FILE_MAGIC 0x4d445657 // "WVDM"
+#define TERRAIN_FILE_VERSION 1
+#define TERRAIN_EARTH_RADIUS 6371000.0 // In meters, mapped onto WORLD_SCALE_3D
+#define TERRAIN_EXAGGERATION 1.0
+#define TERRAIN_ERROR_LEVELS 24 // Sample spacings up to 2^23
+
+struct Terrain_File_Header {
+    u32 magic;
+    u32 version;
+    s32 width, height; // In samples, at least 2 each
+};
+
+struct Terrain {
+    s16 *heights; // Null without elevation, [height][width]
+    s64 width, height;
+    f32 min_height, max_height; // In meters
+    f64 errors[TERRAIN_ERROR_LEVELS]; // In meters, see above
+};
+
+b8 load_terrain(App *app, const char *file_path);
+void destroy_terrain(App *app); // Tile jobs may still read the heights, wait for them first
+
+f64 sample_terrain(Terrain *terrain, f64 lat, f64 lon); // In meters, 0 without elevation
+f64 get_terrain_scale(); // World units per meter of elevation
+f64 get_terrain_error(Terrain *terrain, s64 level, s64 segments); // In world units, of a tile mesh on this level
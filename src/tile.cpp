@@ -1,3 +1,8 @@
+// --- C++
+#include <atomic>
+#include <new>
+#include <thread>
+
 // --- Foundation
 #include <math/maths.h>
 #include <math/v2.h>
@@ -8,165 +13,500 @@
 #include "tile.h"
 #include "app.h"
 #include "draw.h"
-
-struct Vertices {
-    v3f *positions;
-    v2f *uvs;
-    s64 count;
-};
+#include "jobs.h"
+#include "tile_pool.h"
+#include "tile_index.h"
+#include "projection.h"
+#include "terrain.h"
+#include "profiler.h"
 
 static
-v3f d2_world_from_coordinate_space(f64 lat, f64 lon) {
-    return { (f32) (lon / 90.0) * WORLD_SCALE_2D, (f32) (lat / 90.0) * WORLD_SCALE_2D, 0 };
+Tile_Bounds get_tile_bounds(App *app, Tile *tile, Map_Mode map_mode) {
+    //
+    // The point of a sphere patch farthest away from its center always lies on the
+    // boundary, so sampling the edges of the bounding box is enough to get both the
+    // bounding sphere and the normal cone.
+    //
+    const s64 EDGE_SAMPLES = 5;
+
+    Bounding_Box box = tile->box;
+    f64 lat_center = (box.lat0 + box.lat1) * 0.5;
+    f64 lon_center = (box.lon0 + box.lon1) * 0.5;
+
+    Tile_Bounds bounds;
+    bounds.center     = world_from_coordinate_space(map_mode, lat_center, lon_center);
+    bounds.radius     = 0;
+    bounds.cone_axis  = globe_from_coordinate_space(lat_center, lon_center, 1.0);
+    bounds.cone_angle = 0;
+
+    for(s64 i = 0; i < EDGE_SAMPLES; ++i) {
+        f64 t   = (f64) i / (f64) (EDGE_SAMPLES - 1);
+        f64 lat = box.lat0 + t * (box.lat1 - box.lat0);
+        f64 lon = box.lon0 + t * (box.lon1 - box.lon0);
+
+        Coordinate samples[] = { { box.lat0, lon }, { box.lat1, lon }, { lat, box.lon0 }, { lat, box.lon1 } };
+
+        for(s64 j = 0; j < ARRAY_COUNT(samples); ++j) {
+            v3f point  = world_from_coordinate_space(map_mode, samples[j].lat, samples[j].lon);
+            v3f normal = globe_from_coordinate_space(samples[j].lat, samples[j].lon, 1.0);
+            bounds.radius     = max(bounds.radius, v3_length(point - bounds.center));
+            bounds.cone_angle = max(bounds.cone_angle, acosf(clamp(v3_dot(normal, bounds.cone_axis), -1.0f, 1.0f)));
+        }
+    }
+
+    // The normal cone only means something on the globe.
+    if(map_mode == MAP_MODE_2D) bounds.cone_angle = (f32) PI;
+
+    Terrain *terrain = &app->terrain;
+
+    if(map_mode == MAP_MODE_3D && terrain->heights) {
+        //
+        // Grow the bounds by the highest peak and the deepest trench anywhere, and widen
+        // the cone by how far beyond the horizon a peak still peeks out.
+        //
+        f64 scale = get_terrain_scale();
+        bounds.radius += (f32) (max(fabs(terrain->min_height), fabs(terrain->max_height)) * scale);
+        if(terrain->max_height > 0) bounds.cone_angle += (f32) acos(WORLD_SCALE_3D / (WORLD_SCALE_3D + terrain->max_height * scale));
+    }
+
+    return bounds;
 }
 
-static
-v3f d3_world_from_coordinate_space(f64 lat, f64 lon) {
-    f64 theta = degrees_to_radians(lon);
-    f64 sigma = degrees_to_radians(lat);
-    return { (f32) (sin(theta) * cos(sigma) * WORLD_SCALE_3D), (f32) (sin(sigma) * WORLD_SCALE_3D), (f32) (cos(theta) * cos(sigma) * WORLD_SCALE_3D) };
+void update_tile_bounds(App *app, Tile *tile) {
+    // Both, so that switching the map mode doesn't touch the tiles.
+    tile->bounds[MAP_MODE_2D] = get_tile_bounds(app, tile, MAP_MODE_2D);
+    tile->bounds[MAP_MODE_3D] = get_tile_bounds(app, tile, MAP_MODE_3D);
+}
+
+static inline
+s64 get_edge_vertex(s64 segments, s64 edge, s64 k) {
+    // The k-th grid vertex along the south, north, west and east edge.
+    s64 stride = segments + 1;
+
+    switch(edge) {
+    case 0: return k;
+    case 1: return segments * stride + k;
+    case 2: return k * stride;
+    case 3: return k * stride + segments;
+    }
+
+    return 0;
 }
 
 static
-Vertices create_tile_vertices(Map_Mode map_mode, Bounding_Box box) {
-    Vertices result;
+u16 *create_grid_indices(s64 segments, b8 skirts, s64 *count) {
+    // The triangles of a (segments + 1) * (segments + 1) vertex grid, with the same
+    // winding as the grid vertices produced by create_tile_vertices.
+    s64 stride = segments + 1;
+
+    *count = segments * segments * 6 + (skirts ? 4 * segments * 6 : 0);
+    u16 *indices = (u16 *) temp.allocate(*count * sizeof(u16));
+
+    for(s64 i0 = 0; i0 < segments; ++i0) {
+        for(s64 j0 = 0; j0 < segments; ++j0) {
+            s64 idx = (i0 * segments + j0) * 6;
+
+            u16 p0 = (u16) ((i0 + 0) * stride + j0 + 0);
+            u16 p1 = (u16) ((i0 + 0) * stride + j0 + 1);
+            u16 p2 = (u16) ((i0 + 1) * stride + j0 + 0);
+            u16 p3 = (u16) ((i0 + 1) * stride + j0 + 1);
+
+            indices[idx + 0] = p0;
+            indices[idx + 1] = p2;
+            indices[idx + 2] = p1;
+
+            indices[idx + 3] = p1;
+            indices[idx + 4] = p2;
+            indices[idx + 5] = p3;
+        }
+    }
+
+    if(skirts) {
+        // Each edge connects its grid vertices to the skirt vertices hanging below them.
+        for(s64 edge = 0; edge < 4; ++edge) {
+            for(s64 k = 0; k < segments; ++k) {
+                s64 idx = (segments * segments + edge * segments + k) * 6;
+
+                u16 g0 = (u16) get_edge_vertex(segments, edge, k + 0);
+                u16 g1 = (u16) get_edge_vertex(segments, edge, k + 1);
+                u16 s0 = (u16) (stride * stride + edge * stride + k + 0);
+                u16 s1 = (u16) (stride * stride + edge * stride + k + 1);
 
-    switch(map_mode) {
-    case MAP_MODE_2D: {
-        result.count     = 6;
-        result.positions = (v3f *) temp.allocate(result.count * sizeof(v3f));
-        result.uvs       = (v2f *) temp.allocate(result.count * sizeof(v2f));
-
-        v3f p0, p1, p2, p3;
-        p0 = d2_world_from_coordinate_space(box.lat0, box.lon0);
-        p1 = d2_world_from_coordinate_space(box.lat0, box.lon1);
-        p2 = d2_world_from_coordinate_space(box.lat1, box.lon0);
-        p3 = d2_world_from_coordinate_space(box.lat1, box.lon1);
-
-        result.positions[0] = p0;
-        result.positions[1] = p2;
-        result.positions[2] = p1;
-
-        result.positions[3] = p1;
-        result.positions[4] = p2;
-        result.positions[5] = p3;
-
-        result.uvs[0] = v2f(0, 0);
-        result.uvs[1] = v2f(0, 1);
-        result.uvs[2] = v2f(1, 0);
-
-        result.uvs[3] = v2f(1, 0);
-        result.uvs[4] = v2f(0, 1);
-        result.uvs[5] = v2f(1, 1);
-    } break;
-
-    case MAP_MODE_3D: {
-        const s64 SEGMENTS = 32;
-
-        result.count     = SEGMENTS * SEGMENTS * 6;
-        result.positions = (v3f *) temp.allocate(result.count * sizeof(v3f));
-        result.uvs       = (v2f *) temp.allocate(result.count * sizeof(v2f));
-
-        for(s64 i0 = 0; i0 < SEGMENTS; ++i0) {
-            s64 i1 = i0 + 1;
-
-            f64 t0 = (f64) i0 / (f64) SEGMENTS;
-            f64 t1 = (f64) i1 / (f64) SEGMENTS;
-
-            for(s64 j0 = 0; j0 < SEGMENTS; ++j0) {
-                s64 j1 = j0 + 1;
-
-                s64 idx = (i0 * SEGMENTS + j0) * 6;
-
-                f64 u0 = (f64) j0 / (f64) SEGMENTS;
-                f64 u1 = (f64) j1 / (f64) SEGMENTS;
-
-                f64 lat0 = box.lat0 + t0 * (box.lat1 - box.lat0);
-                f64 lat1 = box.lat0 + t1 * (box.lat1 - box.lat0);
-                f64 lon0 = box.lon0 + u0 * (box.lon1 - box.lon0);
-                f64 lon1 = box.lon0 + u1 * (box.lon1 - box.lon0);
-
-                v3f p0, p1, p2, p3;
-                p0 = d3_world_from_coordinate_space(lat0, lon0);
-                p1 = d3_world_from_coordinate_space(lat0, lon1);
-                p2 = d3_world_from_coordinate_space(lat1, lon0);
-                p3 = d3_world_from_coordinate_space(lat1, lon1);
-
-                result.positions[idx + 0] = p0;
-                result.positions[idx + 1] = p2;
-                result.positions[idx + 2] = p1;
-
-                result.positions[idx + 3] = p1;
-                result.positions[idx + 4] = p2;
-                result.positions[idx + 5] = p3;
-
-                v2f uv0, uv1, uv2, uv3; // @Incomplete: Adjust these UVS according to the equirectangular projection
-                uv0 = v2f((f32) u0, (f32) t0);
-                uv1 = v2f((f32) u0, (f32) t1);
-                uv2 = v2f((f32) u1, (f32) t0);
-                uv3 = v2f((f32) u1, (f32) t1);
-
-                result.uvs[idx + 0] = uv0;
-                result.uvs[idx + 1] = uv2;
-                result.uvs[idx + 2] = uv1;
-                
-                result.uvs[idx + 3] = uv1;
-                result.uvs[idx + 4] = uv2;
-                result.uvs[idx + 5] = uv3;
+                indices[idx + 0] = g0;
+                indices[idx + 1] = s0;
+                indices[idx + 2] = g1;
+
+                indices[idx + 3] = g1;
+                indices[idx + 4] = s0;
+                indices[idx + 5] = s1;
             }
         }
-    } break;
     }
 
+    return indices;
+}
+
+G_Handle get_tile_index_buffer(App *app, s64 segments) {
+    assert(segments > 0 && segments <= TILE_MAX_SEGMENTS);
+
+    if(!app->tile_index_buffers[segments]) {
+        s64 tmp_mark = mark_temp_allocator();
+        
+        // Only tile meshes have skirts, the instanced unit grid can't displace anything.
+        s64 count;
+        u16 *indices = create_grid_indices(segments, draw_requires_tile_meshes(), &count);
+        app->tile_index_buffers[segments] = create_index_buffer(app, indices, count);
+        
+        release_temp_allocator(tmp_mark);
+    }
+
+    return app->tile_index_buffers[segments];
+}
+
+static inline
+f64 get_tile_angle(s64 level) {
+    // Along the longer (longitude) side of a tile, in radians.
+    return degrees_to_radians(360.0 / (f64) ((s64) 1 << level));
+}
+
+f64 get_tile_geometric_error(Map_Mode map_mode, s64 level, s64 segments, Terrain *terrain) {
+    if(map_mode == MAP_MODE_2D) return 0; // The map is flat and has no elevation
+
+    // How far the middle of a segment lies below the sphere, plus the terrain missed between the vertices.
+    f64 curvature = WORLD_SCALE_3D * (1.0 - cos(get_tile_angle(level) / (f64) segments * 0.5));
+    return curvature + get_terrain_error(terrain, level, segments);
+}
+
+s64 get_tile_segments(Map_Mode map_mode, s64 level, Terrain *terrain) {
+    //
+    // The LOD splits a tile once one of its texels covers LOD_SPLIT_THRESHOLD pixels,
+    // so the world space size of a texel on this level tells how large a geometric
+    // error may get before it shows up as TILE_MAX_GEOMETRIC_ERROR pixels. Coarse tiles
+    // only follow the curvature of the globe, whereas the terrain needs finer grids the
+    // deeper (and closer to the camera) a tile gets, until they resolve the DEM.
+    //
+    if(map_mode == MAP_MODE_2D) return 1;
+
+    f64 texel_size = WORLD_SCALE_3D * get_tile_angle(level) / TILE_TEXTURE_RESOLUTION;
+    f64 max_error  = texel_size * TILE_MAX_GEOMETRIC_ERROR / LOD_SPLIT_THRESHOLD;
+
+    s64 segments = 1;
+    while(segments < TILE_MAX_SEGMENTS && get_tile_geometric_error(map_mode, level, segments, terrain) > max_error) segments *= 2;
+    return segments;
+}
+
+static
+f64 get_tile_skirt_depth(s64 level, Terrain *terrain) {
+    // The edge of a coarser neighbour may be off by that neighbour's geometric error,
+    // and the edge of this tile by its own one in the other direction. Only the globe
+    // has cracks to hide.
+    f64 neighbour_error = 0;
+
+    for(s64 coarser = max<s64>(level - TILE_SKIRT_LEVELS, 0); coarser < level; ++coarser) {
+        neighbour_error = max(neighbour_error, get_tile_geometric_error(MAP_MODE_3D, coarser, get_tile_segments(MAP_MODE_3D, coarser, terrain), terrain));
+    }
+
+    return neighbour_error + get_tile_geometric_error(MAP_MODE_3D, level, get_tile_segments(MAP_MODE_3D, level, terrain), terrain);
+}
+
+s64 get_tile_vertex_count(s64 segments) {
+    s64 stride = segments + 1;
+    return stride * stride + 4 * stride;
+}
+
+Vertices allocate_tile_vertices(Allocator *allocator, s64 segments) {
+    Vertices result;
+    result.segments  = segments;
+    result.count     = get_tile_vertex_count(segments);
+    result.data      = (Tile_Vertex *) allocator->allocate(result.count * sizeof(Tile_Vertex));
+    result.range     = Tile_Vertex_Range{};
     return result;
 }
 
-void create_tile(App *app, Tile *tile, Bounding_Box box) {
-    Hardware_Time start = os_get_hardware_time();
+void create_tile_vertices(Vertices *vertices, Allocator *scratch, Bounding_Box box, s64 level, Terrain *terrain) {
+    //
+    // Every tile is a regular grid of (segments + 1) * (segments + 1) unique vertices,
+    // which are connected through an index buffer shared by all tiles with the same
+    // segment count. This may run on a worker thread, so it must only touch the
+    // vertices and the scratch allocator, and only read the terrain.
+    // The grid is followed by a skirt of segments + 1 vertices per edge (south, north,
+    // west, east), which hang below the edge to hide the cracks towards neighbours of
+    // a different level.
+    //
+    s64 stride = vertices->segments + 1;
+
+    f64 *lats    = (f64 *) scratch->allocate(stride * sizeof(f64));
+    f64 *lons    = (f64 *) scratch->allocate(stride * sizeof(f64));
+    u16 *steps   = (u16 *) scratch->allocate(stride * sizeof(u16));
+    f32 *heights = (f32 *) scratch->allocate(stride * stride * sizeof(f32));
+
+    for(s64 i = 0; i < stride; ++i) {
+        f64 t = (f64) i / (f64) vertices->segments;
+        lats[i]  = box.lat0 + t * (box.lat1 - box.lat0);
+        lons[i]  = box.lon0 + t * (box.lon1 - box.lon0);
+        steps[i] = (u16) (i * (s64) TILE_VERTEX_STEPS / vertices->segments); // Exactly 0 and TILE_VERTEX_STEPS on the edges
+    }
+
+    b8 elevation = terrain && terrain->heights;
+    f64 scale    = get_terrain_scale();
+
+    f32 lowest = 0, highest = 0;
+
+    for(s64 i = 0; i < stride; ++i) {
+        for(s64 j = 0; j < stride; ++j) {
+            f32 height = elevation ? (f32) (sample_terrain(terrain, lats[i], lons[j]) * scale) : 0.0f;
+            heights[i * stride + j] = height;
+
+            if(i == 0 && j == 0) lowest = highest = height;
+            lowest  = min(lowest, height);
+            highest = max(highest, height);
+        }
+    }
+
+    f32 skirt_depth = (f32) get_tile_skirt_depth(level, terrain);
+
+    Tile_Vertex_Range *range = &vertices->range;
+    range->lat0    = (f32) box.lat0;
+    range->lon0    = (f32) box.lon0;
+    range->lat1    = (f32) box.lat1;
+    range->lon1    = (f32) box.lon1;
+    range->height0 = lowest - skirt_depth;
+    range->height1 = highest;
+
+    f32 height_steps = (range->height1 > range->height0) ? TILE_VERTEX_STEPS / (range->height1 - range->height0) : 0.0f;
+
+    for(s64 i = 0; i < stride; ++i) {
+        for(s64 j = 0; j < stride; ++j) {
+            f32 height = (heights[i * stride + j] - range->height0) * height_steps;
+            vertices->data[i * stride + j] = Tile_Vertex{ steps[j], steps[i], (u16) clamp(height + 0.5f, 0.0f, TILE_VERTEX_STEPS), 0 };
+        }
+    }
+
+    for(s64 edge = 0; edge < 4; ++edge) {
+        for(s64 k = 0; k < stride; ++k) {
+            s64 grid_vertex  = get_edge_vertex(vertices->segments, edge, k);
+            s64 skirt_vertex = stride * stride + edge * stride + k;
+
+            f32 height = (heights[grid_vertex] - skirt_depth - range->height0) * height_steps;
+
+            Tile_Vertex vertex = vertices->data[grid_vertex];
+            vertex.height = (u16) clamp(height + 0.5f, 0.0f, TILE_VERTEX_STEPS);
+            vertices->data[skirt_vertex] = vertex;
+        }
+    }
+
+    scratch->deallocate(heights);
+    scratch->deallocate(steps);
+    scratch->deallocate(lons);
+    scratch->deallocate(lats);
+}
+
+
+
+//
+// Tile meshes are generated asynchronously: The main thread allocates a job with room
+// for the vertices and submits it to the job system. A worker fills in the vertices,
+// and flush_tile_jobs later uploads the finished mesh on the main thread. Until then
+// the tile is pending (tile->job is set) and keeps drawing its previous mesh, if any.
+//
+struct Tile_Job {
+    Tile *tile; // Null once the tile got destroyed while the job was still in flight
+    Bounding_Box box;
+    s64 level;
+    Terrain *terrain; // Not destroyed before all jobs are done
+    Vertices vertices;
+    std::atomic<b8> done;
+    Tile_Job *next;
+};
+
+static
+void generate_tile_mesh(void *user_data, Allocator *scratch) {
+    PROFILE_ZONE("Generate tile mesh");
+
+    Tile_Job *job = (Tile_Job *) user_data;
+    create_tile_vertices(&job->vertices, scratch, job->box, job->level, job->terrain);
+    job->done.store(true, std::memory_order_release);
+}
+
+static
+void cancel_tile_job(Tile *tile) {
+    if(tile->job) {
+        // The job memory is still owned by the worker, flush_tile_jobs frees it once done.
+        tile->job->tile = null;
+        tile->job = null;
+    }
+}
+
+static
+void request_tile_mesh(App *app, Tile *tile, Job_Priority priority = JOB_PRIORITY_High) {
+    cancel_tile_job(tile);
+
+    // The instanced renderer projects a shared unit grid itself.
+    if(!draw_requires_tile_meshes()) return;
+
+    Tile_Job *job = new (app->allocator.allocate(sizeof(Tile_Job))) Tile_Job(); // std::atomic is not assignable
+    job->tile     = tile;
+    job->box      = tile->box;
+    job->level    = tile->level;
+    job->terrain  = &app->terrain;
+    job->vertices = allocate_tile_vertices(&app->allocator, get_tile_segments(MAP_MODE_3D, tile->level, &app->terrain));
+    job->done.store(false, std::memory_order_relaxed);
+    job->next     = app->tile_jobs;
+    app->tile_jobs = job;
+
+    tile->job = job;
+    submit_job(generate_tile_mesh, job, priority);
+}
+
+static
+void replace_tile_mesh(App *app, Tile *tile, Vertices *vertices) {
+    PROFILE_COUNT(PROFILE_COUNTER_Bytes_Uploaded, vertices->count * (s64) sizeof(Tile_Vertex));
+
+    if(tile->mesh && tile->segments == vertices->segments) {
+        // Same layout as before (e.g. after a merge), just overwrite the vertex data.
+        update_mesh(app, tile->mesh, vertices->data, vertices->count, &vertices->range);
+        ++app->tile_pool.stats.meshes_reused;
+    } else {
+        if(tile->mesh) release_tile_mesh(app, tile->mesh, tile->segments);
+        tile->mesh = acquire_tile_mesh(app, vertices->data, vertices->count, &vertices->range, vertices->segments);
+    }
+
+    tile->segments = vertices->segments;
+}
+
+static
+void create_tile_mesh_now(App *app, Tile *tile) {
+    if(!draw_requires_tile_meshes()) return;
+
     s64 tmp_mark = mark_temp_allocator();
 
-    Vertices vertices = create_tile_vertices(app->map_mode, box);
+    Vertices vertices = allocate_tile_vertices(&temp, get_tile_segments(MAP_MODE_3D, tile->level, &app->terrain));
+    create_tile_vertices(&vertices, &temp, tile->box, tile->level, &app->terrain);
+    replace_tile_mesh(app, tile, &vertices);
+
+    release_temp_allocator(tmp_mark);
+}
+
+static
+void release_tile_resources(App *app, Tile *tile) {
+    if(tile->texture) release_tile_texture(app, tile->texture, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_CHANNELS);
+    if(tile->mesh) release_tile_mesh(app, tile->mesh, tile->segments);
+    tile->texture = null;
+    tile->mesh    = null;
+}
+
+b8 tile_has_geometry(Tile *tile) {
+    return tile->texture && (tile->mesh || !draw_requires_tile_meshes());
+}
+
+static
+b8 tile_is_drawable(Tile *tile) {
+    // Either the tile has its own geometry, or it was split and its children took over.
+    return tile_has_geometry(tile) || (!tile->leaf && !tile->texture);
+}
+
+static
+void maybe_release_parent_resources(App *app, Tile *parent) {
+    // A parent keeps drawing its own mesh after a split until all of its children are ready.
+    if(!parent || parent->leaf || !parent->texture) return;
+
+    for(s64 i = 0; i < ARRAY_COUNT(parent->children); ++i) {
+        if(!tile_is_drawable(parent->children[i])) return;
+    }
+
+    cancel_tile_job(parent);
+    release_tile_resources(app, parent);
+    parent->state = TILE_Empty;
+
+    // The grandparent may have been waiting for this tile to become drawable.
+    maybe_release_parent_resources(app, parent->parent);
+}
+
+void flush_tile_jobs(App *app) {
+    Tile_Job **link = &app->tile_jobs;
+
+    while(*link) {
+        Tile_Job *job = *link;
+
+        if(!job->done.load(std::memory_order_acquire)) {
+            link = &job->next;
+            continue;
+        }
+
+        if(job->tile) {
+            Tile *tile = job->tile;
+            replace_tile_mesh(app, tile, &job->vertices);
+            tile->job = null;
+
+            maybe_release_parent_resources(app, tile->parent);
+        }
+
+        *link = job->next;
+        app->allocator.deallocate(job->vertices.data);
+        app->allocator.deallocate(job);
+    }
+}
+
+void wait_for_tile_jobs(App *app) {
+    while(app->tile_jobs) {
+        flush_tile_jobs(app);
+        std::this_thread::yield();
+    }
+}
+
+void create_tile(App *app, Tile *tile, Bounding_Box box, Job_Priority priority) {
+    PROFILE_ZONE("Create tile");
+    PROFILE_COUNT(PROFILE_COUNTER_Tiles_Created, 1);
 
     tile->box     = box;
-    tile->texture = create_empty_texture(app, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_CHANNELS);
-    tile->mesh    = create_mesh(app, vertices.positions[0].values, vertices.uvs[0].values, vertices.count);
-    tile->state   = TILE_Requires_Repainting;
+    update_tile_bounds(app, tile);
+    tile->texture = acquire_tile_texture(app, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_CHANNELS);
+    tile->mesh    = null;
+    tile->job     = null;
     tile->leaf    = true;
+    tile->last_visible_frame = app->residency.frame_index;
+    mark_tile_for_repainting(tile);
+    insert_tile(app, tile);
 
-    release_temp_allocator(tmp_mark);
-    Hardware_Time end = os_get_hardware_time();
-    log(LOG_Debug, "Created tile [%f;%f -> %f;%f]: %fms.", box.lat0, box.lon0, box.lat1, box.lon1, os_convert_hardware_time(end - start, Milliseconds));
+    request_tile_mesh(app, tile, priority);
 }
 
 void destroy_tile(App *app, Tile *tile, bool recursive) {
-    Hardware_Time start = os_get_hardware_time();
-    
+    PROFILE_ZONE("Destroy tile");
+    PROFILE_COUNT(PROFILE_COUNTER_Tiles_Destroyed, 1);
+
     if(!tile->leaf && recursive) {
         for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
             destroy_tile(app, tile->children[i], recursive);
-            app->allocator.deallocate(tile->children[i]);
         }
+
+        free_tile_children(app, tile->children[0]);
     }
 
-    if(tile->state != TILE_Empty) {
-        destroy_texture(app, tile->texture);
-        destroy_mesh(app, tile->mesh);
-        tile->texture = null;
-        tile->mesh    = null;
-        tile->state   = TILE_Empty;
+    cancel_tile_job(tile);
+    release_tile_resources(app, tile);
+    remove_tile(app, tile);
+    tile->state = TILE_Empty;
+}
+
+void destroy_tile_index_buffers(App *app) {
+    for(s64 i = 0; i < ARRAY_COUNT(app->tile_index_buffers); ++i) {
+        if(app->tile_index_buffers[i]) {
+            destroy_index_buffer(app, app->tile_index_buffers[i]);
+            app->tile_index_buffers[i] = null;
+        }
     }
-    
-    Hardware_Time end = os_get_hardware_time();
-    log(LOG_Debug, "Destroyed tile [%f;%f -> %f;%f]: %fms.", tile->box.lat0, tile->box.lon0, tile->box.lat1, tile->box.lon1, os_convert_hardware_time(end - start, Milliseconds));
 }
 
-void subdivide_tile(App *app, Tile *tile) {
+void subdivide_tile(App *app, Tile *tile, Job_Priority priority) {
     assert(tile->leaf);
     tile->leaf = false;
 
     f64 half_lat   = (tile->box.lat1 - tile->box.lat0) * 0.5;
     f64 half_lon   = (tile->box.lon1 - tile->box.lon0) * 0.5;
 
+    Tile *children = allocate_tile_children(app);
+
     for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
         f64 lat_offset = (f64) (i / 2);
         f64 lon_offset = (f64) (i % 2);
@@ -176,11 +516,41 @@ void subdivide_tile(App *app, Tile *tile) {
                                    tile->box.lat0 + half_lat * (lat_offset + 1),
                                    tile->box.lon0 + half_lon * (lon_offset + 1) };
 
-        tile->children[i] = (Tile *) app->allocator.allocate(sizeof(Tile));
-        create_tile(app, tile->children[i], child_box);
+        tile->children[i] = &children[i];
+        tile->children[i]->parent = tile;
+        tile->children[i]->level  = tile->level + 1;
+        tile->children[i]->x      = tile->x * 2 + i % 2;
+        tile->children[i]->y      = tile->y * 2 + i / 2;
+        create_tile(app, tile->children[i], child_box, priority);
+    }
+
+    // The resources of this tile are released once all children have their meshes,
+    // which is right away if tiles don't need meshes.
+    maybe_release_parent_resources(app, tile);
+}
+
+void merge_tile(App *app, Tile *tile) {
+    assert(!tile->leaf);
+
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+        destroy_tile(app, tile->children[i], true);
+    }
+
+    free_tile_children(app, tile->children[0]);
+
+    for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+        tile->children[i] = null;
     }
 
-    destroy_tile(app, tile, false);
+    tile->leaf = true;
+
+    if(!tile->texture) {
+        // Generate the coarser mesh right away, so that there is no frame in which
+        // neither the children nor the parent can be drawn.
+        tile->texture = acquire_tile_texture(app, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_RESOLUTION, TILE_TEXTURE_CHANNELS);
+        mark_tile_for_repainting(tile);
+        create_tile_mesh_now(app, tile);
+    }
 }
 
 void maybe_regenerate_tiles(App *app, Tile *tile) {
@@ -188,19 +558,58 @@ void maybe_regenerate_tiles(App *app, Tile *tile) {
         if(tile->state == TILE_Empty) {
             create_tile(app, tile, tile->box);
         } else if(tile->state == TILE_Requires_Regeneration) {
-            destroy_tile(app, tile, false);
-            create_tile(app, tile, tile->box);
+            // Keep the texture and the old mesh around until the new mesh is ready.
+            update_tile_bounds(app, tile);
+            request_tile_mesh(app, tile);
+            mark_tile_for_repainting(tile);
         }
     } else {
         if(tile->state == TILE_Requires_Regeneration) {
+            update_tile_bounds(app, tile);
+            if(tile->texture) request_tile_mesh(app, tile); // Still drawn while the children are pending
+
             for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
                 tile->children[i]->state = TILE_Requires_Regeneration;
                 maybe_regenerate_tiles(app, tile->children[i]);
             }
     
-            tile->state = TILE_Empty;
-        } else {
-            assert(tile->state == TILE_Empty);
+            if(tile->texture) {
+                mark_tile_for_repainting(tile);
+            } else {
+                tile->state = TILE_Empty;
+            }
+        }
+    }
+}
+
+void mark_tile_for_repainting(Tile *tile) {
+    tile->state = TILE_Requires_Repainting;
+
+    // Flag the path to the root, so that the repaint pass can skip every clean subtree.
+    for(Tile *parent = tile->parent; parent && !parent->children_require_repainting; parent = parent->parent) {
+        parent->children_require_repainting = true;
+    }
+}
+
+static
+b8 bounding_boxes_overlap(Bounding_Box lhs, Bounding_Box rhs) {
+    return lhs.lat0 < rhs.lat1 && rhs.lat0 < lhs.lat1 && lhs.lon0 < rhs.lon1 && rhs.lon0 < lhs.lon1;
+}
+
+static
+void invalidate_tiles(Tile *tile, Bounding_Box region) {
+    if(!bounding_boxes_overlap(tile->box, region)) return;
+
+    // Tiles without a texture are not drawn, they get repainted when they receive one.
+    if(tile->texture && tile->state == TILE_Valid) mark_tile_for_repainting(tile);
+
+    if(!tile->leaf) {
+        for(s64 i = 0; i < ARRAY_COUNT(tile->children); ++i) {
+            invalidate_tiles(tile->children[i], region);
         }
     }
 }
+
+void invalidate_tiles(App *app, Bounding_Box region) {
+    invalidate_tiles(&app->root, region);
+}
@@ -1,13 +1,23 @@
 #pragma once
 
 #include <foundation.h>
+#include <math/v2.h>
+#include <math/v3.h>
+
+#include "jobs.h"
 
 #define TILE_TEXTURE_RESOLUTION 16
 #define TILE_TEXTURE_CHANNELS 4 // D3D11 doesn't support actual RBG, only RGBA
+#define TILE_MAX_SEGMENTS 64 // (64 + 1)^2 vertices still fit into 16-bit indices
+#define TILE_MAX_VERTICES ((TILE_MAX_SEGMENTS + 1) * (TILE_MAX_SEGMENTS + 1) + 4 * (TILE_MAX_SEGMENTS + 1))
+#define TILE_MAX_GEOMETRIC_ERROR 1.0 // In pixels, of a tile mesh about to be split, see get_tile_segments
+#define TILE_SKIRT_LEVELS 4 // Coarser neighbours whose cracks the skirts cover
 
 typedef void *G_Handle;
 struct App;
-enum Map_Mode;
+struct Tile_Job;
+struct Terrain;
+enum Map_Mode : s32;
 
 struct Coordinate {
     f64 lat;
@@ -26,18 +36,87 @@ enum Tile_State {
     TILE_Valid,
 };
 
+struct Tile_Bounds {
+    v3f center; // Bounding sphere in world space
+    f32 radius;
+    v3f cone_axis; // Cone containing all surface normals of the tile on the globe
+    f32 cone_angle;
+};
+
+//
+// Tile meshes serve both map modes, so their positions are in tile space: x is the
+// longitude and y the latitude in degrees, z the elevation above the globe in its world
+// units (negative for the skirts). The vertex shader projects them into the world of
+// the current map mode (see world_from_tile_space), or morphs between both. They are
+// always as fine as the globe needs them.
+// The vertices are quantized to 16 bits across the box and the height range of their
+// tile, which is a quarter of the memory and bandwidth of f32 positions and uvs. The
+// texture coordinates are the offsets across the box, so they aren't stored at all.
+// This only concerns the tile meshes: the instanced tiles (DRAW_TILES_INSTANCED) have
+// no vertices of their own, all of them share one small unit grid per map mode.
+//
+#define TILE_VERTEX_STEPS 65535.0f
+
+struct Tile_Vertex {
+    u16 x, y; // From the west to the east and from the south to the north edge
+    u16 height; // From the bottom to the top of the height range
+    u16 padding;
+};
+
+struct Tile_Vertex_Range {
+    f32 lat0, lon0, lat1, lon1; // The box of the tile
+    f32 height0, height1; // Including the skirts
+};
+
+struct Vertices {
+    Tile_Vertex *data;
+    Tile_Vertex_Range range;
+    s64 count;
+    s64 segments; // The vertices form a (segments + 1) * (segments + 1) grid, followed by the skirts
+};
+
+static inline
+v3f decode_tile_vertex(Tile_Vertex_Range *range, Tile_Vertex vertex) {
+    // Like world_mesh.hlsl, with the endpoint-exact form, so that neighbouring tiles share their edges.
+    f32 u = vertex.x / TILE_VERTEX_STEPS, v = vertex.y / TILE_VERTEX_STEPS, h = vertex.height / TILE_VERTEX_STEPS;
+    return v3f(range->lon0 * (1 - u) + range->lon1 * u, range->lat0 * (1 - v) + range->lat1 * v, range->height0 * (1 - h) + range->height1 * h);
+}
+
 struct Tile {
     Bounding_Box box;
+    Tile_Bounds bounds[2]; // Per map mode
+    Tile *parent;
     Tile *children[4];
 
     G_Handle texture;
-    G_Handle mesh;
+    G_Handle mesh; // Null until the first mesh of this tile was uploaded
+    s64 segments;  // Of the current mesh
+    Tile_Job *job; // Set while a new mesh is being generated
 
     Tile_State state;
+    s64 level; // The root is level 0
+    s64 x, y; // Position in the grid of this level, see tile_index.h
+    s64 last_visible_frame; // See residency.h
+    s64 last_predicted_frame; // Last frame in which the prefetcher expected the children of this tile to be needed
     b8 leaf;
+    b8 children_require_repainting; // Some tile below this one requires repainting
 };
 
-void create_tile(App *app, Tile *tile, Bounding_Box box);
+f64 get_tile_geometric_error(Map_Mode map_mode, s64 level, s64 segments, Terrain *terrain); // In world units, the terrain may be null
+s64 get_tile_segments(Map_Mode map_mode, s64 level, Terrain *terrain);
+s64 get_tile_vertex_count(s64 segments);
+Vertices allocate_tile_vertices(Allocator *allocator, s64 segments);
+void create_tile_vertices(Vertices *vertices, Allocator *scratch, Bounding_Box box, s64 level, Terrain *terrain);
+void update_tile_bounds(App *app, Tile *tile);
+b8 tile_has_geometry(Tile *tile); // Whether the tile can be drawn by itself
+void create_tile(App *app, Tile *tile, Bounding_Box box, Job_Priority priority = JOB_PRIORITY_High); // The priority of the mesh job
 void destroy_tile(App *app, Tile *tile, bool recursive);
-void subdivide_tile(App *app, Tile *tile);
+G_Handle get_tile_index_buffer(App *app, s64 segments);
+void destroy_tile_index_buffers(App *app);
+void subdivide_tile(App *app, Tile *tile, Job_Priority priority = JOB_PRIORITY_High);
+void merge_tile(App *app, Tile *tile);
 void maybe_regenerate_tiles(App *app, Tile *tile);
+void mark_tile_for_repainting(Tile *tile);
+void invalidate_tiles(App *app, Bounding_Box region);
+void flush_tile_jobs(App *app);
+void wait_for_tile_jobs(App *app);
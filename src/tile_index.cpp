@@ -0,0 +1,147 @@
+// --- C
+#include <math.h>
+#include <string.h>
+
+// --- Foundation
+#include <foundation.h>
+#include <memutils.h>
+
+// --- App
+#include "app.h"
+#include "tile.h"
+#include "tile_index.h"
+#include "pyramid.h"
+
+static inline
+s64 get_slot(Tile_Index *index, u64 key) {
+    // Fibonacci hashing spreads the Morton codes of neighbouring tiles over the whole table.
+    return (s64) ((key * 0x9e3779b97f4a7c15ull) >> index->shift);
+}
+
+static
+void allocate_slots(App *app, Tile_Index *index, s64 capacity) {
+    index->keys     = (u64 *) app->allocator.allocate(capacity * sizeof(u64));
+    index->tiles    = (Tile **) app->allocator.allocate(capacity * sizeof(Tile *));
+    index->capacity = capacity;
+    index->count    = 0;
+    index->shift    = 64;
+    for(s64 i = capacity; i > 1; i /= 2) --index->shift;
+
+    memset(index->tiles, 0, capacity * sizeof(Tile *));
+}
+
+static
+void insert_key(Tile_Index *index, u64 key, Tile *tile) {
+    s64 mask = index->capacity - 1;
+    s64 slot = get_slot(index, key);
+
+    while(index->tiles[slot] && index->keys[slot] != key) slot = (slot + 1) & mask;
+
+    if(!index->tiles[slot]) ++index->count;
+    index->keys[slot]  = key;
+    index->tiles[slot] = tile;
+}
+
+static
+void grow_tile_index(App *app) {
+    Tile_Index *index = &app->tile_index;
+    Tile_Index previous = *index;
+
+    allocate_slots(app, index, previous.capacity * 2);
+
+    for(s64 i = 0; i < previous.capacity; ++i) {
+        if(previous.tiles[i]) insert_key(index, previous.keys[i], previous.tiles[i]);
+    }
+
+    app->allocator.deallocate(previous.keys);
+    app->allocator.deallocate(previous.tiles);
+}
+
+static inline
+u64 get_tile_key(Tile *tile) {
+    return get_tile_pyramid_key(tile->level, tile->x, tile->y);
+}
+
+void create_tile_index(App *app) {
+    allocate_slots(app, &app->tile_index, TILE_INDEX_MIN_CAPACITY);
+}
+
+void destroy_tile_index(App *app) {
+    app->allocator.deallocate(app->tile_index.keys);
+    app->allocator.deallocate(app->tile_index.tiles);
+    app->tile_index = Tile_Index{};
+}
+
+s64 get_tile_index_bytes(Tile_Index *index) {
+    return index->capacity * (s64) (sizeof(u64) + sizeof(Tile *));
+}
+
+void insert_tile(App *app, Tile *tile) {
+    // Linear probing stays fast as long as at least half of the slots are empty.
+    if((app->tile_index.count + 1) * 2 > app->tile_index.capacity) grow_tile_index(app);
+
+    insert_key(&app->tile_index, get_tile_key(tile), tile);
+}
+
+void remove_tile(App *app, Tile *tile) {
+    Tile_Index *index = &app->tile_index;
+    s64 mask = index->capacity - 1;
+    u64 key  = get_tile_key(tile);
+    s64 slot = get_slot(index, key);
+
+    while(index->tiles[slot] && index->keys[slot] != key) slot = (slot + 1) & mask;
+    if(index->tiles[slot] != tile) return;
+
+    //
+    // Instead of leaving a tombstone, move later entries of the probe sequence into the
+    // hole if the hole lies between their home slot and their current slot. That way
+    // lookups never have to skip over removed entries, however much the LOD churns.
+    //
+    s64 hole = slot;
+
+    for(s64 next = (hole + 1) & mask; index->tiles[next]; next = (next + 1) & mask) {
+        s64 home = get_slot(index, index->keys[next]);
+
+        if(((next - home) & mask) >= ((next - hole) & mask)) {
+            index->keys[hole]  = index->keys[next];
+            index->tiles[hole] = index->tiles[next];
+            hole = next;
+        }
+    }
+
+    index->tiles[hole] = null;
+    --index->count;
+}
+
+void get_tile_position(s64 level, Coordinate coordinate, s64 *x, s64 *y) {
+    s64 tiles_per_side = (s64) 1 << level;
+    *x = clamp((s64) floor((coordinate.lon + 180.0) / 360.0 * tiles_per_side), 0, tiles_per_side - 1); // The east and north edges belong to the last tile
+    *y = clamp((s64) floor((coordinate.lat + 90.0) / 180.0 * tiles_per_side), 0, tiles_per_side - 1);
+}
+
+Tile *find_tile(App *app, s64 level, s64 x, s64 y) {
+    Tile_Index *index = &app->tile_index;
+    s64 mask = index->capacity - 1;
+    u64 key  = get_tile_pyramid_key(level, x, y);
+
+    for(s64 slot = get_slot(index, key); index->tiles[slot]; slot = (slot + 1) & mask) {
+        if(index->keys[slot] == key) return index->tiles[slot];
+    }
+
+    return null;
+}
+
+Tile *find_tile(App *app, s64 level, Coordinate coordinate) {
+    s64 x, y;
+    get_tile_position(level, coordinate, &x, &y);
+    return find_tile(app, level, x, y);
+}
+
+Tile *find_tile_neighbour(App *app, Tile *tile, s64 dx, s64 dy) {
+    s64 tiles_per_side = (s64) 1 << tile->level;
+    s64 x = tile->x + dx, y = tile->y + dy;
+    if(y < 0 || y >= tiles_per_side) return null;
+
+    x = ((x % tiles_per_side) + tiles_per_side) % tiles_per_side;
+    return find_tile(app, tile->level, x, y);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <foundation.h>
+
+struct App;
+struct Tile;
+struct Coordinate;
+
+//
+// Every tile in the quadtree has an address: its level and its x (west to east) and
+// y (south to north) position in the 2^level by 2^level grid of that level, the same
+// one the tile pyramids use (pyramid.h). The tile index maps these addresses to the
+// live tiles through an open addressing hash table keyed by get_tile_pyramid_key, so
+// finding the tile at a given level and coordinate, or the neighbour of a tile, is a
+// single lookup instead of a walk down from the root.
+// Tiles are added to the index by create_tile and removed by destroy_tile. Pointers
+// returned by the lookups are only valid until the next LOD update.
+//
+
+#define TILE_INDEX_MIN_CAPACITY 1024 // Slots, always a power of two
+
+struct Tile_Index {
+    u64 *keys;
+    Tile **tiles; // Null for empty slots
+    s64 capacity;
+    s64 count;
+    s64 shift; // 64 - log2(capacity), to map hashes onto slots
+};
+
+void create_tile_index(App *app);
+void destroy_tile_index(App *app);
+s64 get_tile_index_bytes(Tile_Index *index);
+
+void insert_tile(App *app, Tile *tile); // Replaces any tile with the same address
+void remove_tile(App *app, Tile *tile);
+
+void get_tile_position(s64 level, Coordinate coordinate, s64 *x, s64 *y); // Of the tile at this level containing the coordinate
+Tile *find_tile(App *app, s64 level, s64 x, s64 y);
+Tile *find_tile(App *app, s64 level, Coordinate coordinate);
+Tile *find_tile_neighbour(App *app, Tile *tile, s64 dx, s64 dy); // Of the same level, wraps around the antimeridian but not over the poles
@@ -0,0 +1,202 @@
+// --- Foundation
+#include <foundation.h>
+#include <memutils.h>
+
+// --- App
+#include "app.h"
+#include "draw.h"
+#include "tile.h"
+#include "tile_pool.h"
+
+struct Tile_Chunk {
+    Tile_Chunk *next;
+    Tile tiles[TILE_POOL_CHUNK_SIZE * 4];
+};
+
+struct Free_Tile_Block {
+    // Overlaid on top of the four tiles of a block while it is in the free list.
+    Free_Tile_Block *next;
+};
+
+static
+Resource_Bucket *find_bucket(Resource_Bucket *buckets, s64 key) {
+    Resource_Bucket *empty = null;
+
+    for(s64 i = 0; i < RESOURCE_CACHE_BUCKETS; ++i) {
+        if(buckets[i].key == key) return &buckets[i];
+        if(!empty && buckets[i].key == 0) empty = &buckets[i];
+    }
+
+    if(empty) empty->key = key;
+    return empty;
+}
+
+static
+G_Handle pop_handle(Resource_Bucket *buckets, s64 key) {
+    Resource_Bucket *bucket = find_bucket(buckets, key);
+    if(!bucket || bucket->count == 0) return null;
+    
+    --bucket->count;
+    return bucket->handles[bucket->count];
+}
+
+static
+b8 push_handle(Resource_Bucket *buckets, s64 key, G_Handle handle) {
+    Resource_Bucket *bucket = find_bucket(buckets, key);
+    if(!bucket || bucket->count == RESOURCE_CACHE_LIMIT) return false;
+
+    bucket->handles[bucket->count] = handle;
+    ++bucket->count;
+    return true;
+}
+
+static inline
+s64 texture_key(s64 width, s64 height, s64 channels) {
+    // Zero is reserved for unused buckets, which is fine since no texture is empty.
+    return width | (height << 24) | (channels << 48);
+}
+
+static inline
+s64 texture_bytes(s64 key) {
+    s64 width = key & 0xffffff, height = (key >> 24) & 0xffffff, channels = key >> 48;
+    return width * height * channels;
+}
+
+static inline
+s64 mesh_bytes(s64 segments) {
+    return get_tile_vertex_count(segments) * (s64) sizeof(Tile_Vertex);
+}
+
+static
+void destroy_texture_with_key(App *app, G_Handle handle, s64 key) {
+    destroy_tile_texture(app, handle);
+    app->tile_pool.texture_bytes -= texture_bytes(key);
+}
+
+static
+void destroy_mesh_with_segments(App *app, G_Handle handle, s64 segments) {
+    destroy_mesh(app, handle);
+    app->tile_pool.mesh_bytes -= mesh_bytes(segments);
+}
+
+void create_tile_pool(App *app) {
+    Tile_Pool *pool = &app->tile_pool;
+    pool->chunks      = null;
+    pool->free_blocks = null;
+    pool->textures    = (Resource_Bucket *) app->allocator.allocate(RESOURCE_CACHE_BUCKETS * sizeof(Resource_Bucket));
+    pool->meshes      = (Resource_Bucket *) app->allocator.allocate(RESOURCE_CACHE_BUCKETS * sizeof(Resource_Bucket));
+    pool->stats       = Tile_Pool_Stats{};
+    pool->blocks_in_use = 0;
+    pool->texture_bytes = 0;
+    pool->mesh_bytes    = 0;
+
+    memset(pool->textures, 0, RESOURCE_CACHE_BUCKETS * sizeof(Resource_Bucket));
+    memset(pool->meshes, 0, RESOURCE_CACHE_BUCKETS * sizeof(Resource_Bucket));
+}
+
+void destroy_tile_pool(App *app) {
+    Tile_Pool *pool = &app->tile_pool;
+
+    trim_tile_pool(app);
+
+    app->allocator.deallocate(pool->textures);
+    app->allocator.deallocate(pool->meshes);
+
+    while(pool->chunks) {
+        Tile_Chunk *next = pool->chunks->next;
+        app->allocator.deallocate(pool->chunks);
+        pool->chunks = next;
+    }
+
+    pool->free_blocks = null;
+}
+
+Tile *allocate_tile_children(App *app) {
+    Tile_Pool *pool = &app->tile_pool;
+
+    if(!pool->free_blocks) {
+        Tile_Chunk *chunk = (Tile_Chunk *) app->allocator.allocate(sizeof(Tile_Chunk));
+        chunk->next  = pool->chunks;
+        pool->chunks = chunk;
+
+        for(s64 i = TILE_POOL_CHUNK_SIZE - 1; i >= 0; --i) {
+            Free_Tile_Block *block = (Free_Tile_Block *) &chunk->tiles[i * 4];
+            block->next = pool->free_blocks;
+            pool->free_blocks = block;
+        }
+
+        ++pool->stats.blocks_allocated;
+    } else {
+        ++pool->stats.blocks_reused;
+    }
+
+    Free_Tile_Block *block = pool->free_blocks;
+    pool->free_blocks = block->next;
+    ++pool->blocks_in_use;
+
+    Tile *children = (Tile *) block;
+    for(s64 i = 0; i < 4; ++i) children[i] = Tile{};
+    return children;
+}
+
+void free_tile_children(App *app, Tile *children) {
+    Free_Tile_Block *block = (Free_Tile_Block *) children;
+    block->next = app->tile_pool.free_blocks;
+    app->tile_pool.free_blocks = block;
+    --app->tile_pool.blocks_in_use;
+}
+
+G_Handle acquire_tile_texture(App *app, s64 width, s64 height, s64 channels) {
+    G_Handle handle = pop_handle(app->tile_pool.textures, texture_key(width, height, channels));
+
+    if(handle) {
+        // The previous contents are stale, but every new tile gets repainted anyway.
+        ++app->tile_pool.stats.textures_reused;
+    } else {
+        handle = create_tile_texture(app, width, height, channels);
+        if(!handle) return null; // Out of texture memory, the tile stays marked for repainting until there is some
+
+        app->tile_pool.texture_bytes += texture_bytes(texture_key(width, height, channels));
+        ++app->tile_pool.stats.textures_created;
+    }
+
+    return handle;
+}
+
+void release_tile_texture(App *app, G_Handle handle, s64 width, s64 height, s64 channels) {
+    s64 key = texture_key(width, height, channels);
+    if(!push_handle(app->tile_pool.textures, key, handle)) destroy_texture_with_key(app, handle, key);
+}
+
+G_Handle acquire_tile_mesh(App *app, Tile_Vertex *vertices, s64 vertex_count, Tile_Vertex_Range *range, s64 segments) {
+    G_Handle handle = pop_handle(app->tile_pool.meshes, segments);
+
+    if(handle) {
+        update_mesh(app, handle, vertices, vertex_count, range);
+        ++app->tile_pool.stats.meshes_reused;
+    } else {
+        handle = create_mesh(app, vertices, vertex_count, range, get_tile_index_buffer(app, segments));
+        app->tile_pool.mesh_bytes += mesh_bytes(segments);
+        ++app->tile_pool.stats.meshes_created;
+    }
+
+    return handle;
+}
+
+void release_tile_mesh(App *app, G_Handle handle, s64 segments) {
+    if(!push_handle(app->tile_pool.meshes, segments, handle)) destroy_mesh_with_segments(app, handle, segments);
+}
+
+void trim_tile_pool(App *app) {
+    Tile_Pool *pool = &app->tile_pool;
+
+    for(s64 i = 0; i < RESOURCE_CACHE_BUCKETS; ++i) {
+        // The buckets keep their keys, so they are found again by the next release.
+        for(s64 j = 0; j < pool->textures[i].count; ++j) destroy_texture_with_key(app, pool->textures[i].handles[j], pool->textures[i].key);
+        for(s64 j = 0; j < pool->meshes[i].count; ++j) destroy_mesh_with_segments(app, pool->meshes[i].handles[j], pool->meshes[i].key);
+        pool->textures[i].count = 0;
+        pool->meshes[i].count   = 0;
+    }
+
+    compact_tile_texture_pages(app);
+}
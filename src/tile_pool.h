@@ -0,0 +1,68 @@
+#pragma once
+
+#include <foundation.h>
+
+struct App;
+struct Tile;
+struct Tile_Vertex;
+struct Tile_Vertex_Range;
+typedef void *G_Handle;
+
+//
+// Tiles are always created in groups of four siblings, so the pool hands out blocks of
+// four contiguous tiles. Blocks are carved out of larger chunks and recycled through a
+// free list, so that LOD churn doesn't hit the allocator.
+// Tile textures and meshes are recycled as well: Released resources go into free lists
+// keyed by their size (texture dimensions, mesh segment count), and the next tile
+// needing a resource of the same size reuses one instead of going through the driver.
+// The pool also keeps track of how much memory the tiles and their resources hold, which
+// is what the residency manager (residency.h) budgets.
+//
+
+#define TILE_POOL_CHUNK_SIZE 64 // Blocks of four tiles per chunk
+#define RESOURCE_CACHE_BUCKETS 8
+#define RESOURCE_CACHE_LIMIT 1024 // Handles per bucket, anything beyond that gets destroyed
+
+struct Tile_Chunk;
+struct Free_Tile_Block;
+
+struct Resource_Bucket {
+    s64 key;
+    s64 count;
+    G_Handle handles[RESOURCE_CACHE_LIMIT];
+};
+
+struct Tile_Pool_Stats {
+    s64 blocks_allocated;
+    s64 blocks_reused;
+    s64 textures_created;
+    s64 textures_reused;
+    s64 meshes_created;
+    s64 meshes_reused;
+};
+
+struct Tile_Pool {
+    Tile_Chunk *chunks;
+    Free_Tile_Block *free_blocks;
+
+    Resource_Bucket *textures; // [RESOURCE_CACHE_BUCKETS]
+    Resource_Bucket *meshes;   // [RESOURCE_CACHE_BUCKETS]
+
+    Tile_Pool_Stats stats;
+
+    s64 blocks_in_use;
+    s64 texture_bytes; // Of all live textures, including the idle ones in the buckets
+    s64 mesh_bytes;    // Of all live vertex buffers, including the idle ones in the buckets
+};
+
+void create_tile_pool(App *app);
+void destroy_tile_pool(App *app);
+
+Tile *allocate_tile_children(App *app); // Returns four contiguous, zeroed tiles
+void free_tile_children(App *app, Tile *children);
+
+G_Handle acquire_tile_texture(App *app, s64 width, s64 height, s64 channels);
+void release_tile_texture(App *app, G_Handle handle, s64 width, s64 height, s64 channels);
+G_Handle acquire_tile_mesh(App *app, Tile_Vertex *vertices, s64 vertex_count, Tile_Vertex_Range *range, s64 segments);
+void release_tile_mesh(App *app, G_Handle handle, s64 segments);
+void trim_tile_pool(App *app); // Destroys all idle resources